@@ -0,0 +1,132 @@
+#include "actuators.hpp"
+#include "pwm.hpp"
+#include "pwm_sim.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Channel the thrust is written to.
+static const int THRUST_CHANNEL = 6;
+// Distinct thrust periods the commands cycle through, so each trace record
+// can be matched to its command.
+static const int LEVELS = 100;
+
+struct BusConfig {
+  const char *name;
+  unsigned bus_hz;
+  int overhead_us;
+};
+
+/**
+ * Sends commands through Actuators to a simulated PCA9685 with PWM at
+ * pwm_rate at rate for seconds, and matches the trace to the commands.
+ */
+static void run(const BusConfig &config, int pwm_rate, int rate, float seconds, FILE *trace) {
+  char path[64];
+  snprintf(path, sizeof(path), "/sim/%s/%d/%d", config.name, pwm_rate, rate);
+  PCA9685Sim &sim = PCA9685Sim::bus(path);
+  sim.bus_hz = config.bus_hz;
+  sim.overhead = chrono::microseconds(config.overhead_us);
+
+  // What a command used to cost its caller: the bus transaction itself.
+  PWMDevice direct(path, pwm_rate);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  const int DIRECT = 50;
+  for (int i = 0; i < DIRECT; i++) {
+    float positions[] = {0, 0, (i % 2) * 0.5f, 0};
+    direct.setPositions(4, 4, positions);
+  }
+  double direct_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / DIRECT;
+  PWMTraceRecord r;
+  while (sim.takeRecord(r)) {
+  }
+
+  int commands = rate * seconds;
+  vector<chrono::steady_clock::time_point> posted(commands);
+  vector<unsigned short> periods(commands);
+  double call_total = 0, call_max = 0;
+  {
+    Actuators actuators(path, pwm_rate);
+    chrono::steady_clock::time_point next = chrono::steady_clock::now();
+    for (int i = 0; i < commands; i++) {
+      this_thread::sleep_until(next);
+      next += chrono::nanoseconds(1000000000L / rate);
+      float thrust = -1 + 2.0f * (i % LEVELS) / LEVELS;
+      periods[i] = direct.period(THRUST_CHANNEL, thrust);
+      posted[i] = chrono::steady_clock::now();
+      actuators.gse(ControlPacketElement(0, 0, 0, thrust));
+      double call = chrono::duration<double, micro>(chrono::steady_clock::now() - posted[i]).count();
+      call_total += call;
+      call_max = call > call_max ? call : call_max;
+    }
+    // Let the output thread finish.
+    this_thread::sleep_for(chrono::milliseconds(100));
+  }
+
+  // Output always writes the newest command, so records follow the commands
+  // in order; each is the last command with its period posted before it.
+  // The new pulse starts with the next period, on average half a period
+  // after the write.
+  double pwm_period = sim.period();
+  int applied = 0, next = 0;
+  double latency_total = 0, latency_max = 0, pulse_total = 0;
+  while (sim.takeRecord(r)) {
+    if (trace) {
+      fwrite(&r, sizeof(r), 1, trace);
+    }
+    if (r.channel != THRUST_CHANNEL) {
+      continue;
+    }
+    chrono::steady_clock::time_point time = chrono::steady_clock::time_point(chrono::nanoseconds(r.time));
+    int match = -1;
+    for (int i = next; i < commands && posted[i] <= time; i++) {
+      if (periods[i] == r.off) {
+        match = i;
+      }
+    }
+    if (match < 0) {
+      continue;
+    }
+    double latency = chrono::duration<double, micro>(time - posted[match]).count();
+    latency_total += latency;
+    latency_max = latency > latency_max ? latency : latency_max;
+    pulse_total += latency + pwm_period / 2;
+    applied++;
+    next = match + 1;
+  }
+  printf("%-16s %4d Hz %4d Hz %8.1f %8.1f %8.1f %7d %7d %9.1f %9.1f %9.1f\n", config.name,
+         pwm_rate, rate, direct_us, call_total / commands, call_max, applied, commands - applied,
+         applied ? latency_total / applied : 0.0, latency_max, applied ? pulse_total / applied : 0.0);
+  if (sim.dropped) {
+    printf("  %lu trace records dropped\n", (unsigned long) sim.dropped);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  FILE *trace = NULL;
+  if (argc > 1 && !(trace = fopen(argv[1], "wb"))) {
+    printf("Could not open %s\n", argv[1]);
+    return 1;
+  }
+  const BusConfig configs[] = {
+    {"100kHz", 100000, 30},
+    {"400kHz", 400000, 30},
+    {"100kHz-retrying", 100000, 2000},
+  };
+  const int pwm_rates[] = {50, 400};
+  const int rates[] = {50, 500};
+  printf("%-16s %7s %7s %8s %8s %8s %7s %7s %9s %9s %9s\n", "bus", "pwm", "rate", "sync us",
+         "call us", "max", "applied", "supersd", "write us", "max", "pulse us");
+  for (int c = 0; c < 3; c++) {
+    for (int p = 0; p < 2; p++) {
+      for (int r = 0; r < 2; r++) {
+        run(configs[c], pwm_rates[p], rates[r], 1, trace);
+      }
+    }
+  }
+  if (trace) {
+    fclose(trace);
+  }
+  return 0;
+}
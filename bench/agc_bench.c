@@ -0,0 +1,81 @@
+#include "pt1.h"
+#include "pt1_agc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Counts a histogram one pixel at a time into a cleared 14 bit histogram.
+ */
+static void simple_histogram(const uint16_t *pixels, size_t count, uint32_t *histogram) {
+  memset(histogram, 0, PT1_HISTOGRAM_SIZE * sizeof(*histogram));
+  for (size_t i = 0; i < count; i++) {
+    histogram[pixels[i] > PT1_PMAX ? PT1_PMAX : pixels[i]]++;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 20000;
+  static uint16_t y16[PT1_HEIGHT][PT1_WIDTH];
+  static uint8_t y8[PT1_HEIGHT][PT1_WIDTH];
+  static uint32_t histogram[PT1_HISTOGRAM_SIZE];
+  static struct pt1_agc agc;
+  const int count = PT1_WIDTH * PT1_HEIGHT;
+
+  // A cool background with a warm region.
+  srand(1);
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      y16[y][x] = (x > 30 && x < 50 && y > 20 ? 3700 : 3000) + rand() % 200;
+    }
+  }
+
+  unsigned checksum = 0;
+  double start = now();
+  for (int i = 0; i < frames; i++) {
+    y16[0][0] = 3000 + i % 200;
+    simple_histogram(&y16[0][0], count, histogram);
+    checksum += histogram[3100];
+  }
+  printf("%-20s %8.2f us/frame\n", "simple histogram", (now() - start) / frames * 1e6);
+
+  pt1_agc_init(&agc, PT1_AGC_LINEAR);
+  start = now();
+  for (int i = 0; i < frames; i++) {
+    y16[0][0] = 3000 + i % 200;
+    pt1_agc_histogram(&agc, &y16[0][0], count);
+    checksum += agc.histogram[3100];
+  }
+  printf("%-20s %8.2f us/frame\n", "pt1_agc_histogram", (now() - start) / frames * 1e6);
+
+  simple_histogram(&y16[0][0], count, histogram);
+  for (int v = agc.low; v <= agc.high; v++) {
+    if (histogram[v] != agc.histogram[v]) {
+      printf("histogram mismatch at %d\n", v);
+      return 1;
+    }
+  }
+
+  for (int m = 0; m < PT1_AGC_MODE_COUNT; m++) {
+    pt1_agc_init(&agc, m);
+    start = now();
+    for (int i = 0; i < frames; i++) {
+      y16[0][0] = 3000 + i % 200;
+      pt1_agc_process(&agc, &y16[0][0], PT1_WIDTH, PT1_HEIGHT, &y8[0][0]);
+      checksum += y8[30][40];
+    }
+    uint16_t low, high;
+    pt1_agc_range(&agc, &low, &high);
+    printf("%-20s %8.2f us/frame range %u to %u\n", pt1_agc_mode_name(m),
+           (now() - start) / frames * 1e6, low, high);
+  }
+  printf("checksum %u\n", checksum);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "background.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+using namespace std;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+struct Target {
+  float x, y, vx, vy;
+};
+
+/**
+ * A cool sky over a warm textured rooftop with small warm targets flying
+ * across. The rooftop is warmer than the targets.
+ */
+static void make_frame(uint16_t frame[PT1_HEIGHT][PT1_WIDTH], vector<Target> &targets) {
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      bool roof = y > 40 && x > 10 && x < 60;
+      frame[y][x] = (roof ? 8200 + 150 * ((x / 4 + y / 3) % 2) : 7000 + 5 * y) + rand() % 20;
+    }
+  }
+  for (size_t i = 0; i < targets.size(); i++) {
+    Target &t = targets[i];
+    t.x += t.vx;
+    t.y += t.vy;
+    if (t.x < 0 || t.x >= PT1_WIDTH) {
+      t.vx = -t.vx;
+      t.x += 2 * t.vx;
+    }
+    if (t.y < 0 || t.y >= PT1_HEIGHT) {
+      t.vy = -t.vy;
+      t.y += 2 * t.vy;
+    }
+    int cx = t.x, cy = t.y;
+    for (int y = cy; y <= cy + 1 && y < PT1_HEIGHT; y++) {
+      for (int x = cx; x <= cx + 1 && x < PT1_WIDTH; x++) {
+        frame[y][x] += 400;
+      }
+    }
+  }
+}
+
+/**
+ * Counts detections within 2 pixels of a target as hits, others as false.
+ */
+static void score(const Detector &d, const vector<Target> &targets, long *hits, long *false_alarms) {
+  for (int i = 0; i < d.count; i++) {
+    bool hit = false;
+    for (size_t j = 0; j < targets.size(); j++) {
+      hit |= fabsf(d.detections[i].x - targets[j].x) < 2.5f &&
+             fabsf(d.detections[i].y - targets[j].y) < 2.5f;
+    }
+    *hits += hit;
+    *false_alarms += !hit;
+  }
+}
+
+static int run_recordings(int argc, char* argv[]) {
+  static BackgroundDetector detector;
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  long frames = 0, detections = 0;
+  double elapsed = 0;
+  for (int i = 1; i < argc; i++) {
+    FILE *fd = fopen(argv[i], "rb");
+    if (!fd) {
+      printf("Couldn't open %s\n", argv[i]);
+      return 1;
+    }
+    detector.reset();
+    while (fread(frame, sizeof(frame), 1, fd) == 1) {
+      double start = now();
+      detections += detector.detect(frame);
+      elapsed += now() - start;
+      frames++;
+    }
+    fclose(fd);
+  }
+  printf("%ld frames %8.2f us/frame %6.2f detections/frame\n", frames,
+         elapsed / frames * 1e6, (double) detections / frames);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && atoi(argv[1]) == 0) {
+    return run_recordings(argc, argv);
+  }
+  int frames = argc > 1 ? atoi(argv[1]) : 5000;
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static HotSpotDetector hot_spot(7250);
+  static BackgroundDetector background;
+  BackgroundDetector no_cleanup;
+  no_cleanup.cleanup = false;
+  Detector *detectors[] = {&hot_spot, &background, &no_cleanup};
+  const char *names[] = {"hot spot", "background", "background, no cleanup"};
+
+  for (int d = 0; d < 3; d++) {
+    srand(1);
+    vector<Target> targets;
+    for (int i = 0; i < 8; i++) {
+      Target t = {(float) (rand() % PT1_WIDTH), (float) (rand() % 40), (rand() % 100 - 50) / 40.0f,
+                  (rand() % 100 - 50) / 80.0f};
+      targets.push_back(t);
+    }
+    long hits = 0, false_alarms = 0;
+    double elapsed = 0;
+    for (int i = 0; i < frames; i++) {
+      make_frame(frame, targets);
+      double start = now();
+      detectors[d]->detect(frame);
+      elapsed += now() - start;
+      score(*detectors[d], targets, &hits, &false_alarms);
+    }
+    printf("%-24s %8.2f us/frame %6.2f hits/frame %6.2f false/frame\n", names[d],
+           elapsed / frames * 1e6, (double) hits / frames, (double) false_alarms / frames);
+  }
+  return 0;
+}
@@ -0,0 +1,243 @@
+#include "classifier.hpp"
+#include "scene.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum TargetClass { BAT, BIRD, INSECT, BACKGROUND, CLASSES };
+static const char *names[CLASSES] = {"bat", "bird", "insect", "background"};
+static const int FEATURES = 4 * 4 * 16;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Adds heat with a linear falloff over radius around (cx, cy), stretched by
+ * aspect along angle.
+ */
+static void blob(float frame[PT1_HEIGHT][PT1_WIDTH], float cx, float cy, float radius,
+                 float aspect, float angle, float heat) {
+  float c = cosf(angle), s = sinf(angle);
+  for (int y = (int) cy - 8; y <= (int) cy + 8; y++) {
+    for (int x = (int) cx - 8; x <= (int) cx + 8; x++) {
+      float u = (x - cx) * c + (y - cy) * s, v = (-(x - cx) * s + (y - cy) * c) * aspect;
+      float d = sqrtf(u * u + v * v) / (radius + 1);
+      frame[y][x] += d < 1 ? heat * (1 - d) : 0;
+    }
+  }
+}
+
+/**
+ * Renders a target of a class in the middle of a frame of sky with noise.
+ */
+static void render(SyntheticScene &r, TargetClass type, uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) {
+  static float heat[PT1_HEIGHT][PT1_WIDTH];
+  memset(heat, 0, sizeof(heat));
+  float cx = PT1_WIDTH / 2 + r.random() * 2 - 1, cy = PT1_HEIGHT / 2 + r.random() * 2 - 1;
+  float angle = r.random() * (float) M_PI;
+  switch (type) {
+  case BAT: {
+    // Small body with wings spread a few pixels, mid beat.
+    float body = 300 + r.random() * 500, span = 1.5f + r.random();
+    blob(heat, cx, cy, 0.3f + r.random() * 0.5f, 1, 0, body);
+    blob(heat, cx - span * cosf(angle), cy - span * sinf(angle), 0.5f, 2, angle, body / 2);
+    blob(heat, cx + span * cosf(angle), cy + span * sinf(angle), 0.5f, 2, angle, body / 2);
+    break;
+  }
+  case BIRD:
+    blob(heat, cx, cy, 2 + r.random() * 1.5f, 1.5f + r.random(), angle,
+         800 + r.random() * 1200);
+    break;
+  case INSECT:
+    blob(heat, cx, cy, r.random() * 0.3f, 1, 0, 150 + r.random() * 250);
+    break;
+  default: {
+    // The warm edge of a roof or rock with a soft border.
+    float warm = 200 + r.random() * 1000, c = cosf(angle), s = sinf(angle);
+    float offset = r.random() * 4 - 2, softness = 0.5f + r.random() * 2;
+    for (int y = 0; y < PT1_HEIGHT; y++) {
+      for (int x = 0; x < PT1_WIDTH; x++) {
+        float d = ((x - cx) * c + (y - cy) * s - offset) / softness;
+        heat[y][x] = warm * (d > 1 ? 1 : d < -1 ? 0 : (d + 1) / 2);
+      }
+    }
+  }
+  }
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      frame[y][x] = 7000 + (int) heat[y][x] + (int) (r.random() * 30);
+    }
+  }
+}
+
+/**
+ * Signed 3x3 filters for the first layer: a blob, a spot, edges and a blur.
+ */
+static const int8_t filters[8][9] = {
+  {-1, -1, -1, -1, 8, -1, -1, -1, -1},
+  {0, -2, 0, -2, 8, -2, 0, -2, 0},
+  {-2, 0, 2, -4, 0, 4, -2, 0, 2},
+  {2, 0, -2, 4, 0, -4, 2, 0, -2},
+  {-2, -4, -2, 0, 0, 0, 2, 4, 2},
+  {2, 4, 2, 0, 0, 0, -2, -4, -2},
+  {1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 1, 0, 1, 4, 1, 0, 1, 0},
+};
+
+/**
+ * Builds the fixed feature layers: the filters above, then random 3x3
+ * combinations of them, each followed by 2x2 max pooling.
+ */
+static void features(Classifier &c, SyntheticScene &r) {
+  c.clear(CLASSES);
+  for (int k = 0; k < CLASSES; k++) {
+    strcpy(c.class_names[k], names[k]);
+  }
+  Layer *conv1 = c.addLayer(Layer::CONV, 8, true, 1, 2);
+  for (int k = 0; k < 8; k++) {
+    for (int i = 0; i < 9; i++) {
+      c.weightData(*conv1)[i * 8 + k] = filters[k][i];
+    }
+  }
+  memset(c.biasData(*conv1), 0, 8 * sizeof(int32_t));
+  c.addLayer(Layer::POOL, 8, false, 1, 0);
+  Layer *conv2 = c.addLayer(Layer::CONV, 16, true, 1, 0);
+  int8_t *w = c.weightData(*conv2);
+  for (int i = 0; i < 16 * 9 * 8; i++) {
+    w[i] = (int8_t) (r.random() * 128 - 64);
+  }
+  memset(c.biasData(*conv2), 0, 16 * sizeof(int32_t));
+  c.addLayer(Layer::POOL, 16, false, 1, 0);
+}
+
+int main(int argc, char* argv[]) {
+  const int train = 4000, test = 4000;
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static int8_t crops[train][Classifier::CROP * Classifier::CROP];
+  static int labels[train];
+  static float x[train][FEATURES];
+  static Classifier classifier;
+  SyntheticScene r(0, 7);
+
+  for (int i = 0; i < train; i++) {
+    labels[i] = i % CLASSES;
+    render(r, (TargetClass) labels[i], frame);
+    Classifier::crop(frame, PT1_WIDTH / 2, PT1_HEIGHT / 2, crops[i]);
+  }
+
+  // Scale the second convolution so about 1% of its outputs saturate.
+  features(classifier, r);
+  Layer &conv2 = classifier.layers[2];
+  for (conv2.shift = 0; conv2.shift < 16; conv2.shift++) {
+    long saturated = 0;
+    for (int i = 0; i < train; i += 10) {
+      classifier.classify(crops[i]);
+      for (int k = 0; k < FEATURES; k++) {
+        saturated += classifier.output()[k] == 127;
+      }
+    }
+    if (saturated < (train / 10) * FEATURES / 100) {
+      break;
+    }
+  }
+
+  // Train the dense layer on the int8 features with softmax regression.
+  for (int i = 0; i < train; i++) {
+    classifier.classify(crops[i]);
+    for (int k = 0; k < FEATURES; k++) {
+      x[i][k] = classifier.output()[k] / 127.0f;
+    }
+  }
+  static float w[CLASSES][FEATURES];
+  float b[CLASSES] = {};
+  memset(w, 0, sizeof(w));
+  for (int epoch = 0; epoch < 40; epoch++) {
+    float rate = 0.05f / (1 + epoch * 0.1f);
+    for (int i = 0; i < train; i++) {
+      float logits[CLASSES], sum = 0, top = -1e30f;
+      for (int k = 0; k < CLASSES; k++) {
+        logits[k] = b[k];
+        for (int j = 0; j < FEATURES; j++) {
+          logits[k] += w[k][j] * x[i][j];
+        }
+        top = logits[k] > top ? logits[k] : top;
+      }
+      for (int k = 0; k < CLASSES; k++) {
+        logits[k] = expf(logits[k] - top);
+        sum += logits[k];
+      }
+      for (int k = 0; k < CLASSES; k++) {
+        float gradient = logits[k] / sum - (k == labels[i]);
+        b[k] -= rate * gradient;
+        for (int j = 0; j < FEATURES; j++) {
+          w[k][j] -= rate * (gradient * x[i][j] + 1e-4f * w[k][j]);
+        }
+      }
+    }
+  }
+
+  // Quantize: weights to int8, logits to int8 at 8 steps per unit.
+  float largest = 0;
+  for (int k = 0; k < CLASSES; k++) {
+    for (int j = 0; j < FEATURES; j++) {
+      largest = fabsf(w[k][j]) > largest ? fabsf(w[k][j]) : largest;
+    }
+  }
+  const float weight_scale = 127 / largest, logit_scale = 8;
+  const int shift = 24;
+  Layer *dense = classifier.addLayer(Layer::DENSE, CLASSES, false,
+                                     (int32_t) (logit_scale / (weight_scale * 127) * (1 << shift)),
+                                     shift);
+  for (int k = 0; k < CLASSES; k++) {
+    for (int j = 0; j < FEATURES; j++) {
+      classifier.weightData(*dense)[k * FEATURES + j] = (int8_t) lrintf(w[k][j] * weight_scale);
+    }
+    classifier.biasData(*dense)[k] = (int32_t) lrintf(b[k] * weight_scale * 127);
+  }
+  classifier.output_scale = 1 / logit_scale;
+  if (argc > 1) {
+    if (!classifier.save(argv[1]) || !classifier.load(argv[1])) {
+      printf("Could not save %s\n", argv[1]);
+      return 1;
+    }
+    printf("Saved %s\n", argv[1]);
+  }
+
+  // Time the network alone, over crops already in memory.
+  double start = now();
+  for (int i = 0; i < train; i++) {
+    classifier.classify(crops[i]);
+  }
+  double elapsed = now() - start;
+
+  // Test on new targets with the int8 network.
+  int confusion[CLASSES][CLASSES] = {};
+  int correct = 0;
+  for (int i = 0; i < test; i++) {
+    int truth = i % CLASSES;
+    render(r, (TargetClass) truth, frame);
+    int label = classifier.classify(frame, PT1_WIDTH / 2, PT1_HEIGHT / 2);
+    confusion[truth][label]++;
+    correct += label == truth;
+  }
+  printf("%.0f inferences/s (%.2f us each), %.1f%% correct\n", train / elapsed,
+         elapsed / train * 1e6, 100.0 * correct / test);
+  printf("%-10s", "");
+  for (int k = 0; k < CLASSES; k++) {
+    printf(" %10s", names[k]);
+  }
+  printf("\n");
+  for (int t = 0; t < CLASSES; t++) {
+    printf("%-10s", names[t]);
+    for (int k = 0; k < CLASSES; k++) {
+      printf(" %10d", confusion[t][k]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "pt1.h"
+#include "pt1_color.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * The per pixel loop pt1play used before pt1_colorize.
+ */
+static void legacy_colorize(uint16_t y16[PT1_HEIGHT][PT1_WIDTH], long offset, float scale,
+                            uint8_t rgb[PT1_HEIGHT][PT1_WIDTH][3]) {
+  const int r = 0;
+  const int g = 1;
+  const int b = 2;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      float pixel = ((float) (y16[y][x] + offset)) * scale;
+      if (pixel > 0xFF) {
+        rgb[y][x][r] = 0xFF;
+        rgb[y][x][g] = 0;
+        rgb[y][x][b] = 0;
+      } else if (pixel < 0) {
+        rgb[y][x][r] = 0;
+        rgb[y][x][g] = 0;
+        rgb[y][x][b] = 0xFF;
+      } else {
+        rgb[y][x][r] = rgb[y][x][g] = rgb[y][x][b] = pixel;
+      }
+    }
+  }
+}
+
+static void report(const char *name, double seconds, int frames, double baseline) {
+  double per_frame = seconds / frames;
+  printf("%-22s %9.2f us/frame %10.0f frames/s", name, per_frame * 1e6, 1 / per_frame);
+  if (baseline > 0) {
+    printf(" %6.2fx", baseline / per_frame);
+  }
+  printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 20000;
+  static uint16_t y16[PT1_HEIGHT][PT1_WIDTH];
+  static uint8_t legacy[PT1_HEIGHT][PT1_WIDTH][3];
+  static uint8_t rgb[PT1_HEIGHT][PT1_WIDTH][3];
+  const int count = PT1_WIDTH * PT1_HEIGHT;
+
+  // A scene around body temperature with some pixels out of range.
+  srand(1);
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      y16[y][x] = 3300 + rand() % 700;
+    }
+  }
+
+  unsigned checksum = 0;
+  double start = now();
+  for (int i = 0; i < frames; i++) {
+    y16[0][0] = 3300 + i % 700;
+    legacy_colorize(y16, -3400, 255.0 / (3900 - 3400), legacy);
+    checksum += legacy[0][0][0];
+  }
+  double legacy_time = (now() - start) / frames;
+  report("legacy float loop", legacy_time * frames, frames, 0);
+
+  static struct pt1_colormap gray;
+  pt1_colormap_init(&gray, PT1_PALETTE_GRAYSCALE);
+  start = now();
+  for (int i = 0; i < frames; i++) {
+    y16[0][0] = 3300 + i % 700;
+    pt1_colorize(&gray, &y16[0][0], count, 3400, 3900, &rgb[0][0][0]);
+    checksum += rgb[0][0][0];
+  }
+  report("pt1_colorize fixed", now() - start, frames, legacy_time);
+
+  for (int p = 0; p < PT1_PALETTE_COUNT; p++) {
+    static struct pt1_colormap map;
+    pt1_colormap_init(&map, p);
+    char name[32];
+    snprintf(name, sizeof(name), "auto %s", pt1_palette_name(p));
+    start = now();
+    for (int i = 0; i < frames; i++) {
+      y16[0][0] = 3300 + i % 700;
+      pt1_colorize_auto(&map, &y16[0][0], count, &rgb[0][0][0]);
+      checksum += rgb[0][0][0];
+    }
+    report(name, now() - start, frames, legacy_time);
+  }
+
+  // The fixed point mapping may round differently from the float loop by one level.
+  pt1_colorize(&gray, &y16[0][0], count, 3400, 3900, &rgb[0][0][0]);
+  legacy_colorize(y16, -3400, 255.0 / (3900 - 3400), legacy);
+  int max_error = 0;
+  for (int i = 0; i < count * 3; i++) {
+    int error = abs((&rgb[0][0][0])[i] - (&legacy[0][0][0])[i]);
+    max_error = error > max_error ? error : max_error;
+  }
+  printf("max difference from legacy loop: %d (checksum %u)\n", max_error, checksum);
+  return max_error > 1;
+}
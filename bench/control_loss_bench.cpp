@@ -0,0 +1,125 @@
+#include "cmd_tlm.hpp"
+#include "packet_accessor_2.hpp"
+#include "packet_elements.hpp"
+#include "watchdog.hpp"
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+// History lengths compared, 1 is a plain control packet a datagram.
+static const int HISTORIES[] = {1, 2, 4, 8};
+static const int PHASES = sizeof(HISTORIES) / sizeof(*HISTORIES);
+
+struct PhaseStats {
+  long datagrams, accepted, recovered;
+};
+
+/**
+ * Receives what made it through the relay and accepts commands the way fsw's
+ * control loop does, with a Watchdog per history length.
+ */
+class Receiver : public Commands {
+public:
+  mutex lock;
+  PhaseStats stats[PHASES];
+  Watchdog watchdogs[PHASES];
+  // Commands sent per history length, sequences count on across them.
+  long commands;
+
+  Receiver(long commands) : stats(), commands(commands) {}
+
+  void controlHistory(const ControlPacketElement *history, int count) {
+    chrono::steady_clock::time_point received = chrono::steady_clock::now();
+    lock_guard<mutex> guard(lock);
+    stats[phaseOf(history[0])].datagrams++;
+    for (int i = count - 1; i >= 0; i--) {
+      const ControlPacketElement &c = history[i];
+      // History from the last phase.
+      int phase = phaseOf(c);
+      if (phase != phaseOf(history[0])) {
+        continue;
+      }
+      Watchdog &w = watchdogs[phase];
+      if ((i && !w.isNew(c)) || !w.accept(c, received)) {
+        continue;
+      }
+      stats[phase].accepted++;
+      stats[phase].recovered += i > 0;
+    }
+  }
+
+  int phaseOf(const ControlPacketElement &c) {
+    int phase = (c.sequence - 1) / commands;
+    return phase < PHASES ? phase : PHASES - 1;
+  }
+};
+
+static void receive(CmdTlm *cmdtlm, Receiver *receiver) {
+  while (true) {
+    try {
+      cmdtlm->telemetry(*receiver);
+    } catch (string e) {
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("Usage: %s <relay_port> <port> [rate] [seconds]\n", argv[0]);
+    return 1;
+  }
+  int rate = argc > 3 ? atoi(argv[3]) : 50;
+  int seconds = argc > 4 ? atoi(argv[4]) : 20;
+  long commands = (long) rate * seconds;
+  try {
+    UDPSocket in;
+    in.bind(atoi(argv[2]));
+    UDPSplitPacketReader r(in);
+    CmdTlm receiving(&r, NULL);
+    Receiver receiver(commands);
+    thread(receive, &receiving, &receiver).detach();
+
+    UDPSocket out;
+    out.connect("127.0.0.1", atoi(argv[1]));
+    UDPSplitPacketWriter w(0, out);
+    CmdTlm sending(NULL, &w);
+    uint32_t sequence = 0;
+    ControlPacketElement history[MAX_CONTROL_HISTORY];
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point next = start;
+    for (int phase = 0; phase < PHASES; phase++) {
+      for (long i = 0; i < commands; i++) {
+        this_thread::sleep_until(next);
+        next += chrono::microseconds(1000000 / rate);
+        ControlPacketElement c(0, 0, 0, (i % 100) / 50.0f - 1);
+        c.sequence = ++sequence;
+        c.time = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        for (int k = MAX_CONTROL_HISTORY - 1; k > 0; k--) {
+          history[k] = history[k - 1];
+        }
+        history[0] = c;
+        long sent = i + 1;
+        sending.controlHistory(history, sent < HISTORIES[phase] ? sent : HISTORIES[phase]);
+      }
+    }
+    // Let the relay deliver what it holds.
+    this_thread::sleep_for(chrono::seconds(1));
+
+    lock_guard<mutex> guard(receiver.lock);
+    printf("%7s %6s %9s %9s %9s %9s %9s %9s\n", "history", "bytes", "datagrams", "lost",
+           "commands", "recovered", "lost", "stale");
+    for (int p = 0; p < PHASES; p++) {
+      const PhaseStats &s = receiver.stats[p];
+      const Watchdog &wd = receiver.watchdogs[p];
+      long lost = commands - s.accepted;
+      printf("%7d %6d %9ld %8.1f%% %9ld %9ld %8.1f%% %9lu\n", HISTORIES[p], 10 + 11 * HISTORIES[p],
+             s.datagrams, 100.0 * (commands - s.datagrams) / commands, s.accepted, s.recovered,
+             100.0 * lost / commands, wd.out_of_order + wd.too_old);
+    }
+  } catch (string e) {
+    printf("%s\n", e.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "detection.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace std;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Counts the blobs above threshold with a recursive flood fill, the obvious
+ * way to do it, to check BlobExtractor against.
+ */
+static int fill(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], uint16_t threshold,
+                bool seen[PT1_HEIGHT][PT1_WIDTH], int x, int y) {
+  if (x < 0 || x >= PT1_WIDTH || y < 0 || y >= PT1_HEIGHT || seen[y][x] ||
+      frame[y][x] <= threshold) {
+    return 0;
+  }
+  seen[y][x] = true;
+  int area = 1;
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      area += fill(frame, threshold, seen, x + dx, y + dy);
+    }
+  }
+  return area;
+}
+
+static int flood_fill_count(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], uint16_t threshold,
+                            int *total_area) {
+  bool seen[PT1_HEIGHT][PT1_WIDTH] = {};
+  int count = 0;
+  *total_area = 0;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      int area = fill(frame, threshold, seen, x, y);
+      count += area > 0;
+      *total_area += area;
+    }
+  }
+  return count;
+}
+
+/**
+ * A cool noisy sky with targets warm blobs of 1 to 3 pixels radius.
+ */
+static void make_frame(uint16_t frame[PT1_HEIGHT][PT1_WIDTH], int targets, int seed) {
+  srand(seed);
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      frame[y][x] = 7000 + rand() % 40;
+    }
+  }
+  for (int t = 0; t < targets; t++) {
+    float cx = rand() % PT1_WIDTH, cy = rand() % PT1_HEIGHT;
+    float r = 1 + rand() % 3;
+    for (int y = cy - r; y <= cy + r; y++) {
+      for (int x = cx - r; x <= cx + r; x++) {
+        float d = hypotf(x - cx, y - cy);
+        if (x >= 0 && x < PT1_WIDTH && y >= 0 && y < PT1_HEIGHT && d <= r) {
+          frame[y][x] = 7600 + 400 * (1 - d / (r + 1));
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 20000;
+  const int variants = 16;
+  const uint16_t threshold = 7300;
+  static uint16_t scenes[variants][PT1_HEIGHT][PT1_WIDTH];
+  static HotSpotDetector detector(threshold);
+  detector.blobs.max_area = PT1_WIDTH * PT1_HEIGHT;
+
+  const int target_counts[] = {0, 1, 8, 32, 64};
+  for (int targets : target_counts) {
+    for (int v = 0; v < variants; v++) {
+      make_frame(scenes[v], targets, targets * 100 + v);
+      int area;
+      int expected = flood_fill_count(scenes[v], threshold, &area);
+      int found = detector.detect(scenes[v]);
+      int found_area = 0;
+      for (int i = 0; i < found; i++) {
+        found_area += detector.detections[i].area;
+      }
+      if (expected <= HotSpotDetector::MAX_DETECTIONS && (found != expected || found_area != area)) {
+        printf("mismatch with %d targets: %d blobs of %d pixels, flood fill %d of %d\n",
+               targets, found, found_area, expected, area);
+        return 1;
+      }
+    }
+
+    unsigned checksum = 0;
+    double start = now();
+    for (int i = 0; i < frames; i++) {
+      checksum += detector.detect(scenes[i % variants]);
+    }
+    double elapsed = now() - start;
+    printf("%2d targets %8.2f us/frame %6.1f blobs/frame\n", targets, elapsed / frames * 1e6,
+           (double) checksum / frames);
+  }
+
+  // Worst case for the labeling, every other pixel hot.
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      scenes[0][y][x] = (x + y) % 2 ? 8000 : 7000;
+    }
+  }
+  double start = now();
+  for (int i = 0; i < frames / 10; i++) {
+    detector.detect(scenes[0]);
+  }
+  printf("checkerboard %8.2f us/frame %d blobs\n", (now() - start) / (frames / 10) * 1e6,
+         detector.count);
+  return 0;
+}
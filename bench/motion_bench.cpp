@@ -0,0 +1,135 @@
+#include "background.hpp"
+#include "motion.hpp"
+#include "scene.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Camera motion of one frame: a slow pan with shake and the odd jolt.
+ */
+static void shake(SyntheticScene &scene, float &dx, float &dy) {
+  dx = 0.3f + (scene.random() - 0.5f) * 4;
+  dy = -0.1f + (scene.random() - 0.5f) * 4;
+  if (scene.random() < 0.02f) {
+    dx += (scene.random() - 0.5f) * 16;
+    dy += (scene.random() - 0.5f) * 16;
+  }
+}
+
+/**
+ * Runs background subtraction over a shaking camera and counts detections
+ * away from every target, with or without compensating the camera motion.
+ */
+static void detect(int frames, bool compensate) {
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static MotionEstimator estimator;
+  static BackgroundDetector detector;
+  SyntheticScene scene(4, 1);
+  scene.terrain = 400;
+  estimator.reset();
+  detector.reset();
+  long false_detections = 0, found = 0, targets = 0;
+  for (int f = 0; f < frames; f++) {
+    float dx, dy;
+    shake(scene, dx, dy);
+    scene.pan(dx, dy);
+    scene.step();
+    scene.render(frame);
+    if (compensate) {
+      estimator.estimate(frame);
+      detector.compensate(estimator.dx, estimator.dy);
+    }
+    detector.detect(frame);
+    if (f < 50) {
+      continue;
+    }
+    for (int i = 0; i < detector.count; i++) {
+      bool real = false;
+      for (int j = 0; j < scene.count; j++) {
+        real |= hypotf(detector.detections[i].x - scene.targets[j].x,
+                       detector.detections[i].y - scene.targets[j].y) < 3;
+      }
+      false_detections += !real;
+    }
+    for (int j = 0; j < scene.count; j++) {
+      const SyntheticTarget &t = scene.targets[j];
+      if (t.x < 0 || t.x > PT1_WIDTH - 1 || t.y < 0 || t.y > PT1_HEIGHT - 1) {
+        continue;
+      }
+      targets++;
+      for (int i = 0; i < detector.count; i++) {
+        if (hypotf(detector.detections[i].x - t.x, detector.detections[i].y - t.y) < 3) {
+          found++;
+          break;
+        }
+      }
+    }
+  }
+  printf("background %-14s %6.2f false detections/frame %5.1f%% targets found\n",
+         compensate ? "compensated" : "uncompensated",
+         (double) false_detections / (frames - 50), 100.0 * found / targets);
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 2000;
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static uint16_t stable[PT1_HEIGHT][PT1_WIDTH];
+  static MotionEstimator estimator;
+  static Stabilizer stabilizer;
+
+  SyntheticScene scene(4, 1);
+  scene.terrain = 400;
+  double total = 0, worst = 0, error = 0;
+  int lost = 0;
+  double raw = 0, stabilized = 0, last_x = 0, last_y = 0, stabilize_time = 0;
+  for (int f = 0; f < frames; f++) {
+    float dx, dy;
+    shake(scene, dx, dy);
+    scene.pan(dx, dy);
+    scene.step();
+    scene.render(frame);
+    double start = now();
+    estimator.estimate(frame);
+    double elapsed = now() - start;
+    start = now();
+    stabilizer.update(estimator.dx, estimator.dy);
+    stabilizer.apply(frame, stable);
+    stabilize_time += now() - start;
+    if (!f) {
+      continue;
+    }
+    total += elapsed;
+    worst = elapsed > worst ? elapsed : worst;
+    // The scene moves the opposite way to the camera.
+    double e = hypot(estimator.dx + dx, estimator.dy + dy);
+    // Beyond a pixel the wrong minimum was found, usually on the smallest level.
+    if (e > 1) {
+      lost++;
+    } else {
+      error += e;
+    }
+    // Motion left in the video after moving frames by the shift.
+    raw += dx * dx + dy * dy;
+    double sx = -dx + stabilizer.shift_x - last_x, sy = -dy + stabilizer.shift_y - last_y;
+    stabilized += sx * sx + sy * sy;
+    last_x = stabilizer.shift_x;
+    last_y = stabilizer.shift_y;
+  }
+  printf("estimate %6.2f us/frame (worst %6.2f) error %.3f px mean, %d of %d frames lost\n",
+         total / (frames - 1) * 1e6, worst * 1e6, error / (frames - 1 - lost), lost, frames - 1);
+  printf("stabilize %5.2f us/frame, frame to frame motion %.2f px rms, %.2f px stabilized\n",
+         stabilize_time / frames * 1e6, sqrt(raw / (frames - 1)),
+         sqrt(stabilized / (frames - 1)));
+
+  detect(frames, false);
+  detect(frames, true);
+  return 0;
+}
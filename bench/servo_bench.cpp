@@ -0,0 +1,92 @@
+#include "detection.hpp"
+#include "scene.hpp"
+#include "servo.hpp"
+#include "tracker.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Lepton frame rate.
+static const float FRAME_TIME = 1 / 8.7f;
+// Fastest the drone turns or climbs at full stick, in pixels per frame.
+static const float MAX_RATE = 6;
+// Time constant of the drone's response to the sticks in seconds.
+static const float RESPONSE_TIME = 0.25f;
+static const int MAX_DELAY = 16;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Software in the loop: the synthetic scene is rendered from a simulated
+ * drone, detected, tracked and the servo's sticks turn the drone, delay frames
+ * later.
+ */
+static void run(int frames, int delay, const char *name) {
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static HotSpotDetector detector(7200);
+  static Tracker tracker;
+  static VisualServo servo;
+  SyntheticScene scene(1, 3);
+  tracker.reset();
+  servo.reset();
+  ServoCommand commands[MAX_DELAY + 1] = {};
+  float rate_x = 0, rate_y = 0;
+  const float response = 1 - expf(-FRAME_TIME / RESPONSE_TIME);
+  double total = 0, worst = 0, squared_error = 0;
+  long locked = 0;
+  for (int f = 0; f < frames; f++) {
+    // The drone responds to the command sent delay frames ago.
+    const ServoCommand &applied = commands[f % (delay + 1)];
+    rate_x += (applied.yaw * MAX_RATE - rate_x) * response;
+    rate_y += (-(applied.thrust - servo.hover_thrust) * MAX_RATE - rate_y) * response;
+    scene.pan(rate_x, rate_y);
+    scene.step();
+    scene.render(frame);
+
+    double start = now();
+    detector.detect(frame);
+    tracker.update(detector.detections, detector.count);
+    ServoCommand &command = commands[f % (delay + 1)];
+    bool following = servo.update(tracker, FRAME_TIME, command);
+    double elapsed = now() - start;
+    total += elapsed;
+    worst = elapsed > worst ? elapsed : worst;
+
+    if (!following) {
+      continue;
+    }
+    // Score the true position of the target followed.
+    for (int i = 0; i < tracker.count; i++) {
+      const Track &t = tracker.tracks[i];
+      if (t.id != servo.target_id) {
+        continue;
+      }
+      for (int j = 0; j < scene.count; j++) {
+        const SyntheticTarget &target = scene.targets[j];
+        if (hypotf(t.x - target.x, t.y - target.y) < 3) {
+          float dx = target.x - (PT1_WIDTH - 1) / 2.0f, dy = target.y - (PT1_HEIGHT - 1) / 2.0f;
+          squared_error += dx * dx + dy * dy;
+          locked++;
+        }
+      }
+    }
+  }
+  // From the frame to the drone responding to it.
+  double latency = total / frames + (delay + 1) * FRAME_TIME;
+  printf("%-22s %6.2f us/frame (worst %6.2f) %4.0f ms latency %5.1f%% locked "
+         "%5.2f px rms error\n", name, total / frames * 1e6, worst * 1e6, latency * 1e3,
+         100.0 * locked / frames, locked ? sqrt(squared_error / locked) : 0);
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 5000;
+  run(frames, 0, "onboard");
+  run(frames, 3, "GSE, 3 frames delay");
+  run(frames, 6, "GSE, 6 frames delay");
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "motion.hpp"
+#include "pt1_agc.h"
+#include "task.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+// SWIR frame size, the frames the pool is for.
+static const int WIDTH = 640, HEIGHT = 480;
+static const int MAX_THREADS = 16;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void nothing(void *, int) {
+}
+
+/**
+ * Seconds per call of each kernel and of an empty job with pool, and whether
+ * the outputs match the single threaded ones in expected.
+ */
+static bool run(task_pool *pool, int frames, const uint16_t *frame, const uint8_t *expected8,
+                const uint16_t *expected16, double seconds[4]) {
+  static uint8_t out8[WIDTH * HEIGHT];
+  static uint16_t out16[WIDTH * HEIGHT];
+  static pt1_agc agc;
+  bool same = true;
+  for (int mode = 0; mode < 2; mode++) {
+    pt1_agc_init(&agc, mode ? PT1_AGC_CLAHE : PT1_AGC_LINEAR);
+    agc.pool = pool;
+    double start = now();
+    for (int f = 0; f < frames; f++) {
+      pt1_agc_process(&agc, frame, WIDTH, HEIGHT, out8);
+    }
+    seconds[mode] = (now() - start) / frames;
+    same &= !memcmp(out8, expected8 + mode * WIDTH * HEIGHT, sizeof(out8));
+  }
+  double start = now();
+  for (int f = 0; f < frames; f++) {
+    shiftImage(frame, out16, WIDTH, HEIGHT, 2.3f + f % 3, -1.7f, pool);
+  }
+  seconds[2] = (now() - start) / frames;
+  same &= !memcmp(out16, expected16, sizeof(out16));
+  start = now();
+  for (int f = 0; f < frames * 10; f++) {
+    task_run(pool, 64, nothing, NULL);
+  }
+  seconds[3] = (now() - start) / (frames * 10);
+  return same;
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 200;
+  int cores = std::thread::hardware_concurrency();
+  int max_threads = argc > 2 ? atoi(argv[2]) : cores > 4 ? cores : 4;
+  max_threads = max_threads > MAX_THREADS ? MAX_THREADS : max_threads;
+  static uint16_t frame[WIDTH * HEIGHT];
+  static uint8_t expected8[2 * WIDTH * HEIGHT];
+  static uint16_t expected16[WIDTH * HEIGHT];
+
+  // Warm sky over warmer ground with a few hot spots and sensor noise.
+  srand(1);
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      float ground = y > HEIGHT / 2 + 40 * sinf(x * 0.02f) ? 800 : 0;
+      float spots = 2000 * expf(-((x - 200) * (x - 200) + (y - 100) * (y - 100)) / 50.0f);
+      frame[y * WIDTH + x] = 7000 + y * 2 + ground + spots + rand() % 40;
+    }
+  }
+
+  // The single threaded outputs to check against.
+  static pt1_agc agc;
+  for (int mode = 0; mode < 2; mode++) {
+    pt1_agc_init(&agc, mode ? PT1_AGC_CLAHE : PT1_AGC_LINEAR);
+    for (int f = 0; f < frames; f++) {
+      pt1_agc_process(&agc, frame, WIDTH, HEIGHT, expected8 + mode * WIDTH * HEIGHT);
+    }
+  }
+  shiftImage(frame, expected16, WIDTH, HEIGHT, 2.3f + (frames - 1) % 3, -1.7f);
+
+  printf("%dx%d frames, %d cores\n", WIDTH, HEIGHT, cores);
+  printf("%-8s %20s %20s %20s %12s\n", "threads", "agc linear", "agc clahe", "shiftImage",
+         "empty job");
+  double single[3] = {};
+  bool ok = true;
+  for (int threads = 1; threads <= max_threads; threads++) {
+    // Pinned one thread per core while there are enough cores.
+    int pins[MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+      pins[i] = i;
+    }
+    task_pool *pool = task_pool_create(threads, threads <= cores ? pins : NULL);
+    if (!pool) {
+      printf("Could not start %d threads\n", threads);
+      return 1;
+    }
+    double seconds[4];
+    bool same = run(pool, frames, frame, expected8, expected16, seconds);
+    task_pool_destroy(pool);
+    if (threads == 1) {
+      memcpy(single, seconds, sizeof(single));
+    }
+    printf("%-8d", threads);
+    for (int k = 0; k < 3; k++) {
+      printf(" %8.0f us (%5.2fx)", seconds[k] * 1e6, single[k] / seconds[k]);
+    }
+    printf(" %9.1f us%s\n", seconds[3] * 1e6, same ? "" : "  output differs");
+    ok &= same;
+  }
+  return ok ? 0 : 1;
+}
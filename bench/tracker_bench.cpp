@@ -0,0 +1,87 @@
+#include "detection.hpp"
+#include "scene.hpp"
+#include "tracker.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 2000;
+  static uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  static HotSpotDetector detector(7200);
+  static Tracker tracker;
+
+  const int target_counts[] = {1, 8, 16, 32, 48};
+  for (int targets : target_counts) {
+    SyntheticScene scene(targets, targets);
+    tracker.reset();
+    int last_target[SyntheticScene::MAX_TARGETS] = {};
+    int last_track[SyntheticScene::MAX_TARGETS] = {};
+    long covered = 0, switches = 0, false_tracks = 0, confirmed = 0;
+    double total = 0, worst = 0;
+    for (int f = 0; f < frames; f++) {
+      scene.step();
+      scene.render(frame);
+      detector.detect(frame);
+      double start = now();
+      tracker.update(detector.detections, detector.count);
+      double elapsed = now() - start;
+      total += elapsed;
+      worst = elapsed > worst ? elapsed : worst;
+
+      // Score against the truth once the tracks had time to confirm.
+      if (f < 10) {
+        continue;
+      }
+      for (int i = 0; i < tracker.count; i++) {
+        const Track &t = tracker.tracks[i];
+        // Tracks coasting after their target left the frame aren't false.
+        if (!t.confirmed || t.misses) {
+          continue;
+        }
+        confirmed++;
+        bool real = false;
+        for (int j = 0; j < scene.count; j++) {
+          real |= hypotf(t.x - scene.targets[j].x, t.y - scene.targets[j].y) < 2;
+        }
+        false_tracks += !real;
+      }
+      for (int j = 0; j < scene.count; j++) {
+        const SyntheticTarget &target = scene.targets[j];
+        int nearest = -1;
+        float distance = 2;
+        for (int i = 0; i < tracker.count; i++) {
+          const Track &t = tracker.tracks[i];
+          float d = hypotf(t.x - target.x, t.y - target.y);
+          if (t.confirmed && d < distance) {
+            distance = d;
+            nearest = i;
+          }
+        }
+        if (last_target[j] != target.id) {
+          // A new target replaced the one that left.
+          last_target[j] = target.id;
+          last_track[j] = 0;
+        }
+        if (nearest >= 0) {
+          covered++;
+          int id = tracker.tracks[nearest].id;
+          switches += last_track[j] && last_track[j] != id;
+          last_track[j] = id;
+        }
+      }
+    }
+    long scored = (long) (frames - 10) * scene.count;
+    printf("%2d targets %6.2f us/frame (worst %6.2f) %5.1f%% covered %4ld id switches "
+           "%5.2f%% false tracks\n", targets, total / frames * 1e6, worst * 1e6,
+           100.0 * covered / scored, switches, confirmed ? 100.0 * false_tracks / confirmed : 0);
+  }
+  return 0;
+}
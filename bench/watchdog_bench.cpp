@@ -0,0 +1,124 @@
+#include "watchdog.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The GSE's packet rate in the scenarios and the watchdog's tick.
+static const chrono::milliseconds PACKET_PERIOD(20), TICK(10), DELAY(5);
+
+/**
+ * A GSE sending to a Watchdog on a simulated clock, with the control loop's
+ * ticks in between.
+ */
+struct Link {
+  Watchdog watchdog;
+  Watchdog::time_point now;
+  ControlPacketElement output;
+
+  Link() : now(chrono::hours(1)), output(0, 0, 0, 1) {}
+
+  /**
+   * Packet sequence sent at time on the GSE's clock, arriving now.
+   */
+  bool receive(uint32_t sequence, uint32_t time) {
+    ControlPacketElement c(0, 0, 0, 1);
+    c.sequence = sequence;
+    c.time = time;
+    return watchdog.accept(c, now);
+  }
+
+  /**
+   * Runs the control loop's ticks for duration without packets.
+   */
+  void tick(chrono::milliseconds duration) {
+    for (Watchdog::time_point end = now + duration; now < end; now += TICK) {
+      ControlPacketElement out;
+      if (watchdog.update(now, output, out)) {
+        output = out;
+      }
+    }
+  }
+
+  /**
+   * Sends packets first to last, from time on the GSE's clock, at the GSE's
+   * rate and arriving after DELAY.
+   */
+  void send(uint32_t first, uint32_t last, uint32_t time) {
+    for (uint32_t s = first; s <= last; s++, time += PACKET_PERIOD.count()) {
+      now += DELAY;
+      receive(s, time);
+      tick(PACKET_PERIOD - DELAY);
+    }
+  }
+};
+
+static bool expectStage(Link &link, Watchdog::Stage stage, const char *name) {
+  link.tick(TICK);
+  if (link.watchdog.stage != stage) {
+    printf("%s: watchdog in %s, expected %s\n", name, Watchdog::stageName(link.watchdog.stage),
+           Watchdog::stageName(stage));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * The GSE sends packets 1 to 50 from its start, then the link goes down until
+ * the failsafe ramps the thrust down.
+ */
+static void outage(Link &link) {
+  link.send(1, 50, 0);
+  link.tick(chrono::milliseconds(2500));
+}
+
+int main(int argc, char* argv[]) {
+  bool ok = true;
+  {
+    // Delayed duplicates of packets before the last arrive during the
+    // outage. They must not end the failsafe.
+    Link link;
+    outage(link);
+    ok &= expectStage(link, Watchdog::RAMP, "before the duplicates");
+    link.receive(40, 39 * PACKET_PERIOD.count());
+    ok &= expectStage(link, Watchdog::RAMP, "delayed duplicate of 40");
+    for (uint32_t s = 41; s <= 45; s++) {
+      link.receive(s, (s - 1) * PACKET_PERIOD.count());
+    }
+    ok &= expectStage(link, Watchdog::RAMP, "delayed duplicates of 41 to 45");
+    // The link comes back.
+    link.send(51, 52, 50 * PACKET_PERIOD.count() + 2500);
+    ok &= expectStage(link, Watchdog::LINK_OK, "fresh packets after the duplicates");
+  }
+  {
+    // The GSE restarts during the outage: its sequence and clock start again
+    // at 0.
+    Link link;
+    outage(link);
+    link.send(1, 1, 0);
+    ok &= expectStage(link, Watchdog::RAMP, "first packet of a restarted GSE");
+    link.send(2, 3, PACKET_PERIOD.count());
+    ok &= expectStage(link, Watchdog::LINK_OK, "restarted GSE");
+  }
+  {
+    // Without an outage, duplicates are just out of order.
+    Link link;
+    link.send(1, 50, 0);
+    link.receive(2, PACKET_PERIOD.count());
+    ok &= link.watchdog.out_of_order == 1;
+    ok &= expectStage(link, Watchdog::LINK_OK, "duplicate with the link up");
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  // The cost of accepting a packet, the control loop's share per datagram.
+  int packets = argc > 1 ? atoi(argv[1]) : 1000000;
+  Link link;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 1; i <= packets; i++) {
+    link.now += PACKET_PERIOD;
+    link.receive(i, i * PACKET_PERIOD.count());
+  }
+  double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  printf("accept %.1f ns per packet\n", t / packets * 1e9);
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "actuators.hpp"
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+
+PriorityInheritanceMutex::PriorityInheritanceMutex() {
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setprotocol(&attributes, PTHREAD_PRIO_INHERIT);
+  pthread_mutex_init(&mutex, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+}
+
+PriorityInheritanceMutex::~PriorityInheritanceMutex() {
+  pthread_mutex_destroy(&mutex);
+}
+
+void PriorityInheritanceMutex::lock() {
+  pthread_mutex_lock(&mutex);
+}
+
+void PriorityInheritanceMutex::unlock() {
+  pthread_mutex_unlock(&mutex);
+}
+
+Actuators::Actuators(const char *pwmDevice, float pwm_rate, const char *calibration)
+  : pwm(pwmDevice, pwm_rate), gse_seen(false), run(true), override_time(1000) {
+  if (calibration && !pwm.loadCalibration(calibration)) {
+    throw string("Could not read the PWM calibration from ") + calibration;
+  }
+  sem_init(&wake, 0, 0);
+  output_thread = thread(&Actuators::outputLoop, this);
+}
+
+Actuators::~Actuators() {
+  run = false;
+  sem_post(&wake);
+  output_thread.join();
+  sem_destroy(&wake);
+}
+
+void Actuators::write(const ControlPacketElement &e) {
+  // Under lock, so there's only ever one writer to the mailbox.
+  pending.post(e);
+  sem_post(&wake);
+  last_output = e;
+}
+
+void Actuators::outputLoop() {
+  unsigned long commands = 0, superseded = pending.overwritten;
+  chrono::steady_clock::time_point last_report = chrono::steady_clock::now();
+  while (run) {
+    timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec++;
+    if (sem_timedwait(&wake, &timeout) && errno != ETIMEDOUT) {
+      continue;
+    }
+    // Several posts may have been taken in one go.
+    ControlPacketElement e;
+    if (pending.take(e)) {
+      // Receiver label
+      // AETR
+      float positions[] = {e.roll, e.pitch, e.thrust, e.yaw};
+      pwm.setPositions(4, 4, positions);
+      commands++;
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (commands && now - last_report >= chrono::seconds(1)) {
+      unsigned long overwritten = pending.overwritten;
+      PWMStats p = pwm.takeStats();
+      printf("actuators %lu commands %lu superseded before output, pwm %lu transactions "
+             "(%lu failed) %lu channels written %lu skipped bus time %.1f us (max %.1f)\n", commands,
+             overwritten - superseded, p.transactions, p.failures, p.channels_written, p.channels_skipped,
+             p.transactions ? p.bus_time.count() / 1e3 / p.transactions : 0.0,
+             p.bus_time_max.count() / 1e3);
+      fflush(stdout);
+      commands = 0;
+      superseded = overwritten;
+      last_report = now;
+    }
+  }
+}
+
+void Actuators::gse(const ControlPacketElement &e) {
+  lock_guard<PriorityInheritanceMutex> guard(lock);
+  last_gse = chrono::steady_clock::now();
+  gse_seen = true;
+  write(e);
+}
+
+bool Actuators::onboard(const ControlPacketElement &e) {
+  lock_guard<PriorityInheritanceMutex> guard(lock);
+  if (gse_seen && chrono::steady_clock::now() - last_gse < override_time) {
+    return false;
+  }
+  write(e);
+  return true;
+}
+
+ControlPacketElement Actuators::output() {
+  lock_guard<PriorityInheritanceMutex> guard(lock);
+  return last_output;
+}
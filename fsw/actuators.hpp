@@ -0,0 +1,88 @@
+#ifndef ACTUATORS_HPP
+#define ACTUATORS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <pthread.h>
+#include <semaphore.h>
+#include <thread>
+#include "mailbox.hpp"
+#include "packet_elements.hpp"
+#include "pwm.hpp"
+
+using namespace std;
+
+/**
+ * A mutex with priority inheritance: while a higher priority thread waits
+ * for it, its holder runs at that priority, so a preempted normal priority
+ * holder can't hold up the SCHED_FIFO control loop. For lock_guard.
+ */
+class PriorityInheritanceMutex {
+public:
+  PriorityInheritanceMutex();
+  ~PriorityInheritanceMutex();
+  void lock();
+  void unlock();
+private:
+  pthread_mutex_t mutex;
+  PriorityInheritanceMutex(const PriorityInheritanceMutex &);
+  PriorityInheritanceMutex &operator=(const PriorityInheritanceMutex &);
+};
+
+/**
+ * Owns the PWM outputs and decides whether the GSE or the onboard control
+ * drives them. A control packet from the GSE always wins and keeps the
+ * onboard control out for override_time after the last one.
+ *
+ * The I2C writes happen on an output thread of their own, so neither the
+ * network thread nor the control loop ever waits on the bus. Commands are
+ * handed to it through a Mailbox and it always writes the newest; commands
+ * overwritten while the bus was busy are counted as superseded. Every second
+ * a command was output the output thread prints the commands, how many were
+ * superseded, and the PWM bus stats.
+ *
+ * The GSE's commands come from the real-time control loop and the onboard
+ * ones from the normal priority pipeline, so the state they share is behind
+ * a priority inheritance mutex.
+ */
+class Actuators {
+private:
+  PWMDevice pwm;
+  PriorityInheritanceMutex lock;
+  chrono::steady_clock::time_point last_gse;
+  bool gse_seen;
+  ControlPacketElement last_output;
+  Mailbox<ControlPacketElement> pending;
+  // Posted after every command, so the output thread sleeps until there is one.
+  sem_t wake;
+  atomic<bool> run;
+  thread output_thread;
+  void write(const ControlPacketElement &e);
+  void outputLoop();
+public:
+  chrono::milliseconds override_time;
+  /**
+   * @param pwm_rate PWM frequency, see PWMDevice.
+   * @param calibration File of channel calibrations for
+   * PWMDevice::loadCalibration, or NULL for the default.
+   */
+  Actuators(const char *pwmDevice, float pwm_rate = 50, const char *calibration = NULL);
+  ~Actuators();
+  /**
+   * Output a control packet from the GSE.
+   */
+  void gse(const ControlPacketElement &e);
+  /**
+   * Output an onboard command unless the GSE is in control. Returns whether it
+   * was output.
+   */
+  bool onboard(const ControlPacketElement &e);
+  /**
+   * The command last output, by either. It may not have reached the PWM
+   * outputs yet.
+   */
+  ControlPacketElement output();
+};
+
+#endif
@@ -1,24 +1,49 @@
 #include "command_handler.hpp"
-#include "pwm.hpp"
 
-CommandHandler::CommandHandler(CmdTlm *ct, const char *pwmDevice) : cmdtlm(ct), pwm(pwmDevice) {}
+CommandHandler::CommandHandler(CmdTlm *ct, CmdTlm *replies, Actuators *actuators, ControlThread *control) : cmdtlm(ct), replies(replies), actuators(actuators), control(control) {}
 
 void CommandHandler::mainLoop() {
   class CommandListener : public Commands {
   public:
-    PWMDevice & pwm;
-    CommandListener(PWMDevice &pwm) : pwm(pwm) {
+    Actuators *actuators;
+    ControlThread *thread;
+    CmdTlm *replies;
+    CommandListener(Actuators *actuators, ControlThread *thread, CmdTlm *replies) : actuators(actuators), thread(thread), replies(replies) {
     }
 
     void control(const ControlPacketElement &e) {
-      // Receiver label
-      // AETR
-      pwm.setPosition(4, e.roll);
-      pwm.setPosition(5, e.pitch);
-      pwm.setPosition(6, e.thrust);
-      pwm.setPosition(7, e.yaw);
+      if (thread) {
+        thread->post(e);
+      } else if (!(e.flags & ControlPacketElement::HANDOVER)) {
+        // A handover's sticks are zero, which is half thrust, and the
+        // onboard servo has the actuators.
+        actuators->gse(e);
+      }
+      acknowledge(e);
     }
-  } cl(pwm);
+
+    void controlHistory(const ControlPacketElement *history, int count) {
+      if (thread) {
+        thread->post(history, count);
+      } else if (!(history[0].flags & ControlPacketElement::HANDOVER)) {
+        actuators->gse(history[0]);
+      }
+      acknowledge(history[0]);
+    }
+
+    /**
+     * After posting, so the reply doesn't delay the command.
+     */
+    void acknowledge(const ControlPacketElement &e) {
+      uint32_t now = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+      try {
+        replies->controlAck(e.sequence, e.time, now);
+      } catch (string error) {
+        // The GSE's round trip display misses one.
+      }
+    }
+  } cl(actuators, control, replies);
   while (true) {
     cmdtlm->telemetry(cl);
   }
@@ -1,16 +1,25 @@
 #ifndef COMMAND_HANDLER_CPP
 #define COMMAND_HANDLER_CPP
 #include "cmd_tlm.hpp"
-#include "pwm.hpp"
+#include "actuators.hpp"
+#include "control_thread.hpp"
 
 using namespace std;
 
 class CommandHandler {
 private:
-  PWMDevice pwm;
+  Actuators *actuators;
+  ControlThread *control;
   CmdTlm *cmdtlm;
+  CmdTlm *replies;
 public:
-  CommandHandler(CmdTlm *, const char *pwmDevice);
+  /**
+   * Control packets go to control if not NULL, which outputs them at its
+   * rate, otherwise straight to actuators as they arrive. Each datagram of
+   * them is acknowledged through replies, which must have a writer of its
+   * own as telemetry is sent from another thread.
+   */
+  CommandHandler(CmdTlm *, CmdTlm *replies, Actuators *actuators, ControlThread *control);
   void mainLoop();
 };
 
@@ -0,0 +1,213 @@
+#include "control_thread.hpp"
+#include <errno.h>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+static long nanoseconds(const timespec &t) {
+  return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static timespec timespecOf(long ns) {
+  timespec t;
+  t.tv_sec = ns / 1000000000L;
+  t.tv_nsec = ns % 1000000000L;
+  return t;
+}
+
+static long monotonic() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return nanoseconds(t);
+}
+
+ControlThread::ControlThread(Actuators *actuators, int rate)
+  : rate(rate), priority(80), core(-1), actuators(actuators), run(false) {}
+
+ControlThread::~ControlThread() {
+  stop();
+}
+
+void ControlThread::start() {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+    cout << "Warning: could not lock memory for the control loop: " << strerror(errno) << endl;
+  }
+  run = true;
+  control_thread = thread(&ControlThread::mainLoop, this);
+  report_thread = thread(&ControlThread::reportLoop, this);
+  sched_param param;
+  param.sched_priority = priority;
+  int error = pthread_setschedparam(control_thread.native_handle(), SCHED_FIFO, &param);
+  if (error) {
+    cout << "Warning: no real-time priority for the control loop: " << strerror(error) << endl;
+  }
+  if (core >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_setaffinity_np(control_thread.native_handle(), sizeof(cpus), &cpus);
+  }
+}
+
+void ControlThread::stop() {
+  run = false;
+  if (control_thread.joinable()) {
+    control_thread.join();
+    report_thread.join();
+  }
+}
+
+void ControlThread::post(const ControlPacketElement &e) {
+  post(&e, 1);
+}
+
+void ControlThread::post(const ControlPacketElement *history, int count) {
+  ReceivedCommands r;
+  r.count = count < MAX_CONTROL_HISTORY ? count : MAX_CONTROL_HISTORY;
+  for (int i = 0; i < r.count; i++) {
+    r.history[i] = history[i];
+  }
+  r.received = chrono::steady_clock::now();
+  commands.post(r);
+}
+
+void ControlThread::reportLoop() {
+  while (run) {
+    this_thread::sleep_for(chrono::milliseconds(100));
+    WatchdogTransition t;
+    while (transitions.tryPop(t)) {
+      printf("watchdog %s -> %s %.1f ms after the last packet, %.2f ms late\n",
+             Watchdog::stageName(t.from), Watchdog::stageName(t.to),
+             t.since_packet.count() / 1e3, t.late.count() / 1e3);
+    }
+    ControlStats s;
+    if (stats.take(s)) {
+      printf("control %ld ticks period %.0f to %.0f us (%.1f us rms jitter) latency %.1f us "
+             "(max %.1f) %ld overruns %ld missed %ld applied %ld superseded\n", s.ticks,
+             s.period_min, s.period_max, s.period_jitter_rms, s.latency_mean, s.latency_max,
+             s.overruns, s.missed, s.applied, s.superseded);
+      long commands = s.accepted + s.lost;
+      printf("link %ld commands %ld recovered %ld lost (%.1f%%) %ld stale\n", s.accepted,
+             s.recovered, s.lost, commands ? 100.0 * s.lost / commands : 0.0, s.stale);
+      if (smoother.delay.count()) {
+        const SmootherStats &m = s.smoothing;
+        printf("smoothing %ld packets delayed %.1f ms (%.1f to %.1f) %ld late %ld extrapolated "
+               "%ld held %ld slew limited ticks\n", m.samples, m.delay_mean, m.delay_min,
+               m.delay_max, m.late, m.extrapolated, m.held, m.slew_limited);
+      }
+    }
+    fflush(stdout);
+  }
+}
+
+void ControlThread::mainLoop() {
+  // Fault the stack in now, mlockall keeps it.
+  volatile char stack[64 * 1024];
+  memset((char *) stack, 0, sizeof(stack));
+
+  const long period = 1000000000L / rate;
+  long deadline = monotonic(), last_wake = 0;
+  unsigned long superseded = commands.overwritten;
+  unsigned long lost = 0, stale = 0;
+  ControlStats s;
+  memset(&s, 0, sizeof(s));
+  double period_squares = 0;
+  const bool smoothing = smoother.delay.count() > 0;
+  // Since the first packet after a reset.
+  bool smoothed = false;
+  while (run) {
+    deadline += period;
+    timespec t = timespecOf(deadline);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+    }
+    long wake = monotonic();
+
+    // steady_clock is CLOCK_MONOTONIC.
+    chrono::steady_clock::time_point now = chrono::steady_clock::time_point(chrono::nanoseconds(wake));
+    ReceivedCommands r;
+    if (commands.take(r)) {
+      // Oldest first. History the watchdog has seen is skipped quietly, the
+      // newest is always checked so stale datagrams are counted.
+      const ControlPacketElement *newest = NULL;
+      for (int i = r.count - 1; i >= 0; i--) {
+        const ControlPacketElement &c = r.history[i];
+        if ((i && !watchdog.isNew(c)) || !watchdog.accept(c, r.received)) {
+          continue;
+        }
+        s.accepted++;
+        s.recovered += i > 0;
+        if (c.flags & ControlPacketElement::HANDOVER) {
+          continue;
+        }
+        if (smoothing) {
+          // The send time on fsw's clock.
+          chrono::steady_clock::time_point sent =
+            chrono::steady_clock::time_point(chrono::milliseconds(c.time + watchdog.offset()));
+          smoother.push(c, sent, r.received);
+          smoothed = true;
+        }
+        newest = &c;
+        s.applied++;
+      }
+      if (newest && !smoothing) {
+        actuators->gse(*newest);
+      }
+    }
+    ControlPacketElement out;
+    if (watchdog.update(now, actuators->output(), out)) {
+      actuators->gse(out);
+      smoother.reset();
+      smoothed = false;
+    } else if (smoothed && smoother.update(now, actuators->output(), out)) {
+      actuators->gse(out);
+    }
+    WatchdogTransition transition;
+    while (watchdog.takeTransition(transition)) {
+      transitions.tryPush(transition);
+    }
+
+    double latency = (wake - deadline) / 1e3;
+    s.latency_mean += latency;
+    s.latency_max = latency > s.latency_max ? latency : s.latency_max;
+    if (last_wake) {
+      double p = (wake - last_wake) / 1e3;
+      if (!s.period_max || p < s.period_min) {
+        s.period_min = p;
+      }
+      s.period_max = p > s.period_max ? p : s.period_max;
+      double error = p - period / 1e3;
+      period_squares += error * error;
+    }
+    last_wake = wake;
+    s.ticks++;
+
+    long done = monotonic();
+    if (done > deadline + period) {
+      s.overruns++;
+      long behind = (done - deadline) / period;
+      s.missed += behind;
+      deadline += behind * period;
+    }
+
+    if (s.ticks >= rate) {
+      s.latency_mean /= s.ticks;
+      s.period_jitter_rms = sqrt(period_squares / s.ticks);
+      unsigned long overwritten = commands.overwritten;
+      s.superseded = overwritten - superseded;
+      superseded = overwritten;
+      s.smoothing = smoother.takeStats();
+      s.lost = watchdog.lost - lost;
+      lost = watchdog.lost;
+      s.stale = watchdog.out_of_order + watchdog.too_old - stale;
+      stale = watchdog.out_of_order + watchdog.too_old;
+      stats.post(s);
+      memset(&s, 0, sizeof(s));
+      period_squares = 0;
+    }
+  }
+}
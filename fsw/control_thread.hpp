@@ -1,6 +1,114 @@
 #ifndef CONTROL_THREAD_HPP
 #define CONTROL_THREAD_HPP
 
+#include <atomic>
+#include <thread>
+#include "actuators.hpp"
+#include "commands.hpp"
+#include "mailbox.hpp"
+#include "smoother.hpp"
+#include "spsc_queue.hpp"
+#include "watchdog.hpp"
 
+using namespace std;
 
-#endif
\ No newline at end of file
+/**
+ * Timing of the control loop over one report interval, in microseconds.
+ */
+struct ControlStats {
+  long ticks;
+  // Time between consecutive wake ups.
+  double period_min, period_max, period_jitter_rms;
+  // How late each wake up was after its deadline.
+  double latency_mean, latency_max;
+  // Ticks whose work ran past the next deadline, and deadlines skipped.
+  long overruns, missed;
+  // Commands output, and commands overwritten by a newer one before a tick.
+  long applied, superseded;
+  // Commands accepted as fresh, the ones of them recovered from a later
+  // datagram's history, commands never received, and commands rejected as
+  // out of order or too old.
+  long accepted, recovered, lost, stale;
+  SmootherStats smoothing;
+};
+
+/**
+ * The control packets in a datagram, newest first, and when it arrived.
+ */
+struct ReceivedCommands {
+  ControlPacketElement history[MAX_CONTROL_HISTORY];
+  int count;
+  chrono::steady_clock::time_point received;
+};
+
+/**
+ * Outputs the newest control packet from the GSE at a fixed rate, rather than
+ * whenever the network delivers one, on a dedicated SCHED_FIFO thread.
+ *
+ * CommandHandler posts every packet to a Mailbox. Every tick the loop takes
+ * the newest one, if any arrived since the last tick, and writes it to the
+ * actuators, so a burst of packets only outputs the last; the actuators'
+ * own thread does the I2C writes, so a slow bus doesn't delay the ticks. A
+ * control_history packet also carries the packets before the newest, which
+ * the loop uses to recover packets lost on the way, and which cover for a
+ * datagram overwritten in the Mailbox.
+ * Ticks are absolute CLOCK_MONOTONIC deadlines so the period doesn't drift,
+ * and a tick that overruns skips the deadlines it missed instead of catching
+ * up.
+ *
+ * With smoother.delay set, packets go through smoother, which interpolates
+ * between them and outputs a new setpoint every tick.
+ *
+ * Every tick also runs watchdog, which takes over the outputs when fresh
+ * packets stop arriving. Handover packets from the GSE only keep the
+ * watchdog fed, the onboard control drives the outputs. A second, ordinary
+ * thread prints the watchdog's transitions as they happen and the loop's
+ * stats every second.
+ *
+ * Real-time scheduling and mlockall need root or CAP_SYS_NICE and
+ * CAP_IPC_LOCK; without them the loop still runs at the rate, with more
+ * jitter, and a warning is printed.
+ */
+class ControlThread {
+public:
+  // Ticks per second.
+  int rate;
+  // SCHED_FIFO priority, above everything else fsw runs.
+  int priority;
+  // Core the thread is pinned to, -1 for any.
+  int core;
+  // Configure before start.
+  Watchdog watchdog;
+  Smoother smoother;
+
+  ControlThread(Actuators *actuators, int rate);
+  ~ControlThread();
+  /**
+   * Locks fsw's memory so page faults don't stall the loop and starts it.
+   */
+  void start();
+  void stop();
+  /**
+   * Hands a control packet from the GSE to the loop as it arrives. Never
+   * blocks.
+   */
+  void post(const ControlPacketElement &e);
+  /**
+   * Hands the control packets of a control_history packet to the loop,
+   * history[0] the newest. The loop outputs those it hasn't seen.
+   */
+  void post(const ControlPacketElement *history, int count);
+
+private:
+  Actuators *actuators;
+  atomic<bool> run;
+  thread control_thread;
+  thread report_thread;
+  Mailbox<ReceivedCommands> commands;
+  Mailbox<ControlStats> stats;
+  SpscQueue<WatchdogTransition, 16> transitions;
+  void mainLoop();
+  void reportLoop();
+};
+
+#endif
@@ -3,23 +3,214 @@
 #include <iostream>
 #include "command_handler.hpp"
 #include <thread>
+#include <cstring>
+#include <cstdlib>
 #include "telemetry_handler.hpp"
 #include "command_handler.hpp"
 
 using namespace std;
 
 int main(int argc, char* argv[]) {
+  // --agc linear|equalize|clahe sends 8 bit frames
+  int agc_mode = -1;
+  // --nuc file and --badpixels file correct frames before they are used
+  const char *nuc_file = NULL;
+  const char *bad_pixel_file = NULL;
+  // --ffc auto performs FFC only when the fixed pattern noise has drifted
+  bool ffc_scheduling = false;
+  // --detect threshold sends the targets hotter than threshold in every frame,
+  // --detect motion the targets moving against the background
+  int detect_threshold = -1;
+  bool detect_motion = false;
+  // --track gives the detected targets persistent IDs
+  bool track = false;
+  // --stabilize removes camera shake from the frames and follows the targets
+  // across camera motion
+  bool stabilize = false;
+  // --servo follows the tracked target onboard until the GSE sends control
+  bool servo = false;
+  // --classify model labels the targets with a classifier model
+  const char *model_file = NULL;
+  // --frame-interval n sends every n-th frame, 0 sends none
+  int frame_interval = 1;
+  // --drop-policy stage oldest|block sets what a pipeline stage does when the
+  // next stage falls behind
+  DropPolicy policies[PipelineFrame::SEND];
+  bool policy_set[PipelineFrame::SEND] = {};
+  const char *stage_names[PipelineFrame::SEND] = {"capture", "process", "encode"};
+  // --control-rate hz outputs the newest control packet at a fixed rate on a
+  // real-time thread, 0 outputs packets as they arrive
+  int control_rate = 50;
+  // --failsafe hold ramp ramp_time sets when, in ms after the last fresh
+  // control packet, the watchdog holds the last command and starts ramping
+  // the thrust down, and how long the ramp takes. --max-age ms sets how old
+  // a control packet may be on arrival
+  int failsafe[3] = {-1, -1, -1};
+  bool failsafe_set = false;
+  int max_age = -1;
+  // --pwm-rate hz sets the PWM frequency, 400 for ESCs that accept it outputs
+  // commands sooner. --pwm-calibration file sets each channel's endpoints,
+  // trim, expo and reversal
+  float pwm_rate = 50;
+  const char *pwm_calibration = NULL;
+  // --smooth ms interpolates between control packets played out ms after they
+  // were sent. --slew pitch roll yaw thrust limits how fast each changes, in
+  // stick range a second
+  int smooth = 0;
+  float slew[4] = {0, 0, 0, 0};
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--agc") && i + 1 < argc) {
+      i++;
+      for (int m = 0; m < PT1_AGC_MODE_COUNT; m++) {
+        if (!strcmp(argv[i], pt1_agc_mode_name((pt1_agc_mode) m))) {
+          agc_mode = m;
+        }
+      }
+      if (agc_mode < 0) {
+        cout << "Unknown AGC mode " << argv[i] << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--nuc") && i + 1 < argc) {
+      nuc_file = argv[++i];
+    } else if (!strcmp(argv[i], "--badpixels") && i + 1 < argc) {
+      bad_pixel_file = argv[++i];
+    } else if (!strcmp(argv[i], "--ffc") && i + 1 < argc && !strcmp(argv[i + 1], "auto")) {
+      ffc_scheduling = true;
+      i++;
+    } else if (!strcmp(argv[i], "--detect") && i + 1 < argc) {
+      i++;
+      if (!strcmp(argv[i], "motion")) {
+        detect_motion = true;
+      } else {
+        detect_threshold = atoi(argv[i]);
+      }
+    } else if (!strcmp(argv[i], "--track")) {
+      track = true;
+    } else if (!strcmp(argv[i], "--stabilize")) {
+      stabilize = true;
+    } else if (!strcmp(argv[i], "--servo")) {
+      servo = true;
+      track = true;
+    } else if (!strcmp(argv[i], "--classify") && i + 1 < argc) {
+      model_file = argv[++i];
+    } else if (!strcmp(argv[i], "--frame-interval") && i + 1 < argc) {
+      frame_interval = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--drop-policy") && i + 2 < argc) {
+      int stage = -1;
+      for (int s = 0; s < PipelineFrame::SEND; s++) {
+        if (!strcmp(argv[i + 1], stage_names[s])) {
+          stage = s;
+        }
+      }
+      if (stage < 0 || (strcmp(argv[i + 2], "oldest") && strcmp(argv[i + 2], "block"))) {
+        cout << "Unknown drop policy " << argv[i + 1] << " " << argv[i + 2] << endl;
+        return 1;
+      }
+      policies[stage] = strcmp(argv[i + 2], "oldest") ? BLOCK : DROP_OLDEST;
+      policy_set[stage] = true;
+      i += 2;
+    } else if (!strcmp(argv[i], "--control-rate") && i + 1 < argc) {
+      control_rate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--failsafe") && i + 3 < argc) {
+      for (int k = 0; k < 3; k++) {
+        failsafe[k] = atoi(argv[++i]);
+      }
+      failsafe_set = true;
+    } else if (!strcmp(argv[i], "--max-age") && i + 1 < argc) {
+      max_age = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--pwm-rate") && i + 1 < argc) {
+      pwm_rate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--pwm-calibration") && i + 1 < argc) {
+      pwm_calibration = argv[++i];
+    } else if (!strcmp(argv[i], "--smooth") && i + 1 < argc) {
+      smooth = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--slew") && i + 4 < argc) {
+      for (int k = 0; k < 4; k++) {
+        slew[k] = atof(argv[++i]);
+      }
+    } else {
+      cout << "Usage: " << argv[0] << " [--agc linear|equalize|clahe] [--nuc file]"
+           << " [--badpixels file] [--ffc auto] [--detect threshold|motion] [--track]"
+           << " [--stabilize] [--servo] [--classify model] [--frame-interval n]"
+           << " [--drop-policy capture|process|encode oldest|block] [--control-rate hz]"
+           << " [--failsafe hold ramp ramp_time] [--max-age ms] [--pwm-rate hz]"
+           << " [--pwm-calibration file] [--smooth ms] [--slew pitch roll yaw thrust]" << endl;
+      return 1;
+    }
+  }
+  if (failsafe_set && (failsafe[0] < 0 || failsafe[1] < failsafe[0] || failsafe[2] < 0)) {
+    cout << "--failsafe needs 0 <= hold <= ramp and ramp_time >= 0" << endl;
+    return 1;
+  }
+  if (control_rate <= 0) {
+    cout << "Warning: with --control-rate 0 there is no link-loss failsafe" << endl;
+  }
 
   try {
     UDPSocket s;
     s.bind(1995);
-    UDPSplitPacketReader r(s);
-    UDPPacketWriter w(s);
+    UDPSplitAddrPacketReader r(s);
+    // Telemetry goes to wherever the GSE last sent from.
+    UDPSplitReplyPacketWriter w(1, r);
     CmdTlm cmdtlm(&r, &w);
+    // Control acknowledgements, written from the command thread.
+    UDPSplitReplyPacketWriter reply_writer(2, r);
+    CmdTlm replies(&r, &reply_writer);
 
+    Actuators actuators("/dev/i2c-1", pwm_rate, pwm_calibration);
     TelemetryHandler t(&cmdtlm, "/dev/video1");
+    if (agc_mode >= 0) {
+      t.enableAGC((pt1_agc_mode) agc_mode);
+    }
+    if (nuc_file || bad_pixel_file) {
+      t.enableNUC(nuc_file, bad_pixel_file);
+    }
+    if (ffc_scheduling) {
+      t.enableFFCScheduling();
+    }
+    if (detect_motion) {
+      t.enableDetection(new BackgroundDetector());
+    } else if (detect_threshold >= 0) {
+      t.enableDetection(new HotSpotDetector(detect_threshold));
+    }
+    if (track) {
+      t.enableTracking();
+    }
+    if (stabilize) {
+      t.enableStabilization();
+    }
+    if (model_file) {
+      t.enableClassification(model_file);
+    }
+    if (servo) {
+      t.enableServo(&actuators);
+    }
+    t.setFrameInterval(frame_interval);
+    for (int s = 0; s < PipelineFrame::SEND; s++) {
+      if (policy_set[s]) {
+        t.setDropPolicy((PipelineFrame::Stage) s, policies[s]);
+      }
+    }
     t.startThread();
-    CommandHandler c(&cmdtlm, "/dev/i2c-1");
+    ControlThread control(&actuators, control_rate);
+    if (failsafe_set) {
+      control.watchdog.hold_after = chrono::milliseconds(failsafe[0]);
+      control.watchdog.ramp_after = chrono::milliseconds(failsafe[1]);
+      control.watchdog.ramp_time = chrono::milliseconds(failsafe[2]);
+    }
+    if (max_age >= 0) {
+      control.watchdog.max_age = chrono::milliseconds(max_age);
+    }
+    control.smoother.delay = chrono::milliseconds(smooth);
+    for (int k = 0; k < 4; k++) {
+      control.smoother.max_rate[k] = slew[k];
+    }
+    if (control_rate > 0) {
+      // The last core, the pipeline's send stage is the lightest.
+      control.core = thread::hardware_concurrency() - 1;
+      control.start();
+    }
+    CommandHandler c(&cmdtlm, &replies, &actuators, control_rate > 0 ? &control : NULL);
     c.mainLoop();
     return 0;
   }
@@ -0,0 +1,116 @@
+#include "smoother.hpp"
+#include <string.h>
+
+static void axesOf(const ControlPacketElement &e, float axes[4]) {
+  axes[0] = e.pitch;
+  axes[1] = e.roll;
+  axes[2] = e.yaw;
+  axes[3] = e.thrust;
+}
+
+Smoother::Smoother() : delay(0), max_extrapolation(100) {
+  memset(max_rate, 0, sizeof(max_rate));
+  reset();
+  takeStats();
+}
+
+void Smoother::reset() {
+  first = count = 0;
+  pushed = started = false;
+}
+
+void Smoother::push(const ControlPacketElement &e, time_point sent, time_point received) {
+  // Out of order send times would break the search, keep the newest.
+  if (count && sent <= samples[(first + count - 1) % MAX_SAMPLES].sent) {
+    count--;
+  }
+  if (count == MAX_SAMPLES) {
+    first = (first + 1) % MAX_SAMPLES;
+    count--;
+  }
+  Sample &s = samples[(first + count++) % MAX_SAMPLES];
+  s.sent = sent;
+  axesOf(e, s.axes);
+  pushed = true;
+
+  double added = chrono::duration<double, milli>(sent + delay - received).count();
+  if (added < 0) {
+    stats.late++;
+  }
+  stats.delay_mean += added;
+  stats.delay_min = !stats.samples || added < stats.delay_min ? added : stats.delay_min;
+  stats.delay_max = !stats.samples || added > stats.delay_max ? added : stats.delay_max;
+  stats.samples++;
+}
+
+bool Smoother::update(time_point now, const ControlPacketElement &current, ControlPacketElement &out) {
+  if (!started) {
+    axesOf(current, output);
+    last_update = now;
+    started = true;
+  }
+  time_point render = now - delay;
+  // The newest sample sent by render, -1 if none yet.
+  int before = -1;
+  for (int i = 0; i < count; i++) {
+    if (samples[(first + i) % MAX_SAMPLES].sent <= render) {
+      before = i;
+    }
+  }
+  float target[4];
+  memcpy(target, output, sizeof(target));
+  if (before >= 0) {
+    const Sample &a = samples[(first + before) % MAX_SAMPLES];
+    if (before + 1 < count) {
+      const Sample &b = samples[(first + before + 1) % MAX_SAMPLES];
+      float t = chrono::duration<float>(render - a.sent) / chrono::duration<float>(b.sent - a.sent);
+      for (int axis = 0; axis < 4; axis++) {
+        target[axis] = a.axes[axis] + (b.axes[axis] - a.axes[axis]) * t;
+      }
+    } else if (before > 0 && render - a.sent <= max_extrapolation) {
+      const Sample &p = samples[(first + before - 1) % MAX_SAMPLES];
+      float t = chrono::duration<float>(render - a.sent) / chrono::duration<float>(a.sent - p.sent);
+      for (int axis = 0; axis < 4; axis++) {
+        float v = a.axes[axis] + (a.axes[axis] - p.axes[axis]) * t;
+        target[axis] = v < -1 ? -1 : v > 1 ? 1 : v;
+      }
+      stats.extrapolated++;
+    } else {
+      memcpy(target, a.axes, sizeof(target));
+      stats.held++;
+    }
+  }
+
+  float dt = chrono::duration<float>(now - last_update).count();
+  last_update = now;
+  bool changed = false, limited = false;
+  for (int axis = 0; axis < 4; axis++) {
+    float step = target[axis] - output[axis];
+    float most = max_rate[axis] * dt;
+    if (max_rate[axis] > 0 && (step > most || step < -most)) {
+      step = step > 0 ? most : -most;
+      limited = true;
+    }
+    changed = changed || step != 0;
+    output[axis] += step;
+  }
+  stats.slew_limited += limited;
+
+  out = current;
+  out.pitch = output[0];
+  out.roll = output[1];
+  out.yaw = output[2];
+  out.thrust = output[3];
+  bool write = changed || pushed;
+  pushed = false;
+  return write;
+}
+
+SmootherStats Smoother::takeStats() {
+  SmootherStats s = stats;
+  if (s.samples) {
+    s.delay_mean /= s.samples;
+  }
+  memset(&stats, 0, sizeof(stats));
+  return s;
+}
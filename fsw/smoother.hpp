@@ -0,0 +1,80 @@
+#ifndef SMOOTHER_HPP
+#define SMOOTHER_HPP
+
+#include <chrono>
+#include "packet_elements.hpp"
+
+using namespace std;
+
+/**
+ * Smoothing over one report interval. Delays are in ms.
+ */
+struct SmootherStats {
+  long samples;
+  // Delay smoothing added to each packet over outputting it as it arrived,
+  // and packets that arrived too late to be interpolated to.
+  double delay_mean, delay_min, delay_max;
+  long late;
+  // Ticks that extrapolated past the newest packet, held it, and were slowed
+  // by the slew rate limits.
+  long extrapolated, held, slew_limited;
+};
+
+/**
+ * Turns sparse, irregular control packets into a smooth setpoint at the
+ * control loop's rate, in place of stepping the outputs on every packet.
+ *
+ * Packets are played out delay after they were sent: every tick the output
+ * is interpolated between the two packets either side of now - delay, so
+ * jitter shorter than delay is hidden. Past the newest packet it is
+ * extrapolated along the last two for up to max_extrapolation, then held.
+ * Last, each axis moves at most max_rate a second.
+ *
+ * Send times are on fsw's clock, mapped from the GSE's by the caller. The
+ * last MAX_SAMPLES packets are kept, so a tick costs the same however many
+ * arrive.
+ */
+class Smoother {
+public:
+  typedef chrono::steady_clock::time_point time_point;
+  static const int MAX_SAMPLES = 8;
+  // Smoothing is off at 0.
+  chrono::milliseconds delay;
+  chrono::milliseconds max_extrapolation;
+  // Most pitch, roll, yaw and thrust may change a second, 0 for no limit.
+  float max_rate[4];
+
+  Smoother();
+  /**
+   * Forgets the packets, e.g. when the failsafe took over.
+   */
+  void reset();
+  /**
+   * A fresh control packet, sent at sent and received at received.
+   */
+  void push(const ControlPacketElement &e, time_point sent, time_point received);
+  /**
+   * The setpoint at now in out. current is the output the smoothing starts
+   * from after a reset. Returns whether out should be output: it changed or
+   * a packet arrived since the last update.
+   */
+  bool update(time_point now, const ControlPacketElement &current, ControlPacketElement &out);
+  /**
+   * Copies and clears the stats.
+   */
+  SmootherStats takeStats();
+private:
+  struct Sample {
+    time_point sent;
+    float axes[4];
+  };
+  Sample samples[MAX_SAMPLES];
+  // Oldest sample and the number kept.
+  int first, count;
+  bool pushed, started;
+  float output[4];
+  time_point last_update;
+  SmootherStats stats;
+};
+
+#endif
@@ -1,17 +1,134 @@
 #include "telemetry_handler.hpp"
 #include "pt1.h"
 #include "cmd_tlm.hpp"
+#include <cstdio>
+#include <cstring>
 
-TelemetryHandler::TelemetryHandler(CmdTlm *cmdtlm, const char *pt1Device) : cmdtlm(cmdtlm), run(true) {
+TelemetryHandler::TelemetryHandler(CmdTlm *cmdtlm, const char *pt1Device) : cmdtlm(cmdtlm), run(true), agc(NULL), nuc(NULL), ffc(NULL), ffc_allowed(true), detector(NULL), tracker(NULL), motion(NULL), stabilizer(NULL), servo(NULL), actuators(NULL), classifier(NULL), frame_interval(1), tracking(false), ffcs(0), frames_sent(0) {
+  policies[PipelineFrame::CAPTURE] = DROP_OLDEST;
+  policies[PipelineFrame::PROCESS] = BLOCK;
+  policies[PipelineFrame::ENCODE] = BLOCK;
+  memset(latencies, 0, sizeof(latencies));
   pt1_init(pt1Device);
 }
 
 TelemetryHandler::~TelemetryHandler() {
   pt1_deinit();
+  delete agc;
+  delete nuc;
+  delete ffc;
+  delete detector;
+  delete tracker;
+  delete motion;
+  delete stabilizer;
+  delete servo;
+  delete classifier;
+}
+
+void TelemetryHandler::enableAGC(pt1_agc_mode mode) {
+  if (!agc) {
+    agc = new pt1_agc;
+  }
+  pt1_agc_init(agc, mode);
+}
+
+void TelemetryHandler::enableNUC(const char *nucFile, const char *badPixelFile) {
+  if (!nuc) {
+    nuc = new pt1_nuc;
+  }
+  pt1_nuc_init(nuc);
+  if (nucFile && pt1_nuc_load(nuc, nucFile)) {
+    throw string("Could not load NUC file ") + nucFile;
+  }
+  if (badPixelFile) {
+    pt1_bad_pixels map;
+    if (pt1_bad_pixels_load(&map, badPixelFile) || pt1_nuc_set_bad_pixels(nuc, &map)) {
+      throw string("Could not load bad pixel file ") + badPixelFile;
+    }
+  }
+}
+
+void TelemetryHandler::enableFFCScheduling() {
+  if (!ffc) {
+    ffc = new pt1_ffc;
+  }
+  pt1_ffc_init(ffc);
+  pt1_disable_ffc();
+}
+
+void TelemetryHandler::allowFFC(bool allowed) {
+  ffc_allowed = allowed;
+}
+
+void TelemetryHandler::enableDetection(Detector *detector) {
+  delete this->detector;
+  this->detector = detector;
+}
+
+void TelemetryHandler::enableTracking() {
+  if (!tracker) {
+    tracker = new Tracker();
+  }
+  tracker->reset();
+}
+
+void TelemetryHandler::enableStabilization() {
+  if (!motion) {
+    motion = new MotionEstimator();
+    stabilizer = new Stabilizer();
+  }
+  motion->reset();
+  stabilizer->reset();
+}
+
+void TelemetryHandler::enableServo(Actuators *actuators) {
+  if (!detector || !tracker) {
+    throw string("Onboard control needs --detect");
+  }
+  if (!servo) {
+    servo = new VisualServo();
+  }
+  servo->reset();
+  this->actuators = actuators;
+  last_servo = chrono::steady_clock::now();
+}
+
+void TelemetryHandler::enableClassification(const char *modelFile) {
+  if (!classifier) {
+    classifier = new Classifier();
+  }
+  if (!classifier->load(modelFile)) {
+    throw string("Could not load classifier model ") + modelFile;
+  }
+}
+
+void TelemetryHandler::setFrameInterval(int interval) {
+  frame_interval = interval;
+}
+
+void TelemetryHandler::setDropPolicy(PipelineFrame::Stage stage, DropPolicy policy) {
+  if (stage < PipelineFrame::SEND) {
+    policies[stage] = policy;
+  }
 }
 
 void TelemetryHandler::startThread() {
-  tlm_thread = thread(&TelemetryHandler::mainLoop, this);
+  void (TelemetryHandler::*loops[PipelineFrame::STAGE_COUNT])() = {
+    &TelemetryHandler::captureLoop, &TelemetryHandler::processLoop,
+    &TelemetryHandler::encodeLoop, &TelemetryHandler::sendLoop
+  };
+  unsigned cores = thread::hardware_concurrency();
+  for (int s = 0; s < PipelineFrame::STAGE_COUNT; s++) {
+    stage_threads[s] = thread(loops[s], this);
+#ifdef __linux__
+    if (cores >= PipelineFrame::STAGE_COUNT) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(s, &cpus);
+      pthread_setaffinity_np(stage_threads[s].native_handle(), sizeof(cpus), &cpus);
+    }
+#endif
+  }
 }
 
 void TelemetryHandler::stopThread() {
@@ -19,15 +136,197 @@ void TelemetryHandler::stopThread() {
 }
 
 void TelemetryHandler::joinThread() {
-  tlm_thread.join();
+  for (int s = 0; s < PipelineFrame::STAGE_COUNT; s++) {
+    stage_threads[s].join();
+  }
 }
 
-void TelemetryHandler::mainLoop() {
+void TelemetryHandler::captureLoop() {
+  PipelineFrame frame;
+  long performed = 0;
   pt1_start();
-  while (run) {
-    pt1_frame frame;
-    pt1_get_frame(&frame);
-    cmdtlm->lwirFrame((const uint16_t (*)[80])frame.start);
+  for (long count = 0; run; count++) {
+    pt1_frame camera;
+    pt1_get_frame(&camera);
+    frame.started[PipelineFrame::CAPTURE] = chrono::steady_clock::now();
+    frame.count = count;
+    frame.sequence = camera.sequence;
+    frame.ffcs = performed;
+    if (nuc) {
+      pt1_nuc_apply(nuc, (const uint16_t *)camera.start, &frame.pixels[0][0]);
+    } else {
+      memcpy(frame.pixels, camera.start, sizeof(frame.pixels));
+    }
+    if (ffc) {
+      pt1_ffc_state state = pt1_ffc_update(ffc, &frame.pixels[0][0]);
+      if (state == PT1_FFC_URGENT || (state == PT1_FFC_DUE && ffc_allowed && !tracking)) {
+        pt1_ffc_perform(ffc);
+        performed++;
+      }
+    }
+    frame.finished[PipelineFrame::CAPTURE] = chrono::steady_clock::now();
+    queues[PipelineFrame::CAPTURE].push(frame, policies[PipelineFrame::CAPTURE], run);
   }
   pt1_stop();
 }
+
+void TelemetryHandler::processLoop() {
+  PipelineFrame frame;
+  while (queues[PipelineFrame::CAPTURE].pop(frame, run)) {
+    frame.started[PipelineFrame::PROCESS] = chrono::steady_clock::now();
+    process(frame);
+    frame.finished[PipelineFrame::PROCESS] = chrono::steady_clock::now();
+    queues[PipelineFrame::PROCESS].push(frame, policies[PipelineFrame::PROCESS], run);
+  }
+}
+
+void TelemetryHandler::encodeLoop() {
+  PipelineFrame frame;
+  while (queues[PipelineFrame::PROCESS].pop(frame, run)) {
+    frame.started[PipelineFrame::ENCODE] = chrono::steady_clock::now();
+    encode(frame);
+    frame.finished[PipelineFrame::ENCODE] = chrono::steady_clock::now();
+    queues[PipelineFrame::ENCODE].push(frame, policies[PipelineFrame::ENCODE], run);
+  }
+}
+
+void TelemetryHandler::sendLoop() {
+  PipelineFrame frame;
+  while (queues[PipelineFrame::ENCODE].pop(frame, run)) {
+    frame.started[PipelineFrame::SEND] = chrono::steady_clock::now();
+    send(frame);
+    frame.finished[PipelineFrame::SEND] = chrono::steady_clock::now();
+    record(frame);
+  }
+}
+
+void TelemetryHandler::process(PipelineFrame &frame) {
+  const uint16_t (*pixels)[PT1_WIDTH] = frame.pixels;
+  if (frame.ffcs != ffcs) {
+    // Also for FFCs before frames capture dropped.
+    ffcs = frame.ffcs;
+    if (detector) {
+      // The whole frame shifts, relearn the background.
+      detector->reset();
+    }
+    if (motion) {
+      motion->reset();
+    }
+  }
+  frame.shift_x = frame.shift_y = 0;
+  if (motion) {
+    motion->estimate(pixels);
+    if (detector) {
+      detector->compensate(motion->dx, motion->dy);
+    }
+    if (tracker) {
+      tracker->shift(motion->dx, motion->dy);
+    }
+    stabilizer->update(motion->dx, motion->dy);
+    frame.shift_x = stabilizer->shift_x;
+    frame.shift_y = stabilizer->shift_y;
+  }
+  frame.has_points = detector != NULL;
+  frame.points.clear();
+  if (detector) {
+    detector->detect(pixels);
+    if (tracker) {
+      tracker->update(detector->detections, detector->count);
+      tracking = tracker->confirmed();
+      for (int i = 0; i < tracker->count; i++) {
+        const Track &t = tracker->tracks[i];
+        if (t.confirmed) {
+          frame.points.push_back(TrackerPoint(t.id, t.x + frame.shift_x, t.y + frame.shift_y,
+                                              t.area, t.peak));
+        }
+      }
+    } else {
+      for (int i = 0; i < detector->count; i++) {
+        const Detection &d = detector->detections[i];
+        frame.points.push_back(TrackerPoint(i, d.x + frame.shift_x, d.y + frame.shift_y, d.area,
+                                            d.peak));
+      }
+    }
+    if (classifier) {
+      for (size_t i = 0; i < frame.points.size(); i++) {
+        TrackerPoint &p = frame.points[i];
+        p.label = classifier->classify(pixels, p.x - frame.shift_x, p.y - frame.shift_y);
+        p.confidence = classifier->confidence;
+      }
+    }
+    if (servo) {
+      chrono::steady_clock::time_point now = chrono::steady_clock::now();
+      float dt = chrono::duration<float>(now - last_servo).count();
+      last_servo = now;
+      ServoCommand c;
+      servo->update(*tracker, dt, c);
+      if (!actuators->onboard(ControlPacketElement(c.pitch, c.roll, c.yaw, c.thrust))) {
+        // The pilot has control, start over when it's handed back.
+        servo->reset();
+      }
+    }
+  }
+  frame.send = frame_interval && frame.count % frame_interval == 0;
+}
+
+void TelemetryHandler::encode(PipelineFrame &frame) {
+  frame.eight_bit = false;
+  if (!frame.send) {
+    return;
+  }
+  if (stabilizer) {
+    // With the frame's own shift, the stabilizer has moved on to later frames.
+    uint16_t stable[PT1_HEIGHT][PT1_WIDTH];
+    shiftImage(&frame.pixels[0][0], &stable[0][0], PT1_WIDTH, PT1_HEIGHT, frame.shift_x,
+               frame.shift_y);
+    memcpy(frame.pixels, stable, sizeof(stable));
+  }
+  if (agc) {
+    pt1_agc_process(agc, &frame.pixels[0][0], PT1_WIDTH, PT1_HEIGHT, &frame.pixels8[0][0]);
+    frame.eight_bit = true;
+  }
+}
+
+void TelemetryHandler::send(PipelineFrame &frame) {
+  if (frame.has_points) {
+    cmdtlm->trackerPoints(frame.sequence, frame.points);
+  }
+  if (frame.send) {
+    // Arrival from the camera, on the clock fsw acknowledges control with.
+    uint32_t captured = chrono::duration_cast<chrono::milliseconds>(
+      frame.started[PipelineFrame::CAPTURE].time_since_epoch()).count();
+    FrameInfo info(frame.sequence, ++frames_sent, captured);
+    if (frame.eight_bit) {
+      cmdtlm->lwirFrame8(info, frame.pixels8);
+    } else {
+      cmdtlm->lwirFrame(info, frame.pixels);
+    }
+  }
+}
+
+void TelemetryHandler::record(const PipelineFrame &frame) {
+  static const char *names[PipelineFrame::STAGE_COUNT] = {"capture", "process", "encode", "send"};
+  for (int s = 0; s < PipelineFrame::STAGE_COUNT; s++) {
+    StageLatency &l = latencies[s];
+    const chrono::steady_clock::time_point &previous =
+      s ? frame.finished[s - 1] : frame.started[s];
+    double latency = chrono::duration<double>(frame.finished[s] - previous).count();
+    double busy = chrono::duration<double>(frame.finished[s] - frame.started[s]).count();
+    l.latency += latency;
+    l.max_latency = latency > l.max_latency ? latency : l.max_latency;
+    l.busy += busy;
+    l.max_busy = busy > l.max_busy ? busy : l.max_busy;
+    l.frames++;
+  }
+  if (latencies[0].frames < STATS_INTERVAL) {
+    return;
+  }
+  for (int s = 0; s < PipelineFrame::STAGE_COUNT; s++) {
+    StageLatency &l = latencies[s];
+    printf("%-8s %7.2f ms latency (max %7.2f) %7.2f ms busy (max %7.2f) %lu dropped\n", names[s],
+           l.latency / l.frames * 1e3, l.max_latency * 1e3, l.busy / l.frames * 1e3,
+           l.max_busy * 1e3, s < PipelineFrame::SEND ? queues[s].dropped.load() : 0ul);
+    memset(&l, 0, sizeof(l));
+  }
+  fflush(stdout);
+}
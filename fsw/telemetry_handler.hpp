@@ -3,23 +3,186 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include "pt1_agc.h"
+#include "pt1_nuc.h"
+#include "pt1_ffc.h"
+#include "detection.hpp"
+#include "background.hpp"
+#include "tracker.hpp"
+#include "motion.hpp"
+#include "servo.hpp"
+#include "classifier.hpp"
+#include "actuators.hpp"
+#include "cmd_tlm.hpp"
+#include "spsc_queue.hpp"
 
 using namespace std;
 
 class CmdTlm;
 
+/**
+ * A camera frame on its way through the telemetry pipeline, with what each
+ * stage adds to it.
+ */
+struct PipelineFrame {
+  enum Stage {
+    // Gets the frame, corrects it and performs FFC.
+    CAPTURE,
+    // Estimates motion, detects, tracks, classifies and runs the servo.
+    PROCESS,
+    // Stabilizes the frame and reduces it to 8 bits.
+    ENCODE,
+    // Sends the tracker points and frame.
+    SEND,
+    STAGE_COUNT
+  };
+  // Frames captured before this one, and the camera's sequence number.
+  long count;
+  long sequence;
+  // FFCs performed before this frame.
+  long ffcs;
+  uint16_t pixels[PT1_HEIGHT][PT1_WIDTH];
+  // Offset of positions in the sent frame from the camera frame.
+  float shift_x, shift_y;
+  bool has_points;
+  vector<TrackerPoint> points;
+  // Whether the frame is sent, and as pixels8 instead of pixels.
+  bool send;
+  bool eight_bit;
+  uint8_t pixels8[PT1_HEIGHT][PT1_WIDTH];
+  // When each stage started and finished with the frame.
+  chrono::steady_clock::time_point started[STAGE_COUNT], finished[STAGE_COUNT];
+
+  PipelineFrame() {
+    // Copies reuse the capacity, so nothing is allocated per frame.
+    points.reserve(Detector::MAX_DETECTIONS);
+  }
+};
+
+/**
+ * Latency of a pipeline stage: from the previous stage finishing with a frame
+ * to this one finishing, so including the wait in the queue, and the time
+ * spent working on it.
+ */
+struct StageLatency {
+  double latency, max_latency;
+  double busy, max_busy;
+  long frames;
+};
+
 class TelemetryHandler {
+public:
+  static const int QUEUE_SIZE = 4;
+  // Frames between printing the stage latencies and dropped frames.
+  static const int STATS_INTERVAL = 1000;
 protected:
-  bool run;
+  atomic<bool> run;
   CmdTlm *cmdtlm;
-  thread tlm_thread;
-  void mainLoop();
+  thread stage_threads[PipelineFrame::STAGE_COUNT];
+  // From each stage to the next and what the stage does when it is full.
+  SpscQueue<PipelineFrame, QUEUE_SIZE> queues[PipelineFrame::SEND];
+  DropPolicy policies[PipelineFrame::SEND];
+  // Kept by the send stage.
+  StageLatency latencies[PipelineFrame::STAGE_COUNT];
+  uint32_t frames_sent;
+  // Whether anything is tracked, from the process stage for FFC scheduling.
+  atomic<bool> tracking;
+  // FFCs the process stage has seen.
+  long ffcs;
+  pt1_agc *agc;
+  pt1_nuc *nuc;
+  pt1_ffc *ffc;
+  atomic<bool> ffc_allowed;
+  Detector *detector;
+  Tracker *tracker;
+  MotionEstimator *motion;
+  Stabilizer *stabilizer;
+  VisualServo *servo;
+  Classifier *classifier;
+  Actuators *actuators;
+  chrono::steady_clock::time_point last_servo;
+  int frame_interval;
+  void captureLoop();
+  void processLoop();
+  void encodeLoop();
+  void sendLoop();
+  void process(PipelineFrame &frame);
+  void encode(PipelineFrame &frame);
+  void send(PipelineFrame &frame);
+  void record(const PipelineFrame &frame);
 public:
   TelemetryHandler(CmdTlm *cmdtlm, const char *pt1Device);
   ~TelemetryHandler();
+  /**
+   * Starts a thread per pipeline stage, each on its own core where there are
+   * enough. A slow stage only holds up the stages before it as far as their
+   * drop policies let it, capture never waits.
+   */
   void startThread();
   void stopThread();
   void joinThread();
+  /**
+   * What stage does when the queue to the next stage is full. By default
+   * capture drops the oldest frame so it keeps up with the camera and the
+   * other stages block, so tracker points aren't lost after processing.
+   */
+  void setDropPolicy(PipelineFrame::Stage stage, DropPolicy policy);
+  /**
+   * Send frames reduced to 8 bits by automatic gain control instead of raw
+   * 16 bit frames. Halves the LWIR downlink bandwidth.
+   */
+  void enableAGC(pt1_agc_mode mode);
+  /**
+   * Correct frames with the gains and offsets in nucFile (see pt1_nuc_save)
+   * and replace the pixels in badPixelFile (see pt1_bad_pixels_save). Either
+   * may be NULL.
+   */
+  void enableNUC(const char *nucFile, const char *badPixelFile);
+  /**
+   * Disable the camera's automatic FFC and perform FFC when pt1_ffc finds the
+   * fixed pattern noise has drifted.
+   */
+  void enableFFCScheduling();
+  /**
+   * Whether a due FFC may freeze the stream now. Clear while tracking so FFC
+   * waits until the track is lost or becomes urgent.
+   */
+  void allowFFC(bool allowed);
+  /**
+   * Find targets in every frame with detector and send them as tracker
+   * points. Takes ownership of detector.
+   */
+  void enableDetection(Detector *detector);
+  /**
+   * Follow the detections from frame to frame and send the confirmed tracks
+   * with persistent IDs instead of the detections. While there are confirmed
+   * tracks a due FFC waits.
+   */
+  void enableTracking();
+  /**
+   * Estimate the motion of the whole scene in every frame and remove the
+   * shake from the frames sent. The detector and tracker are compensated for
+   * the motion and the tracker points moved to match the sent frames.
+   */
+  void enableStabilization();
+  /**
+   * Follow the tracked target onboard with VisualServo at camera rate,
+   * writing to actuators whenever the GSE isn't controlling them. Needs
+   * detection and tracking enabled.
+   */
+  void enableServo(Actuators *actuators);
+  /**
+   * Label every tracker point with the Classifier model in modelFile, e.g.
+   * bat, bird or insect.
+   */
+  void enableClassification(const char *modelFile);
+  /**
+   * Send every interval-th frame, 0 sends none. Defaults to 1. With detection
+   * enabled the tracker points are still sent for every frame.
+   */
+  void setFrameInterval(int interval);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "watchdog.hpp"
+
+// Length of the windows the fastest arrival is kept over.
+static const chrono::seconds AGE_WINDOW(30);
+// Most a restarted GSE's sequence and clock, in ms, can have reached when
+// its packets are taken as a new session.
+static const uint32_t RESTART_SEQUENCE = 16;
+static const uint32_t RESTART_TIME = 10000;
+
+const char *Watchdog::stageName(int stage) {
+  switch (stage) {
+  case LINK_OK: return "link ok";
+  case HOLD: return "hold";
+  case RAMP: return "ramp";
+  case NEUTRAL: return "neutral";
+  default: return "unknown";
+  }
+}
+
+Watchdog::Watchdog()
+  : hold_after(1000), ramp_after(2000), ramp_time(3000), max_age(500), neutral_thrust(-1) {
+  reset();
+}
+
+void Watchdog::reset() {
+  stage = LINK_OK;
+  out_of_order = too_old = lost = 0;
+  armed = restarting = false;
+  transition_count = transition_first = 0;
+  ramp_from = neutral_thrust;
+}
+
+chrono::milliseconds Watchdog::stageStart(Stage s) const {
+  switch (s) {
+  case HOLD: return hold_after;
+  case RAMP: return ramp_after;
+  case NEUTRAL: return ramp_after + ramp_time;
+  default: return chrono::milliseconds(0);
+  }
+}
+
+void Watchdog::enter(Stage next, time_point now, time_point due) {
+  int i = (transition_first + transition_count) % MAX_TRANSITIONS;
+  if (transition_count == MAX_TRANSITIONS) {
+    transition_first = (transition_first + 1) % MAX_TRANSITIONS;
+  } else {
+    transition_count++;
+  }
+  WatchdogTransition &t = transitions[i];
+  t.from = stage;
+  t.to = next;
+  t.since_packet = chrono::duration_cast<chrono::microseconds>(now - last_packet);
+  t.late = chrono::duration_cast<chrono::microseconds>(now - due);
+  stage = next;
+}
+
+bool Watchdog::restarted(const ControlPacketElement &e, time_point received) const {
+  // The GSE's clock can't have run longer since it restarted than the link
+  // has been down.
+  chrono::milliseconds since_restart(e.time);
+  return stage != LINK_OK && e.sequence <= RESTART_SEQUENCE && e.time <= RESTART_TIME &&
+         since_restart <= received - last_packet + max_age;
+}
+
+bool Watchdog::accept(const ControlPacketElement &e, time_point received) {
+  int64_t arrival = chrono::duration_cast<chrono::milliseconds>(received.time_since_epoch()).count();
+  // Arrival minus send time, the clocks' offset plus the packet's delay.
+  int64_t offset = arrival - e.time;
+  bool link_lost = stage != LINK_OK;
+  bool new_session = false;
+  if (armed && (int32_t) (e.sequence - last_sequence) <= 0) {
+    if (!restarted(e, received)) {
+      out_of_order++;
+      return false;
+    }
+    // The new session's age comes from the packet before, never from the one
+    // being checked.
+    if (!restarting || (int32_t) (e.sequence - restart_sequence) <= 0 ||
+        offset - restart_offset > max_age.count()) {
+      restarting = true;
+      restart_sequence = e.sequence;
+      restart_offset = offset;
+      out_of_order++;
+      return false;
+    }
+    armed = false;
+    new_session = true;
+  }
+  if (!armed || received - window_start > AGE_WINDOW) {
+    int64_t first = new_session ? restart_offset : offset;
+    previous_min = armed ? window_min : first;
+    window_min = armed ? offset : first;
+    window_start = received;
+  }
+  window_min = offset < window_min ? offset : window_min;
+  int64_t fastest = window_min < previous_min ? window_min : previous_min;
+  if (offset - fastest > max_age.count()) {
+    too_old++;
+    return false;
+  }
+  if (link_lost) {
+    enter(LINK_OK, received, received);
+  }
+  if (armed) {
+    lost += e.sequence - last_sequence - 1;
+  }
+  armed = true;
+  restarting = false;
+  last_sequence = e.sequence;
+  last_packet = received;
+  return true;
+}
+
+bool Watchdog::isNew(const ControlPacketElement &e) const {
+  return !armed || (int32_t) (e.sequence - last_sequence) > 0;
+}
+
+bool Watchdog::update(time_point now, const ControlPacketElement &output,
+                      ControlPacketElement &out) {
+  if (!armed) {
+    return false;
+  }
+  Stage due = LINK_OK;
+  for (int s = HOLD; s < STAGE_COUNT; s++) {
+    if (now - last_packet >= stageStart((Stage) s)) {
+      due = (Stage) s;
+    }
+  }
+  if (due > stage) {
+    if (due >= RAMP && stage < RAMP) {
+      ramp_from = output.thrust;
+    }
+    enter(due, now, last_packet + stageStart(due));
+  }
+  if (stage < RAMP) {
+    return false;
+  }
+  out = ControlPacketElement(0, 0, 0, neutral_thrust);
+  if (stage == RAMP) {
+    float done = ramp_time.count() ? chrono::duration<float>(now - last_packet - ramp_after) /
+                                     chrono::duration<float>(ramp_time) : 1;
+    done = done > 1 ? 1 : done;
+    // Only ever down, a thrust below neutral goes straight to it.
+    if (ramp_from > neutral_thrust) {
+      out.thrust = ramp_from + (neutral_thrust - ramp_from) * done;
+    }
+  }
+  return true;
+}
+
+int64_t Watchdog::offset() const {
+  if (!armed) {
+    return 0;
+  }
+  return window_min < previous_min ? window_min : previous_min;
+}
+
+bool Watchdog::takeTransition(WatchdogTransition &t) {
+  if (!transition_count) {
+    return false;
+  }
+  t = transitions[transition_first];
+  transition_first = (transition_first + 1) % MAX_TRANSITIONS;
+  transition_count--;
+  return true;
+}
@@ -0,0 +1,123 @@
+#ifndef WATCHDOG_HPP
+#define WATCHDOG_HPP
+
+#include <chrono>
+#include <stdint.h>
+#include "packet_elements.hpp"
+
+using namespace std;
+
+/**
+ * A change of Watchdog stage.
+ */
+struct WatchdogTransition {
+  int from, to;
+  // From the last fresh packet to the change.
+  chrono::microseconds since_packet;
+  // From when the stage was due to the change, how late the watchdog
+  // reacted. 0 for a recovery.
+  chrono::microseconds late;
+};
+
+/**
+ * Link-loss failsafe. Takes over the outputs in stages when fresh control
+ * packets stop arriving from the GSE: first holds the last command, then
+ * centres the sticks and ramps the thrust down to neutral_thrust, then holds
+ * neutral. A fresh packet returns control to the GSE immediately.
+ *
+ * A packet is fresh if it is newer than the last one by sequence and no older
+ * than max_age. The GSE's clock isn't fsw's, so its age is how much longer it
+ * took to arrive than the fastest packet of the last minute or so, from the
+ * send time it carries, which also follows drift between the clocks.
+ *
+ * Packets older by sequence are rejected, even while the link is lost: a
+ * delayed duplicate mustn't end the failsafe. Only a restarted GSE, whose
+ * sequence and clock start again near 0, starts a new session, and it takes
+ * two such packets in order: the first only sets the age the second is
+ * checked against. A restart without that evidence, e.g. while the link was
+ * down, is accepted once its packets are newer by sequence and the age
+ * windows have moved on, within a minute.
+ *
+ * Time is passed in rather than read so the watchdog can be run in
+ * simulation, and is disarmed until the first packet.
+ */
+class Watchdog {
+public:
+  enum Stage {
+    // Fresh packets are arriving.
+    LINK_OK,
+    // Keeping the last command.
+    HOLD,
+    // Sticks centred, thrust ramping down.
+    RAMP,
+    // Sticks centred, neutral_thrust.
+    NEUTRAL,
+    STAGE_COUNT
+  };
+  static const char *stageName(int stage);
+  typedef chrono::steady_clock::time_point time_point;
+  // From the last fresh packet to each failsafe stage.
+  chrono::milliseconds hold_after, ramp_after;
+  // How long the thrust takes to ramp down, after which NEUTRAL starts.
+  chrono::milliseconds ramp_time;
+  // Oldest a packet may be on arrival.
+  chrono::milliseconds max_age;
+  float neutral_thrust;
+  Stage stage;
+  // Packets rejected as out of order and as too old.
+  unsigned long out_of_order, too_old;
+  // Packets never accepted, from the gaps in the sequence numbers.
+  unsigned long lost;
+
+  Watchdog();
+  void reset();
+  /**
+   * A control packet received at received. Returns whether it's fresh and
+   * should be output.
+   */
+  bool accept(const ControlPacketElement &e, time_point received);
+  /**
+   * Whether e is newer by sequence than the last packet accepted.
+   */
+  bool isNew(const ControlPacketElement &e) const;
+  /**
+   * Moves to the stage due at now. Returns true in RAMP and NEUTRAL with the
+   * failsafe command in out. output is the command last output, the ramp
+   * starts from its thrust.
+   */
+  bool update(time_point now, const ControlPacketElement &output, ControlPacketElement &out);
+  /**
+   * Copies the oldest transition not taken yet to t. Returns false if there
+   * is none. The last 8 are kept.
+   */
+  bool takeTransition(WatchdogTransition &t);
+  /**
+   * Arrival minus send time of the fastest recent packet, in ms: fsw's clock
+   * minus the GSE's, plus the shortest delay. 0 before the first packet.
+   */
+  int64_t offset() const;
+private:
+  static const int MAX_TRANSITIONS = 8;
+  bool armed;
+  // A packet of a restarted GSE has been seen, with this sequence and
+  // arrival minus send time.
+  bool restarting;
+  uint32_t restart_sequence;
+  int64_t restart_offset;
+  time_point last_packet;
+  uint32_t last_sequence;
+  // Fastest arrival minus send time, in ms, this window and the last.
+  int64_t window_min, previous_min;
+  time_point window_start;
+  float ramp_from;
+  WatchdogTransition transitions[MAX_TRANSITIONS];
+  int transition_count, transition_first;
+  void enter(Stage next, time_point now, time_point due);
+  /**
+   * Whether e, older by sequence, looks like it's from a restarted GSE.
+   */
+  bool restarted(const ControlPacketElement &e, time_point received) const;
+  chrono::milliseconds stageStart(Stage s) const;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "control_sender.hpp"
+#include <stdio.h>
+
+static const chrono::seconds REPORT_INTERVAL(5);
+static const chrono::steady_clock::time_point STARTED = chrono::steady_clock::now();
+
+static bool sameCommand(const ControlPacketElement &a, const ControlPacketElement &b) {
+  return a.pitch == b.pitch && a.roll == b.roll && a.yaw == b.yaw && a.thrust == b.thrust &&
+         a.flags == b.flags;
+}
+
+uint32_t ControlSender::millis() {
+  return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - STARTED).count();
+}
+
+ControlSender::ControlSender(CmdTlm *cmdtlm, int rate)
+  : rate(rate), heartbeat(100), cmdtlm(cmdtlm), run(false), woken(false), have_posted(false) {}
+
+ControlSender::~ControlSender() {
+  stop();
+}
+
+void ControlSender::start() {
+  run = true;
+  send_thread = thread(&ControlSender::mainLoop, this);
+}
+
+void ControlSender::stop() {
+  {
+    lock_guard<mutex> guard(wake_lock);
+    run = false;
+  }
+  wake.notify_one();
+  if (send_thread.joinable()) {
+    send_thread.join();
+  }
+}
+
+void ControlSender::post(const ControlPacketElement &c) {
+  ControlInput input;
+  input.control = c;
+  input.sampled = chrono::steady_clock::now();
+  inputs.post(input);
+  if (have_posted && sameCommand(c, posted)) {
+    return;
+  }
+  posted = c;
+  have_posted = true;
+  {
+    lock_guard<mutex> guard(wake_lock);
+    woken = true;
+  }
+  wake.notify_one();
+}
+
+void ControlSender::mainLoop() {
+  const chrono::nanoseconds period(1000000000L / rate);
+  ControlPacketElement history[HISTORY];
+  uint32_t sequence = 0;
+  ControlInput input;
+  bool have_input = false;
+  chrono::steady_clock::time_point last_send = chrono::steady_clock::now();
+  chrono::steady_clock::time_point last_report = last_send;
+  long changes = 0, heartbeats = 0;
+  double latency_total = 0, latency_max = 0;
+  while (run) {
+    {
+      unique_lock<mutex> guard(wake_lock);
+      wake.wait_until(guard, last_send + heartbeat, [this] { return woken || !run; });
+      woken = false;
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    ControlInput newest;
+    bool changed = false;
+    if (inputs.take(newest)) {
+      changed = !have_input || !sameCommand(newest.control, input.control);
+      input = newest;
+      have_input = true;
+    }
+    if (!have_input || (!changed && now - last_send < heartbeat)) {
+      continue;
+    }
+
+    ControlPacketElement c = input.control;
+    // For fsw to tell stale and out of order packets.
+    c.sequence = ++sequence;
+    c.time = chrono::duration_cast<chrono::milliseconds>(now - STARTED).count();
+    for (int i = HISTORY - 1; i > 0; i--) {
+      history[i] = history[i - 1];
+    }
+    history[0] = c;
+    try {
+      cmdtlm->controlHistory(history, sequence < HISTORY ? sequence : HISTORY);
+    } catch (string e) {
+      // fsw not up yet, the next heartbeat tries again.
+    }
+    last_send = chrono::steady_clock::now();
+    // At most rate packets a second, a change meanwhile is sent after.
+    this_thread::sleep_until(now + period);
+    if (changed) {
+      double latency = chrono::duration<double, milli>(last_send - input.sampled).count();
+      latency_total += latency;
+      latency_max = latency > latency_max ? latency : latency_max;
+      changes++;
+    } else {
+      heartbeats++;
+    }
+
+    if (last_send - last_report >= REPORT_INTERVAL) {
+      printf("control %ld changes %ld heartbeats sent, input to send %.1f ms (max %.1f)\n",
+             changes, heartbeats, changes ? latency_total / changes : 0.0, latency_max);
+      fflush(stdout);
+      changes = heartbeats = 0;
+      latency_total = latency_max = 0;
+      last_report = last_send;
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef CONTROL_SENDER_HPP
+#define CONTROL_SENDER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "cmd_tlm.hpp"
+#include "mailbox.hpp"
+#include "packet_elements.hpp"
+
+using namespace std;
+
+/**
+ * The sticks and when they were sampled.
+ */
+struct ControlInput {
+  ControlPacketElement control;
+  chrono::steady_clock::time_point sampled;
+};
+
+/**
+ * Sends control packets from a thread of its own, so commands don't wait for
+ * rendering. The SDL thread posts every input sample to a Mailbox, which
+ * never blocks it, and wakes the sender when the sticks or flags changed.
+ * The sender then sends the newest sample at once, at most rate packets a
+ * second; otherwise it only wakes every heartbeat to send the last one again
+ * so fsw knows the link is up.
+ *
+ * Every packet carries the last HISTORY packets (see
+ * CmdTlm::controlHistory). Every 5 seconds the sender prints the packets
+ * sent for changes and as heartbeats, and the latency from sampling an input
+ * to sending it.
+ */
+class ControlSender {
+public:
+  static const int HISTORY = 4;
+  // Times a second new input is looked for, so the most packets sent.
+  int rate;
+  chrono::milliseconds heartbeat;
+
+  /**
+   * The GSE's clock of control packet send times, ms since it started.
+   * Frame arrivals and capture times are on it too. Like SDL_GetTicks it
+   * only wraps after 49.7 days of running, not of host uptime.
+   */
+  static uint32_t millis();
+
+  /**
+   * @param rate At least 1.
+   */
+  ControlSender(CmdTlm *cmdtlm, int rate);
+  ~ControlSender();
+  void start();
+  void stop();
+  /**
+   * Hands the sticks sampled now to the sender. Only from one thread.
+   */
+  void post(const ControlPacketElement &c);
+
+private:
+  CmdTlm *cmdtlm;
+  atomic<bool> run;
+  thread send_thread;
+  Mailbox<ControlInput> inputs;
+  // Set by post when the input changed, and by stop.
+  mutex wake_lock;
+  condition_variable wake;
+  bool woken;
+  // The input last posted, only for the posting thread.
+  ControlPacketElement posted;
+  bool have_posted;
+  void mainLoop();
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "frame_receiver.hpp"
+#include "control_sender.hpp"
+#include <stdio.h>
+#include <string.h>
+
+const chrono::milliseconds FrameReceiver::STATS_INTERVAL(250);
+static const chrono::seconds REPORT_INTERVAL(5);
+
+/**
+ * Fraction of lost of received plus lost. Late arrivals can make lost
+ * negative over an interval.
+ */
+static double lossFraction(unsigned long received, long lost) {
+  lost = lost < 0 ? 0 : lost;
+  return received + lost ? (double) lost / (received + lost) : 0.0;
+}
+
+FrameReceiver::FrameReceiver(CmdTlm *cmdtlm, UDPSplitPacketReader *reader)
+  : received(0), displayed(0), cmdtlm(cmdtlm), reader(reader), run(false) {}
+
+FrameReceiver::~FrameReceiver() {
+  stop();
+}
+
+void FrameReceiver::start() {
+  run = true;
+  receive_thread = thread(&FrameReceiver::mainLoop, this);
+}
+
+void FrameReceiver::stop() {
+  run = false;
+  if (receive_thread.joinable()) {
+    receive_thread.join();
+  }
+}
+
+bool FrameReceiver::take(TelemetryFrame &frame) {
+  while (frames.tryPop(incoming)) {
+    playout.push(incoming);
+  }
+  if (!playout.take(ControlSender::millis(), frame)) {
+    return false;
+  }
+  displayed++;
+  return true;
+}
+
+unsigned long FrameReceiver::skipped() const {
+  return frames.dropped + playout.superseded;
+}
+
+bool FrameReceiver::takeStats(LinkStats &stats) {
+  return link.take(stats);
+}
+
+void FrameReceiver::mainLoop() {
+  class FrameListener : public Commands {
+  public:
+    FrameReceiver *receiver;
+    TelemetryFrame frame;
+    ClockOffset clock;
+    LossCounter frames;
+    Ewma rtt;
+    WindowMax rtt_max;
+    FrameListener(FrameReceiver *receiver) : receiver(receiver), rtt(0.1), rtt_max(50) {
+    }
+
+    void controlAck(uint32_t, uint32_t time, uint32_t received) {
+      uint32_t t = ControlSender::millis();
+      clock.sample(time, received, t);
+      rtt.add(t - time);
+      rtt_max.add(t - time);
+    }
+
+    void lwirFrame(const FrameInfo &info, const uint16_t pixels[60][80]) {
+      memcpy(frame.pixels, pixels, sizeof(frame.pixels));
+      frame.eight_bit = false;
+      post(info);
+    }
+
+    void lwirFrame8(const FrameInfo &info, const uint8_t pixels[60][80]) {
+      memcpy(frame.pixels8, pixels, sizeof(frame.pixels8));
+      frame.eight_bit = true;
+      post(info);
+    }
+
+    void post(const FrameInfo &info) {
+      frames.receive(info.number);
+      frame.info = info;
+      frame.synchronized = clock.valid();
+      frame.captured = clock.toLocal(info.captured);
+      frame.arrived = ControlSender::millis();
+      frame.number = ++receiver->received;
+      receiver->frames.push(frame, DROP_OLDEST, receiver->run);
+    }
+  } listener(this);
+
+  LinkStats stats;
+  memset(&stats, 0, sizeof(stats));
+  // Rates and losses over each stats interval, smoothed over about 2 seconds.
+  Ewma frame_rate(0.1), bitrate(0.1), fragment_loss(0.1), frame_loss(0.1);
+  chrono::steady_clock::time_point last_stats = chrono::steady_clock::now();
+  chrono::steady_clock::time_point last_report = last_stats;
+  unsigned long stats_frames = 0, stats_lost = 0, stats_bytes = 0, stats_datagrams = 0;
+  unsigned long stats_reader_lost = 0;
+  unsigned long last_received = 0, last_displayed = 0, last_skipped = 0, last_late = 0;
+  unsigned long last_datagrams = 0, last_reader_lost = 0, last_frames = 0, last_frames_lost = 0;
+  while (run) {
+    try {
+      cmdtlm->telemetry(listener);
+    } catch (string e) {
+      // The receive timeout, fsw not up, or a packet cut short.
+    }
+
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    if (t - last_stats >= STATS_INTERVAL) {
+      double seconds = chrono::duration<double>(t - last_stats).count();
+      unsigned long frames = listener.frames.received - stats_frames;
+      long lost = listener.frames.lost - stats_lost;
+      unsigned long datagrams = reader->datagrams - stats_datagrams;
+      long reader_lost = reader->lost - stats_reader_lost;
+      frame_rate.add(frames / seconds);
+      bitrate.add((reader->bytes - stats_bytes) * 8 / seconds);
+      // Nothing to go by while nothing arrives.
+      if (datagrams) {
+        fragment_loss.add(lossFraction(datagrams, reader_lost));
+      }
+      if (frames) {
+        frame_loss.add(lossFraction(frames, lost));
+      }
+      stats_frames = listener.frames.received;
+      stats_lost = listener.frames.lost;
+      stats_bytes = reader->bytes;
+      stats_datagrams = reader->datagrams;
+      stats_reader_lost = reader->lost;
+      last_stats = t;
+
+      stats.frame_rate = frame_rate.mean;
+      stats.bitrate = bitrate.mean;
+      stats.fragment_loss = fragment_loss.mean;
+      stats.frame_loss = frame_loss.mean;
+      stats.rtt = listener.rtt.mean;
+      stats.rtt_max = listener.rtt_max.max();
+      stats.synchronized = listener.clock.valid();
+      stats.clock_offset = listener.clock.offset();
+      link.post(stats);
+    }
+
+    if (t - last_report < REPORT_INTERVAL) {
+      continue;
+    }
+    unsigned long r = received, d = displayed, s = skipped(), l = playout.late;
+    if (r != last_received) {
+      double seconds = chrono::duration<double>(t - last_report).count();
+      unsigned long datagrams = reader->datagrams - last_datagrams;
+      long reader_lost = reader->lost - last_reader_lost;
+      unsigned long frames = listener.frames.received - last_frames;
+      long frames_lost = listener.frames.lost - last_frames_lost;
+      printf("frames %lu received (%.1f fps) %lu displayed %lu skipped %lu late, playout delay "
+             "%d ms, lost %.1f%% datagrams %.1f%% frames, control round trip %.1f ms (max %.0f)\n",
+             r - last_received, (r - last_received) / seconds, d - last_displayed,
+             s - last_skipped, l - last_late, (int) playout.delay,
+             100 * lossFraction(datagrams, reader_lost), 100 * lossFraction(frames, frames_lost),
+             listener.rtt.mean, listener.rtt_max.max());
+      fflush(stdout);
+    }
+    last_received = r;
+    last_displayed = d;
+    last_skipped = s;
+    last_late = l;
+    last_datagrams = reader->datagrams;
+    last_reader_lost = reader->lost;
+    last_frames = listener.frames.received;
+    last_frames_lost = listener.frames.lost;
+    last_report = t;
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef FRAME_RECEIVER_HPP
+#define FRAME_RECEIVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+#include "cmd_tlm.hpp"
+#include "link_stats.hpp"
+#include "mailbox.hpp"
+#include "packet_accessor_2.hpp"
+#include "playout_buffer.hpp"
+#include "spsc_queue.hpp"
+#include "telemetry_frame.hpp"
+
+using namespace std;
+
+/**
+ * Receives telemetry from fsw on a thread of its own, so the window keeps
+ * rendering whatever the link does. Every complete frame is queued with its
+ * arrival time; the render loop moves them to playout, which presents each
+ * when it's due, without waiting on the network. Frames are skipped when
+ * the queue overflows or a newer one is due at the same time, and dropped
+ * as late when they arrive after they were due.
+ *
+ * The thread also keeps the link's stats in constant memory: the frame
+ * rate, bitrate, datagrams and frames lost, and from fsw's control
+ * acknowledgements the control round trip and the offset between the
+ * clocks, which dates the frames on the GSE's clock. The stats are posted
+ * every STATS_INTERVAL to a Mailbox for the HUD.
+ *
+ * The socket needs a receive timeout so the thread sees stop. Every 5
+ * seconds in which frames arrived it prints the frames received, displayed,
+ * skipped and late, the playout delay, the losses and the round trip.
+ */
+class FrameReceiver {
+public:
+  static const int QUEUE_SIZE = 16;
+  // Frames received, and presented by the render loop.
+  atomic<unsigned long> received, displayed;
+  // Render thread only, configure before start.
+  PlayoutBuffer playout;
+
+  static const chrono::milliseconds STATS_INTERVAL;
+
+  /**
+   * reader is cmdtlm's, for its datagram counts.
+   */
+  FrameReceiver(CmdTlm *cmdtlm, UDPSplitPacketReader *reader);
+  ~FrameReceiver();
+  void start();
+  void stop();
+  /**
+   * Copies the frame due for presentation now to frame and returns true, or
+   * returns false if there is none. Never blocks. Only from one thread.
+   */
+  bool take(TelemetryFrame &frame);
+  /**
+   * Frames never presented for a newer one, not counting late ones.
+   */
+  unsigned long skipped() const;
+  /**
+   * Copies the newest link stats posted since the last call to stats and
+   * returns true, or returns false. Never blocks. Only from one thread.
+   */
+  bool takeStats(LinkStats &stats);
+
+private:
+  CmdTlm *cmdtlm;
+  UDPSplitPacketReader *reader;
+  atomic<bool> run;
+  thread receive_thread;
+  SpscQueue<TelemetryFrame, QUEUE_SIZE> frames;
+  // Popped from frames, here to keep it off the render thread's stack.
+  TelemetryFrame incoming;
+  Mailbox<LinkStats> link;
+  void mainLoop();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "hud.hpp"
+#include "control_sender.hpp"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// Older than this the image on screen is shown as stale, in ms.
+static const uint32_t STALE_AFTER = 1000;
+
+// The font's characters and their glyphs, one octal digit per row from the
+// top and the bits of a digit left to right.
+static const char FONT_CHARACTERS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.%/:-()";
+static const uint16_t FONT_GLYPHS[] = {
+  075557, 026227, 071747, 071317, 055711, 074717, 074757, 071111, 075757, 075717,
+  025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152,
+  055655, 044447, 057755, 065555, 025552, 065644, 025563, 065655, 034216, 072222,
+  055557, 055552, 055775, 055255, 055222, 071247,
+  000002, 051245, 011244, 002020, 000700, 012221, 042224
+};
+static const int GLYPH_WIDTH = 3, GLYPH_HEIGHT = 5;
+// In font pixels.
+static const int ADVANCE = GLYPH_WIDTH + 1, LINE_HEIGHT = GLYPH_HEIGHT + 2, MARGIN = 2;
+static const int LINES = 6;
+
+Hud::Hud()
+  : visible(true), scale(2), latency(0.1), latency_max(100), display_rate(0.1),
+    synchronized(false), displayed(0), on_screen(0), last_layout(0), playout_delay(0),
+    playout_percentile(0), late(0), have_link(false) {
+  memset(&link, 0, sizeof(link));
+  memset(&background, 0, sizeof(background));
+}
+
+void Hud::frameDisplayed(const TelemetryFrame &frame) {
+  synchronized = frame.synchronized;
+  if (synchronized) {
+    double age = (int32_t) (ControlSender::millis() - frame.captured);
+    latency.add(age);
+    latency_max.add(age);
+  }
+  on_screen = frame.captured;
+  displayed++;
+}
+
+void Hud::update(const LinkStats &stats, const PlayoutBuffer &playout) {
+  link = stats;
+  playout_delay = playout.delay;
+  playout_percentile = playout.percentile;
+  late = playout.late;
+  have_link = true;
+  layout();
+}
+
+void Hud::layout() {
+  uint32_t t = ControlSender::millis();
+  if (last_layout && t != last_layout) {
+    display_rate.add(displayed * 1000.0 / (t - last_layout));
+  }
+  displayed = 0;
+  last_layout = t;
+
+  char lines[LINES][64];
+  uint32_t age = t - on_screen;
+  if (synchronized && age > STALE_AFTER) {
+    // The link is down, latency is for the frames that did arrive.
+    snprintf(lines[0], sizeof(lines[0]), "IMAGE %.1f S OLD", age / 1000.0);
+  } else if (synchronized) {
+    snprintf(lines[0], sizeof(lines[0]), "LATENCY %.0f MS (MAX %.0f)", latency.mean,
+             latency_max.max());
+  } else {
+    snprintf(lines[0], sizeof(lines[0]), "LATENCY -- NO CLOCK SYNC");
+  }
+  snprintf(lines[1], sizeof(lines[1]), "FRAMES %.1f/S RECEIVED %.1f/S SHOWN", link.frame_rate,
+           display_rate.mean);
+  snprintf(lines[2], sizeof(lines[2]), "LOST %.1f%% DATAGRAMS %.1f%% FRAMES",
+           100 * link.fragment_loss, 100 * link.frame_loss);
+  if (link.bitrate >= 1e6) {
+    snprintf(lines[3], sizeof(lines[3]), "DOWNLINK %.2f MBIT/S", link.bitrate / 1e6);
+  } else {
+    snprintf(lines[3], sizeof(lines[3]), "DOWNLINK %.0f KBIT/S", link.bitrate / 1e3);
+  }
+  if (link.rtt > 0) {
+    snprintf(lines[4], sizeof(lines[4]), "CONTROL RTT %.0f MS (MAX %.0f)", link.rtt,
+             link.rtt_max);
+  } else {
+    snprintf(lines[4], sizeof(lines[4]), "CONTROL RTT --");
+  }
+  if (playout_percentile > 0) {
+    snprintf(lines[5], sizeof(lines[5]), "PLAYOUT %d MS (P%.0f) %lu LATE", playout_delay,
+             100 * playout_percentile, late);
+  } else {
+    snprintf(lines[5], sizeof(lines[5]), "PLAYOUT OFF %lu LATE", late);
+  }
+
+  text.clear();
+  int width = 0;
+  for (int row = 0; row < LINES; row++) {
+    int w = addLine(row, lines[row]);
+    width = w > width ? w : width;
+  }
+  background.x = background.y = 0;
+  // The line spacing below the last line is the bottom margin.
+  background.w = (width + MARGIN) * scale;
+  background.h = (MARGIN + LINES * LINE_HEIGHT) * scale;
+}
+
+int Hud::addLine(int row, const char *line) {
+  int x = MARGIN, y = MARGIN + row * LINE_HEIGHT;
+  for (const char *c = line; *c; c++, x += ADVANCE) {
+    const char *found = strchr(FONT_CHARACTERS, toupper(*c));
+    if (*c == ' ' || !found) {
+      continue;
+    }
+    uint16_t glyph = FONT_GLYPHS[found - FONT_CHARACTERS];
+    for (int gy = 0; gy < GLYPH_HEIGHT; gy++) {
+      int bits = glyph >> (3 * (GLYPH_HEIGHT - 1 - gy)) & 7;
+      for (int gx = 0; gx < GLYPH_WIDTH; gx++) {
+        if (bits & 4 >> gx) {
+          SDL_Rect r = {(x + gx) * scale, (y + gy) * scale, scale, scale};
+          text.push_back(r);
+        }
+      }
+    }
+  }
+  // Including the margin on the left.
+  return x - ADVANCE + GLYPH_WIDTH;
+}
+
+void Hud::draw(SDL_Renderer *renderer) {
+  if (!visible || !have_link) {
+    return;
+  }
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+  SDL_RenderFillRect(renderer, &background);
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+  SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+  if (!text.empty()) {
+    SDL_RenderFillRects(renderer, &text[0], text.size());
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef HUD_HPP
+#define HUD_HPP
+
+#include <SDL.h>
+#include <stdint.h>
+#include <vector>
+#include "frame_receiver.hpp"
+#include "link_stats.hpp"
+
+using namespace std;
+
+/**
+ * Overlay of how old the image on screen is and how the link is doing:
+ * capture to display latency, the frame rates received and displayed,
+ * the playout delay and frames too late for it, datagrams and frames lost,
+ * the downlink bitrate and the control round trip.
+ *
+ * SDL2 can't draw text, so the HUD has a built-in 3x5 pixel font. The text
+ * is only laid out again when the link stats change, at most every
+ * FrameReceiver::STATS_INTERVAL, to a list of rectangles that every draw
+ * fills in one call; per frame the HUD only adds to its estimators.
+ */
+class Hud {
+public:
+  bool visible;
+  // Screen pixels per font pixel.
+  int scale;
+
+  Hud();
+  /**
+   * Call right after presenting frame.
+   */
+  void frameDisplayed(const TelemetryFrame &frame);
+  void update(const LinkStats &stats, const PlayoutBuffer &playout);
+  void draw(SDL_Renderer *renderer);
+
+private:
+  // Capture to display in ms, and frames displayed a second.
+  Ewma latency;
+  WindowMax latency_max;
+  Ewma display_rate;
+  bool synchronized;
+  // Frames displayed since the last layout, and capture time of the one on
+  // screen.
+  unsigned long displayed;
+  uint32_t on_screen;
+  uint32_t last_layout;
+  LinkStats link;
+  // Of the playout buffer at the last update.
+  int playout_delay;
+  double playout_percentile;
+  unsigned long late;
+  bool have_link;
+  vector<SDL_Rect> text;
+  SDL_Rect background;
+  void layout();
+  /**
+   * Adds the rectangles of line to text, at row. Returns its width in font
+   * pixels.
+   */
+  int addLine(int row, const char *line);
+};
+
+#endif
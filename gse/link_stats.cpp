@@ -0,0 +1,90 @@
+#include "link_stats.hpp"
+#include <math.h>
+
+Ewma::Ewma(double weight) : weight(weight), mean(0), variance(0), samples(0) {}
+
+void Ewma::add(double x) {
+  if (!samples++) {
+    mean = x;
+    return;
+  }
+  // West's incremental form, no history needed.
+  double difference = x - mean;
+  double increment = weight * difference;
+  mean += increment;
+  variance = (1 - weight) * (variance + difference * increment);
+}
+
+double Ewma::deviation() const {
+  return sqrt(variance);
+}
+
+WindowMax::WindowMax(int window) : window(window), current(0), previous(0), count(0) {}
+
+void WindowMax::add(double x) {
+  if (count == window) {
+    previous = current;
+    count = 0;
+  }
+  current = !count || x > current ? x : current;
+  count++;
+}
+
+double WindowMax::max() const {
+  return current > previous ? current : previous;
+}
+
+LossCounter::LossCounter(uint32_t max_gap) : max_gap(max_gap), received(0), lost(0), armed(false) {}
+
+void LossCounter::receive(uint32_t sequence) {
+  received++;
+  uint32_t gap = sequence - last;
+  if (!armed || (gap > max_gap && -gap > max_gap)) {
+    armed = true;
+    last = sequence;
+  } else if (gap == 0) {
+    // A duplicate.
+    received--;
+  } else if (gap <= max_gap) {
+    lost += gap - 1;
+    last = sequence;
+  } else if (lost) {
+    // Late, counted as lost when the gap was seen.
+    lost--;
+  }
+}
+
+ClockOffset::ClockOffset(int window) : window(window), count(0), armed(false) {}
+
+void ClockOffset::sample(uint32_t sent, uint32_t remote, uint32_t received) {
+  Best b;
+  b.rtt = received - sent;
+  b.offset = remote - (sent + b.rtt / 2);
+  if (!armed) {
+    current = previous = b;
+    armed = true;
+  }
+  if (count == window) {
+    previous = current;
+    current = b;
+    count = 0;
+  } else if (b.rtt <= current.rtt) {
+    current = b;
+  }
+  count++;
+}
+
+bool ClockOffset::valid() const {
+  return armed;
+}
+
+uint32_t ClockOffset::offset() const {
+  if (!armed) {
+    return 0;
+  }
+  return current.rtt <= previous.rtt ? current.offset : previous.offset;
+}
+
+uint32_t ClockOffset::toLocal(uint32_t t) const {
+  return t - offset();
+}
@@ -0,0 +1,108 @@
+#ifndef LINK_STATS_HPP
+#define LINK_STATS_HPP
+
+#include <stdint.h>
+
+/**
+ * Exponentially weighted mean and standard deviation of a stream of samples,
+ * in constant time and memory. Each sample counts weight, the ones before it
+ * 1 - weight together. The first sample is taken as the mean.
+ */
+class Ewma {
+public:
+  double weight;
+  double mean, variance;
+  unsigned long samples;
+
+  explicit Ewma(double weight = 0.1);
+  void add(double x);
+  double deviation() const;
+};
+
+/**
+ * Largest sample of the last window of samples, or of the window before when
+ * the current one has just started, so a peak shows for at least a window.
+ */
+class WindowMax {
+public:
+  int window;
+
+  explicit WindowMax(int window = 100);
+  void add(double x);
+  double max() const;
+private:
+  double current, previous;
+  int count;
+};
+
+/**
+ * Counts items lost on the way from the gaps in their sequence numbers. Late
+ * items are taken off the losses again, duplicates are ignored, and a jump
+ * of more than max_gap is a restarted sender.
+ */
+class LossCounter {
+public:
+  uint32_t max_gap;
+  unsigned long received, lost;
+
+  explicit LossCounter(uint32_t max_gap = 1000);
+  void receive(uint32_t sequence);
+private:
+  bool armed;
+  uint32_t last;
+};
+
+/**
+ * Estimates fsw's clock minus the GSE's from control acknowledgements, like
+ * NTP: a packet sent at sent on the GSE's clock reached fsw at remote on
+ * fsw's and the acknowledgement was back at received, so assuming the
+ * delay is the same both ways, remote was (sent + received) / 2 on the
+ * GSE's clock. Queuing makes the delays differ, so the offset comes from the
+ * acknowledgement with the shortest round trip of the last window or two,
+ * which also follows drift between the clocks.
+ *
+ * Times are milliseconds on the two monotonic clocks, which are unrelated,
+ * so everything is modulo 2^32.
+ */
+class ClockOffset {
+public:
+  // Acknowledgements the best one is picked from.
+  int window;
+
+  explicit ClockOffset(int window = 100);
+  void sample(uint32_t sent, uint32_t remote, uint32_t received);
+  bool valid() const;
+  /**
+   * fsw's clock minus the GSE's, 0 until valid.
+   */
+  uint32_t offset() const;
+  /**
+   * t on fsw's clock on the GSE's.
+   */
+  uint32_t toLocal(uint32_t t) const;
+private:
+  struct Best {
+    uint32_t rtt, offset;
+  };
+  Best current, previous;
+  int count;
+  bool armed;
+};
+
+/**
+ * The state of the link as the receive thread sees it, for the HUD.
+ */
+struct LinkStats {
+  // Frames and bits received a second.
+  double frame_rate, bitrate;
+  // Fractions of datagrams and of LWIR frames lost on the way.
+  double fragment_loss, frame_loss;
+  // Control round trip in ms, smoothed and the recent peak. 0 before the
+  // first acknowledgement.
+  double rtt, rtt_max;
+  // fsw's clock minus the GSE's, once there has been an acknowledgement.
+  bool synchronized;
+  uint32_t clock_offset;
+};
+
+#endif
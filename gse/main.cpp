@@ -2,10 +2,15 @@
 #include <iostream>
 #include <cstdlib>
 #include <stdint.h>
+#include <string.h>
 
 #include <SDL.h>
 
 #include "cmd_tlm.hpp"
+#include "control_sender.hpp"
+#include "frame_receiver.hpp"
+#include "hud.hpp"
+#include "pt1_color.h"
 
 using namespace std;
 
@@ -160,19 +165,34 @@ SDL_Joystick *getJoystick() {
 int main(int argc, char* argv[]) {
   const char *address = "127.0.0.1";
   int port = 1995;
+  // Most control packets a second.
+  int control_rate = 100;
+  // Percentage of frames the playout delay is long enough for, 0 presents
+  // them as they arrive.
+  int jitter_percentile = 95;
   switch (argc) {
   default:
+  case 5:
+    jitter_percentile = stoi(argv[4]);
+  case 4:
+    control_rate = stoi(argv[3]);
   case 3:
     port = stoi(argv[2]);
   case 2:
     address = argv[1];
   case 1:
   case 0:;
+  }
+  if (control_rate < 1 || jitter_percentile < 0 || jitter_percentile > 100) {
+    cout << "Usage: gse [address] [port] [control_rate >= 1] [jitter_percentile 0 to 100]" << endl;
+    return 1;
   }
 
     try {
     UDPSocket s;
     s.connect(address, port);
+    // So the receive thread sees it's stopped.
+    s.setReceiveTimeout(100);
     UDPSplitPacketWriter w(0, s);
     UDPSplitPacketReader r(s);
     CmdTlm cmdtlm(&r, &w);
@@ -204,6 +224,29 @@ int main(int argc, char* argv[]) {
     }
     bool run = true;
     float last_thrust = -1;
+    // F hands control to the drone's onboard target following by sending
+    // handover packets instead of the sticks. Pressing it again takes control
+    // back immediately.
+    bool follow = false;
+    // Input is sampled at the control rate. The window is redrawn when a
+    // frame is due, which is checked as often, and otherwise every
+    // RENDER_INTERVAL ms.
+    const Uint32 RENDER_INTERVAL = 40;
+    Uint32 last_render = 0;
+    ControlSender sender(&cmdtlm, control_rate);
+    sender.start();
+    FrameReceiver receiver(&cmdtlm, &r);
+    receiver.playout.percentile = jitter_percentile / 100.0;
+    receiver.start();
+    // H hides and shows it.
+    Hud hud;
+    LinkStats link;
+    // Only the frame displayed is colorized.
+    TelemetryFrame frame;
+    bool have_frame = false;
+    uint8_t rgb[60][80][3];
+    struct pt1_colormap colormap;
+    pt1_colormap_init(&colormap, PT1_PALETTE_GRAYSCALE);
     while (run) {
 
       // Setup game controllers
@@ -220,29 +263,65 @@ int main(int argc, char* argv[]) {
           run = false;
           continue;
         }
+        if (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_F && !e.key.repeat) {
+          follow = !follow;
+          cout << (follow ? "Following onboard" : "Manual control") << endl;
+        }
+        if (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_H && !e.key.repeat) {
+          hud.visible = !hud.visible;
+        }
       }
       ControlPacketElement c;
       // Direction inputted with WASDQE or arrowkeys and page up/down.
-      if (joystick) {
-        cmdtlm.control(handleJoystick(joystick));
+      if (follow) {
+        // The drone flies itself, this only keeps its link-loss watchdog fed.
+        c.flags = ControlPacketElement::HANDOVER;
+      } else if (joystick) {
+        c = handleJoystick(joystick);
         last_thrust = -1.0;
       } else {
-        cmdtlm.control(handleKeyboard(last_thrust));
+        c = handleKeyboard(last_thrust);
       }
+      sender.post(c);
 
-      unsigned char *pixels;
-      int pixel_pitch;
-      SDL_LockTexture(texture, NULL, (void **)&pixels, &pixel_pitch);
-      for (int i = 0; i < pixel_pitch * 60; i += 3) {
-        pixels[i] = pixels[i + 1] = pixels[i + 2] = rand();
+      // The texture is only uploaded when a new frame is due.
+      bool new_frame = receiver.take(frame);
+      if (!new_frame && SDL_GetTicks() - last_render < RENDER_INTERVAL) {
+        SDL_Delay(1000 / control_rate);
+        continue;
+      }
+      last_render = SDL_GetTicks();
+      if (new_frame) {
+        if (frame.eight_bit) {
+          pt1_colorize_8bit(&colormap, &frame.pixels8[0][0], 80 * 60, &rgb[0][0][0]);
+        } else {
+          pt1_colorize_auto(&colormap, &frame.pixels[0][0], 80 * 60, &rgb[0][0][0]);
+        }
+        unsigned char *pixels;
+        int pixel_pitch;
+        SDL_LockTexture(texture, NULL, (void **)&pixels, &pixel_pitch);
+        for (int y = 0; y < 60; y++) {
+          memcpy(pixels + y * pixel_pitch, rgb[y], sizeof(rgb[y]));
+        }
+        SDL_UnlockTexture(texture);
+        have_frame = true;
       }
-      SDL_UnlockTexture(texture);
       SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
       SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
+      if (have_frame) {
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+      }
+      if (receiver.takeStats(link)) {
+        hud.update(link, receiver.playout);
+      }
+      hud.draw(renderer);
       SDL_RenderPresent(renderer);
-      SDL_Delay(400);
+      if (new_frame) {
+        hud.frameDisplayed(frame);
+      }
     }
+    receiver.stop();
+    sender.stop();
 
     // SDL_Delay(3000);
 
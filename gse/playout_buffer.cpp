@@ -0,0 +1,151 @@
+#include "playout_buffer.hpp"
+#include <string.h>
+
+// Length of the windows the fastest transit is kept over, in ms.
+static const uint32_t TRANSIT_WINDOW = 10000;
+// Every DECAY_INTERVAL ms the jitter histogram keeps DECAY of its weight, so
+// it follows the last few seconds.
+static const uint32_t DECAY_INTERVAL = 1000;
+static const float DECAY = 0.8f;
+// Frames a frame can be older than the one presented and still be late
+// rather than from a restarted fsw, whose numbers and clock start over.
+static const int32_t MAX_GAP = 64;
+
+/**
+ * Whether a is before b, modulo 2^32.
+ */
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t) (a - b) < 0;
+}
+
+PlayoutBuffer::PlayoutBuffer()
+  : percentile(0.95), max_delay(MAX_JITTER), presented(0), late(0), superseded(0) {
+  restart();
+}
+
+void PlayoutBuffer::restart() {
+  count = 0;
+  armed = false;
+  memset(histogram, 0, sizeof(histogram));
+  histogram_total = 0;
+  have_presented = false;
+  delay = 0;
+}
+
+uint32_t PlayoutBuffer::fastest() const {
+  return before(window_min, previous_min) ? window_min : previous_min;
+}
+
+uint32_t PlayoutBuffer::due(const TelemetryFrame &frame) const {
+  return frame.info.captured + fastest() + delay;
+}
+
+void PlayoutBuffer::addJitter(uint32_t now, int jitter) {
+  if (now - last_decay >= DECAY_INTERVAL) {
+    for (int i = 0; i <= MAX_JITTER; i++) {
+      histogram[i] *= DECAY;
+    }
+    histogram_total *= DECAY;
+    last_decay = now;
+  }
+  jitter = jitter < 0 ? 0 : jitter > MAX_JITTER ? MAX_JITTER : jitter;
+  histogram[jitter]++;
+  histogram_total++;
+}
+
+void PlayoutBuffer::adapt() {
+  float goal = percentile * histogram_total, sum = 0;
+  int target;
+  for (target = 0; target < MAX_JITTER; target++) {
+    sum += histogram[target];
+    if (sum >= goal) {
+      break;
+    }
+  }
+  target = target > max_delay ? max_delay : target;
+  int d = delay;
+  if (target > d) {
+    delay = target;
+  } else if (target < d) {
+    delay = d - 1;
+  }
+}
+
+void PlayoutBuffer::push(const TelemetryFrame &frame) {
+  if (have_presented && (int32_t) (presented_number - frame.info.number) > MAX_GAP) {
+    restart();
+  } else if (have_presented && (int32_t) (frame.info.number - presented_number) <= 0) {
+    late++;
+    return;
+  }
+  if (percentile > 0) {
+    // Plus the clocks' offset, which cancels out.
+    uint32_t transit = frame.arrived - frame.info.captured;
+    if (!armed || frame.arrived - window_start > TRANSIT_WINDOW) {
+      previous_min = armed ? window_min : transit;
+      window_min = transit;
+      window_start = frame.arrived;
+      if (!armed) {
+        last_decay = frame.arrived;
+      }
+      armed = true;
+    }
+    window_min = before(transit, window_min) ? transit : window_min;
+    int jitter = transit - fastest();
+    addJitter(frame.arrived, jitter);
+    adapt();
+    // Arrived after it was due.
+    if (jitter > delay) {
+      late++;
+      return;
+    }
+  }
+  if (count < SIZE) {
+    frames[count++] = frame;
+    return;
+  }
+  // Full, the oldest goes.
+  int oldest = 0;
+  for (int i = 1; i < count; i++) {
+    if ((int32_t) (frames[i].info.number - frames[oldest].info.number) < 0) {
+      oldest = i;
+    }
+  }
+  frames[oldest] = frame;
+  superseded++;
+}
+
+bool PlayoutBuffer::take(uint32_t now, TelemetryFrame &frame) {
+  int newest = -1;
+  for (int i = 0; i < count; i++) {
+    if (percentile > 0 && before(now, due(frames[i]))) {
+      continue;
+    }
+    if (newest < 0 || (int32_t) (frames[i].info.number - frames[newest].info.number) > 0) {
+      newest = i;
+    }
+  }
+  if (newest < 0) {
+    return false;
+  }
+  frame = frames[newest];
+  // It and the frames before it leave the buffer.
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if ((int32_t) (frames[i].info.number - frame.info.number) >= 0) {
+      if (i != newest) {
+        if (i != kept) {
+          frames[kept] = frames[i];
+        }
+        kept++;
+      }
+    } else {
+      superseded++;
+    }
+  }
+  count = kept;
+  presented_number = frame.info.number;
+  have_presented = true;
+  presented++;
+  return true;
+}
@@ -0,0 +1,80 @@
+#ifndef PLAYOUT_BUFFER_HPP
+#define PLAYOUT_BUFFER_HPP
+
+#include <atomic>
+#include <stdint.h>
+#include "telemetry_frame.hpp"
+
+using namespace std;
+
+/**
+ * Adaptive jitter buffer: holds frames back so they are presented at the
+ * pace they were captured, not in the bursts UDPSplitPacketReader
+ * reassembles them in.
+ *
+ * A frame's transit is its arrival on the GSE's clock minus its capture on
+ * fsw's. The clocks' offset is unknown but constant, so the fastest transit
+ * of the last 10 to 20 seconds is taken as no jitter, and a frame is due
+ * delay ms later than it would have been at that transit. The jitter of
+ * every frame goes into a histogram that forgets over a few seconds, and the
+ * delay follows its percentile: at once when the jitter grows, so frames
+ * stop being late, and by 1 ms a frame when it shrinks, so presentation
+ * doesn't jump.
+ *
+ * A frame arriving after it was due, or older than the one presented, is
+ * late and dropped rather than holding up newer ones. Of several frames due
+ * at once only the newest is presented. A frame much older than the one
+ * presented is from a restarted fsw, and the buffer starts over.
+ *
+ * With percentile 0 frames are presented as they arrive. Only from one
+ * thread; the counters can be read from others.
+ */
+class PlayoutBuffer {
+public:
+  static const int SIZE = 16;
+  // Range of the jitter histogram in ms, larger jitter is counted as this.
+  static const int MAX_JITTER = 500;
+  // Fraction of frames whose jitter the delay hides.
+  double percentile;
+  // Most the delay can be, in ms.
+  int max_delay;
+  // Playout delay beyond the fastest transit, in ms.
+  atomic<int> delay;
+  // Frames presented, dropped as late, and dropped for a newer frame due at
+  // the same time or a full buffer.
+  atomic<unsigned long> presented, late, superseded;
+
+  PlayoutBuffer();
+  /**
+   * A frame, with its arrival time, from the receive thread.
+   */
+  void push(const TelemetryFrame &frame);
+  /**
+   * Copies the newest frame due at now, the GSE's clock in ms, to frame and
+   * returns true, or returns false if none is due.
+   */
+  bool take(uint32_t now, TelemetryFrame &frame);
+
+private:
+  TelemetryFrame frames[SIZE];
+  int count;
+  // Fastest transit of this window and the last, and when this one started.
+  uint32_t window_min, previous_min, window_start;
+  bool armed;
+  float histogram[MAX_JITTER + 1];
+  float histogram_total;
+  uint32_t last_decay;
+  // FrameInfo::number of the frame presented last.
+  uint32_t presented_number;
+  bool have_presented;
+  uint32_t fastest() const;
+  uint32_t due(const TelemetryFrame &frame) const;
+  void addJitter(uint32_t now, int jitter);
+  void adapt();
+  /**
+   * Forgets the frames, transits and jitter of the last fsw session.
+   */
+  void restart();
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef TELEMETRY_FRAME_HPP
+#define TELEMETRY_FRAME_HPP
+
+#include <stdint.h>
+#include "packet_elements.hpp"
+
+/**
+ * An LWIR frame from fsw, 16 bit or, after fsw's gain control, 8 bit.
+ */
+struct TelemetryFrame {
+  uint16_t pixels[60][80];
+  uint8_t pixels8[60][80];
+  bool eight_bit;
+  FrameInfo info;
+  // Frames received up to and including this one.
+  unsigned long number;
+  // When it was captured on the GSE's clock in ms, if known.
+  bool synchronized;
+  uint32_t captured;
+  // When it was received on the GSE's clock in ms.
+  uint32_t arrived;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "background.hpp"
+#include "motion.hpp"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#define PIXELS (PT1_WIDTH * PT1_HEIGHT)
+
+// By value so the compiler vectorizes the loops using them.
+static inline uint8_t max3(uint8_t a, uint8_t b, uint8_t c) {
+  uint8_t m = a > b ? a : b;
+  return m > c ? m : c;
+}
+
+static inline uint8_t min3(uint8_t a, uint8_t b, uint8_t c) {
+  uint8_t m = a < b ? a : b;
+  return m < c ? m : c;
+}
+
+BackgroundDetector::BackgroundDetector()
+  : rate(0.02f), foreground_rate(0.002f), sigmas(4), min_difference(20), min_variance(9),
+    hot_only(true), cleanup(true), warmup_frames(20) {
+  reset();
+}
+
+void BackgroundDetector::reset() {
+  frames = 0;
+  count = 0;
+  memset(mask, 0, sizeof(mask));
+  memset(cleaned, 0, sizeof(cleaned));
+}
+
+const float *BackgroundDetector::background() const {
+  return mean;
+}
+
+const uint8_t *BackgroundDetector::foreground() const {
+  return cleaned;
+}
+
+void BackgroundDetector::update(const uint16_t *frame) {
+  if (!frames) {
+    for (int i = 0; i < PIXELS; i++) {
+      mean[i] = frame[i];
+      variance[i] = min_variance;
+    }
+  }
+  frames++;
+  // A plain mean while warming up so the first frame doesn't linger.
+  const float background_rate = std::max(rate, 1.0f / frames);
+  const float target_rate = frames > warmup_frames ? foreground_rate : background_rate;
+  const float sigmas2 = sigmas * sigmas;
+  const float min_difference2 = min_difference * min_difference;
+  // With hot_only cold differences become 0 and are never foreground.
+  const float cold = hot_only ? 0 : 1;
+  uint16_t *s = &strength[0][0];
+  // One pass over contiguous arrays without branches so the compiler
+  // vectorizes it. Squares are compared to avoid a square root per pixel.
+  for (int i = 0; i < PIXELS; i++) {
+    float d = frame[i] - mean[i];
+    float d2 = d * d;
+    float threshold2 = std::max(sigmas2 * variance[i], min_difference2);
+    float directed = std::max(d, -d * cold);
+    int fg = (directed > 0) & (d2 > threshold2);
+    int strong = (directed > 0) & (d2 > 4 * threshold2);
+    mask[i] = fg | (strong << 1);
+    float magnitude = std::min(std::max(directed, 1.0f), 65535.0f);
+    s[i] = fg ? (uint16_t) (int32_t) magnitude : 0;
+    float a = fg ? target_rate : background_rate;
+    mean[i] += a * d;
+    variance[i] = std::max(variance[i] + a * (d2 - variance[i]), min_variance);
+  }
+}
+
+void BackgroundDetector::compensate(float dx, float dy) {
+  if (!frames) {
+    return;
+  }
+  shiftImage(mean, shifted, PT1_WIDTH, PT1_HEIGHT, dx, dy);
+  memcpy(mean, shifted, sizeof(mean));
+  shiftImage(variance, shifted, PT1_WIDTH, PT1_HEIGHT, dx, dy);
+  memcpy(variance, shifted, sizeof(variance));
+
+  // The edge copies are only a guess at what came into view. Widen them so a
+  // hot target is still found but the terrain isn't.
+  const float exposed = 4 * min_difference * min_difference;
+  int left = dx > 0 ? (int) ceilf(dx) : 0, right = dx < 0 ? (int) ceilf(-dx) : 0;
+  int top = dy > 0 ? (int) ceilf(dy) : 0, bottom = dy < 0 ? (int) ceilf(-dy) : 0;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      if (x < left || x >= PT1_WIDTH - right || y < top || y >= PT1_HEIGHT - bottom) {
+        float &v = variance[y * PT1_WIDTH + x];
+        v = std::max(v, exposed);
+      }
+    }
+  }
+}
+
+void BackgroundDetector::clean() {
+  const int W = PT1_WIDTH + 2;
+  const int H = PT1_HEIGHT + 2;
+  memset(padded, 0, sizeof(padded));
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      padded[y + 1][x + 1] = mask[y * PT1_WIDTH + x] & 1;
+    }
+  }
+
+  // Count the foreground neighbors with a separable 3x3 sum and keep pixels
+  // that have one or are strong on their own.
+  for (int y = 0; y < H; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      rows[y][x] = padded[y][x - 1] + padded[y][x] + padded[y][x + 1];
+    }
+  }
+  for (int y = 1; y < H - 1; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      int neighbors = rows[y - 1][x] + rows[y][x] + rows[y + 1][x] - padded[y][x];
+      uint8_t m = mask[(y - 1) * PT1_WIDTH + x - 1];
+      cleaned[(y - 1) * PT1_WIDTH + x - 1] = m & ((neighbors > 0) | (m >> 1)) & 1;
+    }
+  }
+
+  // Closing: dilate then erode, both separable. Outside the frame counts as
+  // foreground for the erosion so targets on the edge aren't eaten.
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      padded[y + 1][x + 1] = cleaned[y * PT1_WIDTH + x];
+    }
+  }
+  for (int y = 0; y < H; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      rows[y][x] = max3(padded[y][x - 1], padded[y][x], padded[y][x + 1]);
+    }
+  }
+  for (int y = 1; y < H - 1; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      padded[y][x] = max3(rows[y - 1][x], rows[y][x], rows[y + 1][x]);
+    }
+  }
+  for (int x = 0; x < W; x++) {
+    padded[0][x] = padded[H - 1][x] = 1;
+  }
+  for (int y = 0; y < H; y++) {
+    padded[y][0] = padded[y][W - 1] = 1;
+  }
+  for (int y = 0; y < H; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      rows[y][x] = min3(padded[y][x - 1], padded[y][x], padded[y][x + 1]);
+    }
+  }
+  uint16_t *s = &strength[0][0];
+  for (int y = 1; y < H - 1; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      int i = (y - 1) * PT1_WIDTH + x - 1;
+      uint8_t closed = min3(rows[y - 1][x], rows[y][x], rows[y + 1][x]);
+      // Dropped pixels lose their strength, pixels added by the closing only
+      // join fragments so they get the least weight.
+      uint16_t kept = s[i] * cleaned[i];
+      s[i] = closed ? (kept > 1 ? kept : 1) : 0;
+      cleaned[i] = closed;
+    }
+  }
+}
+
+int BackgroundDetector::detect(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) {
+  update(&frame[0][0]);
+  if (frames <= warmup_frames) {
+    count = 0;
+    return count;
+  }
+  if (cleanup) {
+    clean();
+  } else {
+    for (int i = 0; i < PIXELS; i++) {
+      cleaned[i] = mask[i] & 1;
+    }
+  }
+  count = blobs.extract(strength, frame, detections, MAX_DETECTIONS);
+  return count;
+}
@@ -0,0 +1,62 @@
+#ifndef BACKGROUND_HPP
+#define BACKGROUND_HPP
+
+#include "detection.hpp"
+
+/**
+ * Detects small moving targets against a slowly changing background, e.g.
+ * bats flying past warm rocks or rooftops that a fixed threshold would pick up.
+ *
+ * Every pixel has a running Gaussian background model. A pixel is foreground
+ * when it differs from the mean by more than sigmas standard deviations and
+ * by at least min_difference counts. Background pixels update the model with
+ * rate, foreground pixels with foreground_rate so a target that stops is only
+ * absorbed slowly. Isolated foreground pixels are dropped unless they are twice
+ * over the threshold, then a 3x3 closing joins fragments of the same target.
+ */
+class BackgroundDetector : public Detector {
+public:
+  float rate, foreground_rate;
+  float sigmas;
+  float min_difference;
+  // Floor of the variance so a perfectly still pixel doesn't trigger on noise.
+  float min_variance;
+  // Only pixels warmer than the background are foreground.
+  bool hot_only;
+  // Drop isolated pixels and close the mask.
+  bool cleanup;
+  // Frames learned after a reset before anything is detected.
+  int warmup_frames;
+  BackgroundDetector();
+  virtual int detect(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]);
+  virtual void reset();
+  /**
+   * Shifts the background model. Pixels that came into view get a wide
+   * variance until they are learned.
+   */
+  virtual void compensate(float dx, float dy);
+  /**
+   * Background model, e.g. to display it.
+   */
+  const float *background() const;
+  /**
+   * Foreground mask of the last frame after cleanup, 1 for foreground.
+   */
+  const uint8_t *foreground() const;
+private:
+  int frames;
+  float mean[PT1_HEIGHT * PT1_WIDTH];
+  float variance[PT1_HEIGHT * PT1_WIDTH];
+  float shifted[PT1_HEIGHT * PT1_WIDTH];
+  // Foreground is bit 0, twice over the threshold is bit 1.
+  uint8_t mask[PT1_HEIGHT * PT1_WIDTH];
+  // Masks with a border of 1 pixel for the 3x3 operations.
+  uint8_t padded[PT1_HEIGHT + 2][PT1_WIDTH + 2];
+  uint8_t rows[PT1_HEIGHT + 2][PT1_WIDTH + 2];
+  uint8_t cleaned[PT1_HEIGHT * PT1_WIDTH];
+  uint16_t strength[PT1_HEIGHT][PT1_WIDTH];
+  void update(const uint16_t *frame);
+  void clean();
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CIARAN_HPP
+#define CIARAN_HPP
+
+#include "detection.hpp"
+#include "background.hpp"
+#include "tracker.hpp"
+#include "scene.hpp"
+#include "motion.hpp"
+#include "servo.hpp"
+#include "classifier.hpp"
+
+#endif
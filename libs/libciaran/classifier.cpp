@@ -0,0 +1,361 @@
+#include "classifier.hpp"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static inline int clampIndex(int v, int size) {
+  return v < 0 ? 0 : v >= size ? size - 1 : v;
+}
+
+/**
+ * int8 dot product accumulated in 32 bits. A plain loop so the compiler
+ * vectorizes it with widening multiplies.
+ */
+static int32_t dot(const int8_t *a, const int8_t *b, int n) {
+  int32_t sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+/**
+ * Scales an accumulator to the output, rounding to nearest, and saturates to
+ * int8, or to 0 to 127 with ReLU.
+ */
+static inline int8_t requantize(int32_t acc, int32_t multiplier, int shift, bool relu) {
+  int64_t v = (int64_t) acc * multiplier;
+  if (shift > 0) {
+    v = (v + ((int64_t) 1 << (shift - 1))) >> shift;
+  }
+  int64_t low = relu ? 0 : -128;
+  return (int8_t) (v < low ? low : v > 127 ? 127 : v);
+}
+
+Classifier::Classifier() : label(0), confidence(0), last_output(arena) {
+  clear(0);
+}
+
+void Classifier::clear(int class_count) {
+  this->class_count = class_count < MAX_CLASSES ? class_count : MAX_CLASSES;
+  memset(class_names, 0, sizeof(class_names));
+  layer_count = 0;
+  weight_count = 0;
+  bias_count = 0;
+  output_scale = 1;
+}
+
+Layer *Classifier::addLayer(Layer::Type type, int outputs, bool relu, int32_t multiplier,
+                            int shift) {
+  if (layer_count >= MAX_LAYERS || outputs <= 0 || shift < 0 || shift > 62) {
+    return NULL;
+  }
+  Layer l;
+  l.type = type;
+  l.relu = relu;
+  l.multiplier = multiplier;
+  l.shift = shift;
+  if (layer_count) {
+    const Layer &previous = layers[layer_count - 1];
+    l.in_height = previous.out_height;
+    l.in_width = previous.out_width;
+    l.in_channels = previous.out_channels;
+  } else {
+    l.in_height = l.in_width = CROP;
+    l.in_channels = 1;
+  }
+  int inputs_per_output = 0;
+  switch (type) {
+  case Layer::CONV:
+    l.out_height = l.in_height;
+    l.out_width = l.in_width;
+    l.out_channels = outputs;
+    inputs_per_output = 9 * l.in_channels;
+    if (outputs > MAX_CHANNELS) {
+      return NULL;
+    }
+    break;
+  case Layer::POOL:
+    l.out_height = l.in_height / 2;
+    l.out_width = l.in_width / 2;
+    l.out_channels = l.in_channels;
+    break;
+  case Layer::DENSE:
+    l.out_height = l.out_width = 1;
+    l.out_channels = outputs;
+    inputs_per_output = l.in_height * l.in_width * l.in_channels;
+    break;
+  default:
+    return NULL;
+  }
+  if (l.out_height * l.out_width * l.out_channels > ARENA_SIZE / 2 || !l.out_height) {
+    return NULL;
+  }
+  l.weights = weight_count;
+  l.biases = bias_count;
+  if (inputs_per_output) {
+    if (weight_count + l.out_channels * inputs_per_output > MAX_WEIGHTS ||
+        bias_count + l.out_channels > MAX_BIASES) {
+      return NULL;
+    }
+    weight_count += l.out_channels * inputs_per_output;
+    bias_count += l.out_channels;
+  }
+  layers[layer_count] = l;
+  return &layers[layer_count++];
+}
+
+int8_t *Classifier::weightData(const Layer &layer) {
+  return weight_data + layer.weights;
+}
+
+int32_t *Classifier::biasData(const Layer &layer) {
+  return bias_data + layer.biases;
+}
+
+/**
+ * Number of weights of each output of a layer, 0 if it has none.
+ */
+static int inputsPerOutput(const Layer &l) {
+  switch (l.type) {
+  case Layer::CONV:
+    return 9 * l.in_channels;
+  case Layer::DENSE:
+    return l.in_height * l.in_width * l.in_channels;
+  default:
+    return 0;
+  }
+}
+
+static bool readBytes(FILE *f, void *data, size_t length) {
+  return fread(data, 1, length, f) == length;
+}
+
+static bool readUnsigned(FILE *f, uint32_t &v, int bytes) {
+  uint8_t b[4];
+  if (!readBytes(f, b, bytes)) {
+    return false;
+  }
+  v = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    v = (v << 8) | b[i];
+  }
+  return true;
+}
+
+static bool writeUnsigned(FILE *f, uint32_t v, int bytes) {
+  uint8_t b[4];
+  for (int i = 0; i < bytes; i++) {
+    b[i] = v >> (8 * i);
+  }
+  return fwrite(b, 1, bytes, f) == (size_t) bytes;
+}
+
+bool Classifier::load(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+  char magic[4];
+  uint32_t classes, count, scale;
+  bool ok = readBytes(f, magic, 4) && !memcmp(magic, "CNN1", 4) &&
+            readUnsigned(f, classes, 1) && readUnsigned(f, count, 1) &&
+            readUnsigned(f, scale, 4) && classes > 0 && classes <= MAX_CLASSES;
+  if (ok) {
+    clear(classes);
+    memcpy(&output_scale, &scale, sizeof(output_scale));
+    ok = readBytes(f, class_names, 16 * class_count);
+  }
+  for (uint32_t i = 0; ok && i < count; i++) {
+    uint32_t type, relu, outputs, multiplier, shift;
+    ok = readUnsigned(f, type, 1) && readUnsigned(f, relu, 1) &&
+         readUnsigned(f, outputs, 2) && readUnsigned(f, multiplier, 4) &&
+         readUnsigned(f, shift, 1);
+    Layer *l = ok ? addLayer((Layer::Type) type, outputs, relu, (int32_t) multiplier, shift)
+                  : NULL;
+    ok = l != NULL;
+    int n = ok ? inputsPerOutput(*l) : 0;
+    for (int j = 0; ok && n && j < l->out_channels; j++) {
+      uint32_t bias;
+      ok = readUnsigned(f, bias, 4);
+      if (ok) {
+        biasData(*l)[j] = (int32_t) bias;
+      }
+    }
+    ok = ok && readBytes(f, weightData(*l), n * l->out_channels);
+  }
+  fclose(f);
+  // The last layer has to give a score per class.
+  ok = ok && layer_count && layers[layer_count - 1].out_channels == class_count &&
+       layers[layer_count - 1].out_height * layers[layer_count - 1].out_width == 1;
+  if (!ok) {
+    clear(0);
+  }
+  return ok;
+}
+
+bool Classifier::save(const char *filename) const {
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    return false;
+  }
+  uint32_t scale;
+  memcpy(&scale, &output_scale, sizeof(scale));
+  bool ok = fwrite("CNN1", 1, 4, f) == 4 && writeUnsigned(f, class_count, 1) &&
+            writeUnsigned(f, layer_count, 1) && writeUnsigned(f, scale, 4) &&
+            fwrite(class_names, 1, 16 * class_count, f) == (size_t) (16 * class_count);
+  for (int i = 0; ok && i < layer_count; i++) {
+    const Layer &l = layers[i];
+    int n = inputsPerOutput(l);
+    int outputs = l.type == Layer::POOL ? l.in_channels : l.out_channels;
+    ok = writeUnsigned(f, l.type, 1) && writeUnsigned(f, l.relu, 1) &&
+         writeUnsigned(f, outputs, 2) && writeUnsigned(f, (uint32_t) l.multiplier, 4) &&
+         writeUnsigned(f, l.shift, 1);
+    for (int j = 0; ok && n && j < l.out_channels; j++) {
+      ok = writeUnsigned(f, (uint32_t) bias_data[l.biases + j], 4);
+    }
+    ok = ok && fwrite(weight_data + l.weights, 1, n * l.out_channels, f) ==
+                   (size_t) (n * l.out_channels);
+  }
+  return !fclose(f) && ok;
+}
+
+void Classifier::crop(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], float x, float y,
+                      int8_t out[CROP * CROP]) {
+  int left = (int) floorf(x + 0.5f) - CROP / 2;
+  int top = (int) floorf(y + 0.5f) - CROP / 2;
+  uint16_t pixels[CROP * CROP];
+  for (int j = 0; j < CROP; j++) {
+    const uint16_t *row = frame[clampIndex(top + j, PT1_HEIGHT)];
+    for (int i = 0; i < CROP; i++) {
+      pixels[j * CROP + i] = row[clampIndex(left + i, PT1_WIDTH)];
+    }
+  }
+  // The background is the median, so the sensor noise around it is mostly
+  // 0 and skipped by the convolutions.
+  uint16_t sorted[CROP * CROP];
+  memcpy(sorted, pixels, sizeof(sorted));
+  std::nth_element(sorted, sorted + CROP * CROP / 2, sorted + CROP * CROP);
+  int background = sorted[CROP * CROP / 2];
+  for (int i = 0; i < CROP * CROP; i++) {
+    int v = (pixels[i] - background) >> 4;
+    out[i] = v < 0 ? 0 : v > 127 ? 127 : v;
+  }
+}
+
+void Classifier::conv(const Layer &l, const int8_t *in, int8_t *out) {
+  const int c = l.in_channels, m = l.out_channels;
+  const int8_t *weights = weight_data + l.weights;
+  const int32_t *biases = bias_data + l.biases;
+  // Local so the compiler knows it doesn't alias the weights.
+  int32_t accumulators[MAX_CHANNELS];
+  for (int y = 0; y < l.out_height; y++) {
+    for (int x = 0; x < l.out_width; x++) {
+      for (int k = 0; k < m; k++) {
+        accumulators[k] = biases[k];
+      }
+      // Every input adds its weights to all the output channels at once, which
+      // vectorizes over the channels. Inputs after a ReLU and the cold sky
+      // around a target are mostly 0, and skipped.
+      for (int sy = y - 1; sy <= y + 1; sy++) {
+        for (int sx = x - 1; sx <= x + 1; sx++) {
+          if (sy < 0 || sy >= l.in_height || sx < 0 || sx >= l.in_width) {
+            continue;
+          }
+          const int8_t *v = in + (sy * l.in_width + sx) * c;
+          const int8_t *w = weights + ((sy - y + 1) * 3 + sx - x + 1) * c * m;
+          for (int j = 0; j < c; j++, w += m) {
+            if (!v[j]) {
+              continue;
+            }
+            const int32_t value = v[j];
+            for (int k = 0; k < m; k++) {
+              accumulators[k] += value * w[k];
+            }
+          }
+        }
+      }
+      int8_t *o = out + (y * l.out_width + x) * m;
+      for (int k = 0; k < m; k++) {
+        o[k] = requantize(accumulators[k], l.multiplier, l.shift, l.relu);
+      }
+    }
+  }
+}
+
+void Classifier::pool(const Layer &l, const int8_t *in, int8_t *out) {
+  const int c = l.in_channels;
+  for (int y = 0; y < l.out_height; y++) {
+    const int8_t *a = in + 2 * y * l.in_width * c;
+    const int8_t *b = a + l.in_width * c;
+    for (int x = 0; x < l.out_width; x++) {
+      int8_t *o = out + (y * l.out_width + x) * c;
+      for (int k = 0; k < c; k++) {
+        int8_t m = a[2 * x * c + k];
+        m = a[(2 * x + 1) * c + k] > m ? a[(2 * x + 1) * c + k] : m;
+        m = b[2 * x * c + k] > m ? b[2 * x * c + k] : m;
+        m = b[(2 * x + 1) * c + k] > m ? b[(2 * x + 1) * c + k] : m;
+        o[k] = m;
+      }
+    }
+  }
+}
+
+void Classifier::dense(const Layer &l, const int8_t *in, int8_t *out) {
+  const int n = l.in_height * l.in_width * l.in_channels;
+  const int8_t *weights = weight_data + l.weights;
+  const int32_t *biases = bias_data + l.biases;
+  for (int k = 0; k < l.out_channels; k++) {
+    int32_t acc = biases[k] + dot(in, weights + k * n, n);
+    out[k] = requantize(acc, l.multiplier, l.shift, l.relu);
+  }
+}
+
+int Classifier::classify(const int8_t input[CROP * CROP]) {
+  label = 0;
+  confidence = 0;
+  if (!layer_count) {
+    return label;
+  }
+  int8_t *halves[2] = {arena, arena + ARENA_SIZE / 2};
+  memcpy(halves[0], input, CROP * CROP);
+  for (int i = 0; i < layer_count; i++) {
+    const Layer &l = layers[i];
+    const int8_t *in = halves[i & 1];
+    int8_t *out = halves[~i & 1];
+    switch (l.type) {
+    case Layer::CONV:
+      conv(l, in, out);
+      break;
+    case Layer::POOL:
+      pool(l, in, out);
+      break;
+    case Layer::DENSE:
+      dense(l, in, out);
+      break;
+    }
+    last_output = out;
+  }
+
+  // Softmax of the best class.
+  for (int k = 1; k < class_count; k++) {
+    label = last_output[k] > last_output[label] ? k : label;
+  }
+  float sum = 0;
+  for (int k = 0; k < class_count; k++) {
+    sum += expf((last_output[k] - last_output[label]) * output_scale);
+  }
+  confidence = (uint8_t) (255 / sum + 0.5f);
+  return label;
+}
+
+int Classifier::classify(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], float x, float y) {
+  int8_t input[CROP * CROP];
+  crop(frame, x, y, input);
+  return classify(input);
+}
+
+const int8_t *Classifier::output() const {
+  return last_output;
+}
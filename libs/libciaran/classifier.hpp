@@ -0,0 +1,121 @@
+#ifndef CLASSIFIER_HPP
+#define CLASSIFIER_HPP
+
+#include <stdint.h>
+#include "pt1.h"
+
+/**
+ * One layer of a Classifier's network. Tensors are int8 in height, width,
+ * channel order with a zero point of 0.
+ */
+class Layer {
+public:
+  enum Type {
+    // 3x3 convolution with zero padding, same size out.
+    CONV = 1,
+    // 2x2 max pooling, half size out.
+    POOL = 2,
+    // Fully connected.
+    DENSE = 3
+  };
+  Type type;
+  bool relu;
+  // Shape of the input and output tensors.
+  int in_height, in_width, in_channels;
+  int out_height, out_width, out_channels;
+  // Accumulators are scaled to the output by multiplier / 2^shift.
+  int32_t multiplier;
+  int shift;
+  // Into the Classifier's weight and bias storage. Weights are
+  // [3][3][in_channels][out_channels] for CONV and [outputs][inputs] for DENSE.
+  int weights, biases;
+};
+
+/**
+ * Small CPU only int8 convolutional network that labels the crop around a
+ * detection, e.g. bat, bird, insect or warm background.
+ *
+ * The crop is CROP x CROP pixels centered on the detection, in counts above
+ * its median divided by 16 so the network sees how warm the target is.
+ * Layers run one after the other, ping-ponging between two halves of a fixed
+ * arena. Weights and biases live in fixed arrays too, so nothing is allocated
+ * after construction and a model that doesn't fit is rejected when loaded.
+ *
+ * Model file, little endian:
+ * - "CNN1", uint8 class count, uint8 layer count, float output scale
+ * - 16 byte class name per class
+ * - per layer: uint8 type, uint8 relu, uint16 outputs (channels for CONV),
+ *   int32 multiplier, uint8 shift, then for CONV and DENSE int32 biases and
+ *   int8 weights
+ */
+class Classifier {
+public:
+  static const int CROP = 16;
+  static const int MAX_CLASSES = 8;
+  static const int MAX_LAYERS = 8;
+  static const int ARENA_SIZE = 2 * 8192;
+  static const int MAX_WEIGHTS = 32768;
+  static const int MAX_BIASES = 512;
+  // Of a convolution's output.
+  static const int MAX_CHANNELS = 64;
+
+  Layer layers[MAX_LAYERS];
+  int layer_count;
+  char class_names[MAX_CLASSES][16];
+  int class_count;
+  // Of the last layer's output, to turn it into probabilities.
+  float output_scale;
+  // Of the last classification, confidence from 0 to 255.
+  int label;
+  uint8_t confidence;
+
+  Classifier();
+  /**
+   * Starts an empty model with class_count classes. Add layers with
+   * addLayer, then set the weights and biases they point to.
+   */
+  void clear(int class_count);
+  /**
+   * Appends a layer after the last one and returns it, or NULL if the model
+   * is full. The first layer's input is the crop.
+   */
+  Layer *addLayer(Layer::Type type, int outputs, bool relu, int32_t multiplier, int shift);
+  int8_t *weightData(const Layer &layer);
+  int32_t *biasData(const Layer &layer);
+  /**
+   * Loads a model file. Returns false if it can't be read or doesn't fit.
+   */
+  bool load(const char *filename);
+  bool save(const char *filename) const;
+  /**
+   * Classifies the crop centered on (x, y). Returns the label, also in label
+   * and confidence.
+   */
+  int classify(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], float x, float y);
+  /**
+   * Runs the network on a crop prepared by crop and returns the label.
+   */
+  int classify(const int8_t input[CROP * CROP]);
+  /**
+   * The network input for the crop centered on (x, y). Pixels outside the
+   * frame are copies of the edge.
+   */
+  static void crop(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], float x, float y,
+                   int8_t out[CROP * CROP]);
+  /**
+   * Output of the last layer of the last classification.
+   */
+  const int8_t *output() const;
+private:
+  int8_t weight_data[MAX_WEIGHTS];
+  int32_t bias_data[MAX_BIASES];
+  int weight_count, bias_count;
+  // Two tensors.
+  int8_t arena[ARENA_SIZE];
+  const int8_t *last_output;
+  void conv(const Layer &l, const int8_t *in, int8_t *out);
+  void pool(const Layer &l, const int8_t *in, int8_t *out);
+  void dense(const Layer &l, const int8_t *in, int8_t *out);
+};
+
+#endif
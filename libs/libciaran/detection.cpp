@@ -0,0 +1,146 @@
+#include "detection.hpp"
+#include <algorithm>
+#include <string.h>
+
+BlobExtractor::BlobExtractor() : min_area(1), max_area(PT1_WIDTH * PT1_HEIGHT), labels(0) {
+}
+
+uint16_t BlobExtractor::find(uint16_t label) {
+  while (parent[label] != label) {
+    // Path halving keeps the trees flat without recursion.
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+  return label;
+}
+
+void BlobExtractor::join(uint16_t a, uint16_t b) {
+  a = find(a);
+  b = find(b);
+  // The smaller label is always the root so roots are merged in order.
+  if (a < b) {
+    parent[b] = a;
+  } else if (b < a) {
+    parent[a] = b;
+  }
+}
+
+void BlobExtractor::merge(Sums &into, const Sums &from) {
+  into.weight += from.weight;
+  into.weight_x += from.weight_x;
+  into.weight_y += from.weight_y;
+  into.area += from.area;
+  into.peak = std::max(into.peak, from.peak);
+  into.min_x = std::min(into.min_x, from.min_x);
+  into.min_y = std::min(into.min_y, from.min_y);
+  into.max_x = std::max(into.max_x, from.max_x);
+  into.max_y = std::max(into.max_y, from.max_y);
+}
+
+int BlobExtractor::extract(const uint16_t strength[PT1_HEIGHT][PT1_WIDTH],
+                           const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], Detection *detections,
+                           int max) {
+  int count = 0;
+  int previous_row = 0;
+  labels = 0;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    const uint16_t *s = strength[y];
+    const int row = labels;
+    int previous = previous_row;
+    int x = 0;
+    while (x < PT1_WIDTH) {
+      // Skip background 4 pixels at a time.
+      uint64_t four;
+      while (x + 4 <= PT1_WIDTH && (memcpy(&four, s + x, sizeof(four)), !four)) {
+        x += 4;
+      }
+      while (x < PT1_WIDTH && !s[x]) {
+        x++;
+      }
+      if (x >= PT1_WIDTH) {
+        break;
+      }
+
+      // Every run starts as its own label.
+      uint16_t label = labels++;
+      Sums &sum = sums[label];
+      sum.weight = sum.weight_x = 0;
+      sum.peak = 0;
+      sum.min_x = x;
+      sum.min_y = sum.max_y = y;
+      int start = x;
+      for (; x < PT1_WIDTH && s[x]; x++) {
+        sum.weight += s[x];
+        sum.weight_x += (uint64_t) s[x] * x;
+        sum.peak = std::max(sum.peak, frame[y][x]);
+      }
+      sum.weight_y = sum.weight * y;
+      sum.area = x - start;
+      sum.max_x = x - 1;
+      parent[label] = label;
+      runs[label].start = start;
+      runs[label].end = x - 1;
+
+      // Join with the runs of the previous row touching this one, diagonals
+      // included.
+      while (previous < row && runs[previous].end + 1 < start) {
+        previous++;
+      }
+      for (int p = previous; p < row && runs[p].start <= x; p++) {
+        join(label, p);
+      }
+    }
+    previous_row = row;
+  }
+
+  // Roots have the smallest label of their blob so every other label can be
+  // merged into its root in one pass.
+  uint16_t roots[MAX_RUNS];
+  for (int label = 0; label < labels; label++) {
+    uint16_t root = find(label);
+    if (root != label) {
+      merge(sums[root], sums[label]);
+    }
+  }
+  for (int label = 0; label < labels; label++) {
+    if (parent[label] == label && sums[label].area >= min_area && sums[label].area <= max_area) {
+      roots[count++] = label;
+    }
+  }
+
+  int found = count;
+  count = std::min(found, max);
+  std::partial_sort(roots, roots + count, roots + found,
+                    [this](uint16_t a, uint16_t b) { return sums[a].peak > sums[b].peak; });
+  for (int i = 0; i < count; i++) {
+    const Sums &sum = sums[roots[i]];
+    Detection &d = detections[i];
+    d.x = (float) sum.weight_x / sum.weight;
+    d.y = (float) sum.weight_y / sum.weight;
+    d.area = sum.area;
+    d.peak = sum.peak;
+    d.min_x = sum.min_x;
+    d.min_y = sum.min_y;
+    d.max_x = sum.max_x;
+    d.max_y = sum.max_y;
+  }
+  return count;
+}
+
+Detector::Detector() : count(0) {
+}
+
+HotSpotDetector::HotSpotDetector(uint16_t threshold) : threshold(threshold) {
+}
+
+int HotSpotDetector::detect(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) {
+  const uint16_t *in = &frame[0][0];
+  uint16_t *out = &strength[0][0];
+  const uint16_t t = threshold;
+  // Saturating subtract, no branches so the compiler vectorizes it.
+  for (int i = 0; i < PT1_WIDTH * PT1_HEIGHT; i++) {
+    out[i] = in[i] > t ? in[i] - t : 0;
+  }
+  count = blobs.extract(strength, frame, detections, MAX_DETECTIONS);
+  return count;
+}
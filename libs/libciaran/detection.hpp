@@ -0,0 +1,102 @@
+#ifndef DETECTION_HPP
+#define DETECTION_HPP
+
+#include <stdint.h>
+#include "pt1.h"
+
+/**
+ * A connected group of foreground pixels.
+ */
+class Detection {
+public:
+  // Centroid weighted by strength, in pixels. (0, 0) is the center of the top
+  // left pixel.
+  float x, y;
+  // Number of pixels.
+  uint16_t area;
+  // Hottest pixel in raw counts.
+  uint16_t peak;
+  // Bounding box, inclusive.
+  uint8_t min_x, min_y, max_x, max_y;
+};
+
+/**
+ * Finds 8-connected blobs of nonzero pixels in a strength image in a single
+ * pass over the frame. Runs of nonzero pixels are labeled and their sums
+ * accumulated as the rows are scanned, touching runs of the previous row are
+ * joined with union-find, and the sums of joined labels are merged once at
+ * the end. All storage is preallocated so the time per frame only depends on
+ * the number of runs.
+ */
+class BlobExtractor {
+public:
+  static const int MAX_RUNS = PT1_HEIGHT * (PT1_WIDTH / 2);
+  // Blobs smaller or larger than this are dropped.
+  int min_area, max_area;
+  BlobExtractor();
+  /**
+   * Fills detections with up to max blobs of strength, hottest peak in frame
+   * first, and returns how many were found. Pixels with a strength of 0 are
+   * background, others are weighted by their strength for the centroid.
+   */
+  int extract(const uint16_t strength[PT1_HEIGHT][PT1_WIDTH],
+              const uint16_t frame[PT1_HEIGHT][PT1_WIDTH], Detection *detections, int max);
+private:
+  // Run i has label i until it is joined.
+  struct Run {
+    uint8_t start, end;
+  };
+  struct Sums {
+    uint64_t weight, weight_x, weight_y;
+    uint16_t area, peak;
+    uint8_t min_x, min_y, max_x, max_y;
+  };
+  Run runs[MAX_RUNS];
+  uint16_t parent[MAX_RUNS];
+  Sums sums[MAX_RUNS];
+  int labels;
+  uint16_t find(uint16_t label);
+  void join(uint16_t a, uint16_t b);
+  void merge(Sums &into, const Sums &from);
+};
+
+/**
+ * Finds targets in LWIR frames.
+ */
+class Detector {
+public:
+  static const int MAX_DETECTIONS = 64;
+  BlobExtractor blobs;
+  Detection detections[MAX_DETECTIONS];
+  int count;
+  Detector();
+  virtual ~Detector() {}
+  /**
+   * Finds the targets in frame. Results are in detections and count.
+   */
+  virtual int detect(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) = 0;
+  /**
+   * Forgets everything learned from previous frames, e.g. after an FFC.
+   */
+  virtual void reset() {}
+  /**
+   * Moves everything learned from previous frames by dx and dy pixels when the
+   * whole scene moved, e.g. because the camera turned.
+   */
+  virtual void compensate(float, float) {}
+};
+
+/**
+ * Detects targets hotter than a fixed threshold, e.g. bats against the sky.
+ */
+class HotSpotDetector : public Detector {
+public:
+  // Raw counts. Pixels above it are foreground.
+  uint16_t threshold;
+  HotSpotDetector(uint16_t threshold);
+  virtual int detect(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]);
+private:
+  uint16_t strength[PT1_HEIGHT][PT1_WIDTH];
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "motion.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline void store(uint16_t &out, float value) {
+  out = value + 0.5f;
+}
+
+static inline void store(float &out, float value) {
+  out = value;
+}
+
+static inline int clamp(int v, int low, int high) {
+  return v < low ? low : v > high ? high : v;
+}
+
+// Widest tile shiftImage works on, so the column lookups fit on the stack.
+static const int MAX_TILE_WIDTH = 256;
+
+template <typename T>
+struct ShiftJob {
+  const T *in;
+  T *out;
+  int width, height;
+  int ix, iy;
+  float fx, fy;
+};
+
+template <typename T>
+static void shiftTile(void *context, int x0, int y0, int x1, int y1) {
+  const ShiftJob<T> &j = *(const ShiftJob<T> *) context;
+  // Locals, or the stores to a float image could overwrite them.
+  const int width = j.width, height = j.height, ix = j.ix, iy = j.iy, n = x1 - x0;
+  const float fx = j.fx, fy = j.fy;
+  // Source columns of every output column, clamped to the edges.
+  int left[MAX_TILE_WIDTH], right[MAX_TILE_WIDTH];
+  for (int x = 0; x < n; x++) {
+    left[x] = clamp(x0 + x - ix - 1, 0, width - 1);
+    right[x] = clamp(x0 + x - ix, 0, width - 1);
+  }
+  for (int y = y0; y < y1; y++) {
+    const T *above = j.in + clamp(y - iy - 1, 0, height - 1) * width;
+    const T *below = j.in + clamp(y - iy, 0, height - 1) * width;
+    T *row = j.out + y * width + x0;
+    for (int x = 0; x < n; x++) {
+      float top = fx * above[left[x]] + (1 - fx) * above[right[x]];
+      float bottom = fx * below[left[x]] + (1 - fx) * below[right[x]];
+      store(row[x], fy * top + (1 - fy) * bottom);
+    }
+  }
+}
+
+template <typename T>
+void shiftImage(const T *in, T *out, int width, int height, float dx, float dy,
+                task_pool *pool) {
+  ShiftJob<T> job;
+  job.in = in;
+  job.out = out;
+  job.width = width;
+  job.height = height;
+  job.ix = (int) floorf(dx);
+  job.iy = (int) floorf(dy);
+  job.fx = dx - job.ix;
+  job.fy = dy - job.iy;
+  if (!pool && width <= MAX_TILE_WIDTH) {
+    // In one piece, so it inlines for the Lepton frame size.
+    shiftTile<T>(&job, 0, 0, width, height);
+    return;
+  }
+  int tile_width = width < MAX_TILE_WIDTH ? width : MAX_TILE_WIDTH;
+  task_run_tiles(pool, width, height, tile_width, task_tile_rows(tile_width, sizeof(T)),
+                 shiftTile<T>, &job);
+}
+
+template void shiftImage<uint16_t>(const uint16_t *, uint16_t *, int, int, float, float,
+                                   task_pool *);
+template void shiftImage<float>(const float *, float *, int, int, float, float, task_pool *);
+
+/**
+ * Averages 2x2 blocks of a width by height image.
+ */
+static void downsample(const uint16_t *in, uint16_t *out, int width, int height) {
+  for (int y = 0; y < height / 2; y++) {
+    const uint16_t *a = in + 2 * y * width;
+    const uint16_t *b = a + width;
+    for (int x = 0; x < width / 2; x++) {
+      out[y * width / 2 + x] = (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2;
+    }
+  }
+}
+
+/**
+ * Sum of absolute differences between current and previous shifted by
+ * (sx, sy), over the part of the image margin pixels from the edges.
+ */
+static uint32_t sad(const uint16_t *current, const uint16_t *previous, int width, int height,
+                    int sx, int sy, int margin) {
+  uint32_t sum = 0;
+  for (int y = margin; y < height - margin; y++) {
+    const uint16_t *c = current + y * width;
+    const uint16_t *p = previous + (y - sy) * width - sx;
+    // No branches so the compiler vectorizes it.
+    for (int x = margin; x < width - margin; x++) {
+      int d = c[x] - p[x];
+      sum += d < 0 ? -d : d;
+    }
+  }
+  return sum;
+}
+
+/**
+ * Finds the shift within range of (cx, cy) with the smallest difference.
+ * Fills sums with the differences of the 3x3 shifts around the best one when
+ * range is 1.
+ */
+static uint32_t best_shift(const uint16_t *current, const uint16_t *previous, int width,
+                           int height, int cx, int cy, int range, int margin, int *bx, int *by,
+                           uint32_t sums[3][3]) {
+  uint32_t best = UINT32_MAX;
+  for (int sy = cy - range; sy <= cy + range; sy++) {
+    for (int sx = cx - range; sx <= cx + range; sx++) {
+      uint32_t s = sad(current, previous, width, height, sx, sy, margin);
+      if (sums) {
+        sums[sy - cy + 1][sx - cx + 1] = s;
+      }
+      if (s < best) {
+        best = s;
+        *bx = sx;
+        *by = sy;
+      }
+    }
+  }
+  return best;
+}
+
+/**
+ * Fraction of a pixel the minimum lies from the middle of three sums of
+ * absolute differences, which form a V around it.
+ */
+static float subpixel(uint32_t before, uint32_t middle, uint32_t after) {
+  float rise = (float) (before > after ? before : after) - middle;
+  return rise > 0 ? ((float) before - after) / (2 * rise) : 0;
+}
+
+MotionEstimator::MotionEstimator() : search(3) {
+  reset();
+}
+
+void MotionEstimator::reset() {
+  dx = dy = 0;
+  residual = 0;
+  current = 0;
+  has_previous = false;
+}
+
+void MotionEstimator::estimate(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) {
+  const int w = PT1_WIDTH, h = PT1_HEIGHT;
+  int c = current, p = current ^ 1;
+  memcpy(level0[c], frame, sizeof(level0[c]));
+  downsample(level0[c], level1[c], w, h);
+  downsample(level1[c], level2[c], w / 2, h / 2);
+  current ^= 1;
+  if (!has_previous) {
+    has_previous = true;
+    dx = dy = 0;
+    return;
+  }
+
+  int bx = 0, by = 0;
+  best_shift(level2[c], level2[p], w / 4, h / 4, 0, 0, search, search, &bx, &by, NULL);
+  best_shift(level1[c], level1[p], w / 2, h / 2, 2 * bx, 2 * by, 1, 2 * search + 1, &bx, &by,
+             NULL);
+  uint32_t sums[3][3];
+  int cx = 2 * bx, cy = 2 * by;
+  // One more than the largest shift so the neighbors of the best are inside.
+  int margin = 4 * search + 4;
+  uint32_t best = best_shift(level0[c], level0[p], w, h, cx, cy, 1, margin, &bx, &by, sums);
+  // Interpolate with the neighbors of the best shift, which are outside the
+  // 3x3 searched when the best is on its edge.
+  static const int nx[4] = {-1, 1, 0, 0}, ny[4] = {0, 0, -1, 1};
+  uint32_t around[4];
+  for (int i = 0; i < 4; i++) {
+    int sx = bx + nx[i], sy = by + ny[i];
+    bool searched = abs(sx - cx) <= 1 && abs(sy - cy) <= 1;
+    around[i] = searched ? sums[sy - cy + 1][sx - cx + 1]
+                         : sad(level0[c], level0[p], w, h, sx, sy, margin);
+  }
+  dx = bx + subpixel(around[0], best, around[1]);
+  dy = by + subpixel(around[2], best, around[3]);
+  residual = (float) best / ((w - 2 * margin) * (h - 2 * margin));
+}
+
+Stabilizer::Stabilizer() : smoothing(0.9f), max_shift(10) {
+  reset();
+}
+
+void Stabilizer::reset() {
+  path_x = path_y = 0;
+  view_x = view_y = 0;
+  shift_x = shift_y = 0;
+}
+
+void Stabilizer::update(float dx, float dy) {
+  path_x += dx;
+  path_y += dy;
+  view_x += (1 - smoothing) * (path_x - view_x);
+  view_y += (1 - smoothing) * (path_y - view_y);
+  // Moving the content back from the camera path to the smoothed view.
+  shift_x = view_x - path_x;
+  shift_y = view_y - path_y;
+  if (fabsf(shift_x) > max_shift) {
+    shift_x = shift_x > 0 ? max_shift : -max_shift;
+    view_x = path_x + shift_x;
+  }
+  if (fabsf(shift_y) > max_shift) {
+    shift_y = shift_y > 0 ? max_shift : -max_shift;
+    view_y = path_y + shift_y;
+  }
+}
+
+void Stabilizer::apply(const uint16_t in[PT1_HEIGHT][PT1_WIDTH],
+                       uint16_t out[PT1_HEIGHT][PT1_WIDTH]) {
+  shiftImage(&in[0][0], &out[0][0], PT1_WIDTH, PT1_HEIGHT, shift_x, shift_y);
+}
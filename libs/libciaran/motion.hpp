@@ -0,0 +1,83 @@
+#ifndef MOTION_HPP
+#define MOTION_HPP
+
+#include <stdint.h>
+#include "pt1.h"
+#include "task.h"
+
+/**
+ * Shifts a width by height image so out(x, y) = in(x - dx, y - dy), with
+ * bilinear interpolation. Pixels shifted in from outside are copies of the
+ * nearest edge pixel. Runs in tiles on pool if not NULL.
+ */
+template <typename T>
+void shiftImage(const T *in, T *out, int width, int height, float dx, float dy,
+                task_pool *pool = NULL);
+
+/**
+ * Estimates how far the whole scene moved between consecutive frames, e.g.
+ * when the drone yaws or pitches. The camera's field of view is narrow so
+ * rotations show up as translations.
+ *
+ * Frames are reduced to a pyramid of 80x60, 40x30 and 20x15 pixels. The
+ * shift with the smallest sum of absolute differences is searched on the
+ * smallest level, refined by one pixel on each larger level and interpolated
+ * to a fraction of a pixel on the full frame.
+ */
+class MotionEstimator {
+public:
+  static const int LEVELS = 3;
+  // Largest shift searched on the smallest level. The largest shift found on
+  // the full frame is 4 * search + 3 pixels.
+  int search;
+  // Motion of the scene from the previous frame to the last one, in pixels.
+  float dx, dy;
+  // Mean absolute difference per pixel at the best shift.
+  float residual;
+  MotionEstimator();
+  /**
+   * Estimates the motion from the previous frame to frame. The first frame
+   * after a reset has no motion.
+   */
+  void estimate(const uint16_t frame[PT1_HEIGHT][PT1_WIDTH]);
+  /**
+   * Forgets the previous frame, e.g. after an FFC.
+   */
+  void reset();
+private:
+  uint16_t level0[2][PT1_HEIGHT * PT1_WIDTH];
+  uint16_t level1[2][PT1_HEIGHT / 2 * PT1_WIDTH / 2];
+  uint16_t level2[2][PT1_HEIGHT / 4 * PT1_WIDTH / 4];
+  int current;
+  bool has_previous;
+};
+
+/**
+ * Removes the shake from a video while following deliberate camera motion.
+ * The camera path is the sum of the estimated motions and the view follows a
+ * smoothed copy of it, so frames are shifted by the difference.
+ */
+class Stabilizer {
+public:
+  // 0 follows the camera immediately, closer to 1 is steadier.
+  float smoothing;
+  // Largest shift applied to a frame in pixels.
+  float max_shift;
+  // Shift applied to the last frame, add it to positions in the frame.
+  float shift_x, shift_y;
+  Stabilizer();
+  /**
+   * Adds the motion of the scene since the last frame.
+   */
+  void update(float dx, float dy);
+  /**
+   * Shifts a frame by shift_x and shift_y.
+   */
+  void apply(const uint16_t in[PT1_HEIGHT][PT1_WIDTH], uint16_t out[PT1_HEIGHT][PT1_WIDTH]);
+  void reset();
+private:
+  float path_x, path_y;
+  float view_x, view_y;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "scene.hpp"
+#include <algorithm>
+#include <math.h>
+
+SyntheticScene::SyntheticScene(int targets, unsigned seed)
+  : count(0), sky(7000), noise(30), turn(0.05f), terrain(0), camera_x(0), camera_y(0),
+    next_id(1),
+    state(seed * 2654435761u + 1) {
+  for (int i = 0; i < targets && i < MAX_TARGETS; i++) {
+    SyntheticTarget &t = this->targets[count++];
+    spawn(t);
+    // Start spread over the frame instead of all on the edges.
+    t.x = random() * PT1_WIDTH;
+    t.y = random() * PT1_HEIGHT;
+  }
+}
+
+void SyntheticScene::spawn(SyntheticTarget &t) {
+  t.id = next_id++;
+  // On a random edge heading into the frame.
+  float angle = random() * 2 * (float) M_PI;
+  float speed = 0.3f + random() * 1.2f;
+  t.vx = speed * cosf(angle);
+  t.vy = speed * sinf(angle);
+  if (random() < 0.5f) {
+    t.x = t.vx > 0 ? 0 : PT1_WIDTH - 1;
+    t.y = random() * PT1_HEIGHT;
+  } else {
+    t.x = random() * PT1_WIDTH;
+    t.y = t.vy > 0 ? 0 : PT1_HEIGHT - 1;
+  }
+  t.radius = 0.5f + random();
+  t.heat = 300 + random() * 500;
+}
+
+float SyntheticScene::random() {
+  // xorshift32, independent of rand() so it doesn't disturb the caller.
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (state >> 8) * (1.0f / (1 << 24));
+}
+
+void SyntheticScene::step() {
+  for (int i = 0; i < count; i++) {
+    SyntheticTarget &t = targets[i];
+    t.vx += (random() + random() + random() - 1.5f) * 2 * turn;
+    t.vy += (random() + random() + random() - 1.5f) * 2 * turn;
+    // Bats don't cross the frame in less than 40 frames.
+    float speed = hypotf(t.vx, t.vy);
+    if (speed > 2) {
+      t.vx *= 2 / speed;
+      t.vy *= 2 / speed;
+    }
+    t.x += t.vx;
+    t.y += t.vy;
+    float margin = t.radius + 1;
+    if (t.x < -margin || t.x > PT1_WIDTH - 1 + margin || t.y < -margin ||
+        t.y > PT1_HEIGHT - 1 + margin) {
+      spawn(t);
+    }
+  }
+}
+
+void SyntheticScene::pan(float dx, float dy) {
+  camera_x += dx;
+  camera_y += dy;
+  for (int i = 0; i < count; i++) {
+    targets[i].x -= dx;
+    targets[i].y -= dy;
+  }
+}
+
+/**
+ * Texture from 0 to 1 at a point of the terrain. Sinusoids of unrelated
+ * wavelengths and directions so it never repeats within a frame, weaker the
+ * finer they are like real terrain.
+ */
+static float texture(float u, float v) {
+  float t = 0.4f * sinf(0.61f * u - 0.41f * v + 1) + 0.6f * sinf(0.37f * u + 0.53f * v + 2) +
+            sinf(0.17f * u + 0.29f * v) + sinf(0.13f * v - 0.09f * u + 3);
+  return (t + 3) / 6;
+}
+
+void SyntheticScene::render(uint16_t frame[PT1_HEIGHT][PT1_WIDTH]) {
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      int ground = terrain ? (int) (terrain * texture(x + camera_x, y + camera_y)) : 0;
+      frame[y][x] = sky + 2 * y + ground + (int) (random() * noise);
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    const SyntheticTarget &t = targets[i];
+    int r = (int) ceilf(t.radius + 1);
+    for (int y = (int) t.y - r; y <= (int) t.y + r; y++) {
+      for (int x = (int) t.x - r; x <= (int) t.x + r; x++) {
+        if (x < 0 || x >= PT1_WIDTH || y < 0 || y >= PT1_HEIGHT) {
+          continue;
+        }
+        // Linear falloff to 0 at radius + 1 from the center.
+        float d = hypotf(x - t.x, y - t.y);
+        float heat = t.heat * (1 - d / (t.radius + 1));
+        if (heat > 0) {
+          frame[y][x] = std::min(frame[y][x] + (int) heat, PT1_PMAX);
+        }
+      }
+    }
+  }
+}
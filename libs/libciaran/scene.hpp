@@ -0,0 +1,65 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <stdint.h>
+#include "pt1.h"
+
+/**
+ * A simulated warm target with a known position.
+ */
+class SyntheticTarget {
+public:
+  int id;
+  // Center in pixels and velocity in pixels per frame.
+  float x, y, vx, vy;
+  float radius;
+  // Counts above the background at the center.
+  uint16_t heat;
+};
+
+/**
+ * Renders LWIR frames of targets flying over a cool sky with sensor noise,
+ * for benchmarking and validating detection and tracking against the truth.
+ * Targets turn randomly. A target that leaves the frame is replaced by a new
+ * one, with a new ID, entering from an edge. Everything is driven by the seed
+ * so runs are repeatable.
+ *
+ * With terrain set the background is a textured landscape instead of a plain
+ * sky, and pan moves the camera over it to test motion estimation.
+ */
+class SyntheticScene {
+public:
+  static const int MAX_TARGETS = 128;
+  SyntheticTarget targets[MAX_TARGETS];
+  int count;
+  uint16_t sky;
+  // Peak to peak noise in counts.
+  int noise;
+  // Standard deviation of the change of velocity per frame.
+  float turn;
+  // Peak to peak contrast of the terrain texture in counts, 0 for sky only.
+  uint16_t terrain;
+  // Position of the top left pixel over the terrain.
+  float camera_x, camera_y;
+  SyntheticScene(int targets, unsigned seed);
+  /**
+   * Moves every target one frame.
+   */
+  void step();
+  /**
+   * Moves the camera by dx and dy pixels, so the terrain and the targets move
+   * the opposite way in the frame.
+   */
+  void pan(float dx, float dy);
+  void render(uint16_t frame[PT1_HEIGHT][PT1_WIDTH]);
+  /**
+   * Uniform random number from 0 to 1.
+   */
+  float random();
+private:
+  int next_id;
+  uint32_t state;
+  void spawn(SyntheticTarget &t);
+};
+
+#endif
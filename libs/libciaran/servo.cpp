@@ -0,0 +1,94 @@
+#include "servo.hpp"
+#include <stddef.h>
+
+static float clamp(float v, float limit) {
+  return v < -limit ? -limit : v > limit ? limit : v;
+}
+
+PID::PID(float kp, float ki, float kd) : kp(kp), ki(ki), kd(kd), integral_limit(0.25f) {
+  reset();
+}
+
+void PID::reset() {
+  integral = 0;
+  previous_error = 0;
+  has_previous = false;
+}
+
+float PID::update(float error, float dt) {
+  float derivative = has_previous && dt > 0 ? (error - previous_error) / dt : 0;
+  previous_error = error;
+  has_previous = true;
+  if (ki > 0) {
+    integral = clamp(integral + error * dt, integral_limit / ki);
+  }
+  return kp * error + ki * integral + kd * derivative;
+}
+
+VisualServo::VisualServo()
+  : yaw(1.5f, 0.3f, 0.1f), thrust(1, 0.2f, 0.05f), pitch(0.5f, 0, 0), hover_thrust(0),
+    limit(0.5f), target_area(0) {
+  reset();
+}
+
+void VisualServo::reset() {
+  yaw.reset();
+  thrust.reset();
+  pitch.reset();
+  target_id = 0;
+  error_x = error_y = 0;
+}
+
+const Track *VisualServo::select(const Tracker &tracker) {
+  const Track *closest = NULL;
+  float distance = 0;
+  for (int i = 0; i < tracker.count; i++) {
+    const Track &t = tracker.tracks[i];
+    if (!t.confirmed) {
+      continue;
+    }
+    if (t.id == target_id) {
+      return &t;
+    }
+    float dx = t.x - (PT1_WIDTH - 1) / 2.0f, dy = t.y - (PT1_HEIGHT - 1) / 2.0f;
+    float d = dx * dx + dy * dy;
+    if (!closest || d < distance) {
+      closest = &t;
+      distance = d;
+    }
+  }
+  return closest;
+}
+
+void VisualServo::hover(ServoCommand &command) {
+  command.pitch = command.roll = command.yaw = 0;
+  command.thrust = hover_thrust;
+}
+
+bool VisualServo::update(const Tracker &tracker, float dt, ServoCommand &command) {
+  const Track *t = select(tracker);
+  if (!t) {
+    reset();
+    hover(command);
+    return false;
+  }
+  if (t->id != target_id) {
+    // A new target, don't carry the integral or derivative over.
+    yaw.reset();
+    thrust.reset();
+    pitch.reset();
+    target_id = t->id;
+  }
+  error_x = (t->x - (PT1_WIDTH - 1) / 2.0f) / (PT1_WIDTH / 2);
+  error_y = (t->y - (PT1_HEIGHT - 1) / 2.0f) / (PT1_HEIGHT / 2);
+  hover(command);
+  command.yaw = clamp(yaw.update(error_x, dt), limit);
+  // Up in the frame is lower y, so climb for negative errors.
+  command.thrust = hover_thrust + clamp(thrust.update(-error_y, dt), limit);
+  command.thrust = clamp(command.thrust, 1);
+  if (target_area > 0) {
+    float range = clamp((target_area - t->area) / target_area, 1);
+    command.pitch = clamp(pitch.update(range, dt), limit);
+  }
+  return true;
+}
@@ -0,0 +1,73 @@
+#ifndef SERVO_HPP
+#define SERVO_HPP
+
+#include <stdint.h>
+#include "tracker.hpp"
+
+/**
+ * PID controller with a clamped integral, derivative on the error.
+ */
+class PID {
+public:
+  float kp, ki, kd;
+  // Largest contribution of the integral term to the output.
+  float integral_limit;
+  PID(float kp, float ki, float kd);
+  /**
+   * Output for error after dt seconds since the last update.
+   */
+  float update(float error, float dt);
+  void reset();
+private:
+  float integral;
+  float previous_error;
+  bool has_previous;
+};
+
+/**
+ * Stick positions like a ControlPacketElement, -1 to 1.
+ */
+class ServoCommand {
+public:
+  float pitch, roll, yaw, thrust;
+};
+
+/**
+ * Keeps a tracked target in the middle of the frame and at a set size by
+ * steering the drone: yaw turns toward the target horizontally, thrust climbs
+ * or sinks toward it vertically and pitch closes or opens the range until the
+ * target has target_area pixels. Errors are fractions of half the frame so
+ * the gains don't depend on the resolution.
+ *
+ * The target is locked by track ID and kept until the track is lost, then the
+ * confirmed track closest to the middle is locked.
+ */
+class VisualServo {
+public:
+  PID yaw, thrust, pitch;
+  // Thrust that holds altitude.
+  float hover_thrust;
+  // Largest stick deflection from neutral (and from hover_thrust) commanded.
+  float limit;
+  // Size of the target in pixels to keep. 0 doesn't control the range.
+  float target_area;
+  // Track followed, 0 for none.
+  uint16_t target_id;
+  // Position of the target in the last update, fractions of half the frame.
+  float error_x, error_y;
+  VisualServo();
+  /**
+   * Steers toward the target among the tracks, dt seconds after the last
+   * update. Returns false and commands a hover when nothing is tracked.
+   */
+  bool update(const Tracker &tracker, float dt, ServoCommand &command);
+  /**
+   * Drops the target and the controller state, e.g. when the pilot takes over.
+   */
+  void reset();
+private:
+  const Track *select(const Tracker &tracker);
+  void hover(ServoCommand &command);
+};
+
+#endif
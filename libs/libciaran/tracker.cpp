@@ -0,0 +1,213 @@
+#include "tracker.hpp"
+#include <float.h>
+
+Tracker::Tracker()
+  : process_noise(0.15f), measurement_noise(0.5f), initial_velocity(2), gate(9.21f),
+    confirm_hits(3), max_misses(5) {
+  reset();
+}
+
+void Tracker::reset() {
+  count = 0;
+  next_id = 1;
+}
+
+int Tracker::confirmed() const {
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    n += tracks[i].confirmed;
+  }
+  return n;
+}
+
+void Tracker::shift(float dx, float dy) {
+  for (int i = 0; i < count; i++) {
+    tracks[i].x += dx;
+    tracks[i].y += dy;
+  }
+}
+
+/**
+ * Constant velocity prediction of one axis one frame ahead with piecewise
+ * constant acceleration noise q.
+ */
+static void predictAxis(float &position, float velocity, float p[3], float q) {
+  position += velocity;
+  p[0] += 2 * p[1] + p[2] + q / 4;
+  p[1] += p[2] + q / 2;
+  p[2] += q;
+}
+
+static void correctAxis(float &position, float &velocity, float p[3], float z, float r) {
+  float s = p[0] + r;
+  float k0 = p[0] / s;
+  float k1 = p[1] / s;
+  float innovation = z - position;
+  position += k0 * innovation;
+  velocity += k1 * innovation;
+  p[2] -= k1 * p[1];
+  p[0] *= 1 - k0;
+  p[1] *= 1 - k0;
+}
+
+void Tracker::predict(Track &t) {
+  float q = process_noise * process_noise;
+  predictAxis(t.x, t.vx, t.px, q);
+  predictAxis(t.y, t.vy, t.py, q);
+}
+
+void Tracker::correct(Track &t, const Detection &d) {
+  float r = measurement_noise * measurement_noise;
+  correctAxis(t.x, t.vx, t.px, d.x, r);
+  correctAxis(t.y, t.vy, t.py, d.y, r);
+  t.area = d.area;
+  t.peak = d.peak;
+  t.hits++;
+  t.misses = 0;
+  t.confirmed = t.confirmed || t.hits >= confirm_hits;
+}
+
+void Tracker::start(const Detection &d) {
+  if (count >= MAX_TRACKS) {
+    return;
+  }
+  Track &t = tracks[count++];
+  t.id = next_id++;
+  if (!next_id) {
+    next_id = 1;
+  }
+  t.x = d.x;
+  t.y = d.y;
+  t.vx = t.vy = 0;
+  t.px[0] = t.py[0] = measurement_noise * measurement_noise;
+  t.px[1] = t.py[1] = 0;
+  t.px[2] = t.py[2] = initial_velocity * initial_velocity;
+  t.area = d.area;
+  t.peak = d.peak;
+  t.hits = 1;
+  t.misses = 0;
+  t.confirmed = confirm_hits <= 1;
+}
+
+/**
+ * Hungarian algorithm (shortest augmenting paths with potentials) over the
+ * first rows and columns of cost, 1 based. Fills assignment with the column
+ * of every row. Padding rows or columns cost gate so leaving a track or a
+ * detection unassigned is always possible.
+ */
+void Tracker::assign(int rows, int columns) {
+  int n = rows > columns ? rows : columns;
+  for (int i = 1; i <= n; i++) {
+    for (int j = 1; j <= n; j++) {
+      if (i > rows || j > columns) {
+        cost[i][j] = gate;
+      }
+    }
+  }
+  for (int j = 0; j <= n; j++) {
+    u[j] = v[j] = 0;
+    match[j] = 0;
+  }
+  for (int i = 1; i <= n; i++) {
+    match[0] = i;
+    int j0 = 0;
+    for (int j = 0; j <= n; j++) {
+      min_v[j] = FLT_MAX;
+      used[j] = false;
+    }
+    do {
+      used[j0] = true;
+      int i0 = match[j0], j1 = 0;
+      float delta = FLT_MAX;
+      for (int j = 1; j <= n; j++) {
+        if (!used[j]) {
+          float reduced = cost[i0][j] - u[i0] - v[j];
+          if (reduced < min_v[j]) {
+            min_v[j] = reduced;
+            way[j] = j0;
+          }
+          if (min_v[j] < delta) {
+            delta = min_v[j];
+            j1 = j;
+          }
+        }
+      }
+      for (int j = 0; j <= n; j++) {
+        if (used[j]) {
+          u[match[j]] += delta;
+          v[j] -= delta;
+        } else {
+          min_v[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (match[j0]);
+    do {
+      int j1 = way[j0];
+      match[j0] = match[j1];
+      j0 = j1;
+    } while (j0);
+  }
+  for (int i = 0; i < rows; i++) {
+    assignment[i] = -1;
+  }
+  for (int j = 1; j <= columns; j++) {
+    int i = match[j];
+    // Pairs outside the gate only fill the matrix, they aren't real matches.
+    if (i && i <= rows && cost[i][j] < gate) {
+      assignment[i - 1] = j - 1;
+    }
+  }
+}
+
+void Tracker::update(const Detection *detections, int detection_count) {
+  if (detection_count > Detector::MAX_DETECTIONS) {
+    detection_count = Detector::MAX_DETECTIONS;
+  }
+  float r = measurement_noise * measurement_noise;
+  for (int i = 0; i < count; i++) {
+    Track &t = tracks[i];
+    predict(t);
+    // Innovation variances of the predicted position.
+    float sx = t.px[0] + r, sy = t.py[0] + r;
+    for (int j = 0; j < detection_count; j++) {
+      float dx = detections[j].x - t.x, dy = detections[j].y - t.y;
+      float distance = dx * dx / sx + dy * dy / sy;
+      // Outside the gate, never kept as a match.
+      cost[i + 1][j + 1] = distance < gate ? distance : gate + 1;
+    }
+  }
+  for (int j = 0; j < detection_count; j++) {
+    detection_used[j] = false;
+  }
+  if (count && detection_count) {
+    assign(count, detection_count);
+  } else {
+    for (int i = 0; i < count; i++) {
+      assignment[i] = -1;
+    }
+  }
+
+  // Correct assigned tracks and delete lost ones, keeping the array packed.
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    Track &t = tracks[i];
+    if (assignment[i] >= 0) {
+      correct(t, detections[assignment[i]]);
+      detection_used[assignment[i]] = true;
+    } else {
+      t.misses++;
+    }
+    if (t.misses >= (t.confirmed ? max_misses : 2)) {
+      continue;
+    }
+    tracks[kept++] = t;
+  }
+  count = kept;
+
+  for (int j = 0; j < detection_count; j++) {
+    if (!detection_used[j]) {
+      start(detections[j]);
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef TRACKER_HPP
+#define TRACKER_HPP
+
+#include <stdint.h>
+#include "detection.hpp"
+
+/**
+ * A target followed over several frames.
+ */
+class Track {
+public:
+  // Never reused while the tracker runs. 0 is never an ID.
+  uint16_t id;
+  // Estimated position in pixels and velocity in pixels per frame.
+  float x, y, vx, vy;
+  // Covariance of position and velocity of each axis, [position,
+  // position-velocity, velocity].
+  float px[3], py[3];
+  // Of the last detection assigned to the track.
+  uint16_t area, peak;
+  // Frames with a detection and consecutive frames without one.
+  int hits, misses;
+  bool confirmed;
+};
+
+/**
+ * Follows the detections of a Detector from frame to frame and gives every
+ * target a persistent ID.
+ *
+ * Each track has a constant velocity Kalman filter per axis. Detections are
+ * gated on their Mahalanobis distance to the predicted positions and assigned
+ * to tracks with the Hungarian algorithm, minimizing the total distance.
+ * Unassigned detections start tentative tracks that are confirmed after
+ * confirm_hits detections. Tracks are deleted after max_misses frames without
+ * a detection, tentative tracks after 2.
+ *
+ * Storage is fixed so update never allocates and takes at most
+ * O(MAX_TRACKS^3) time.
+ */
+class Tracker {
+public:
+  static const int MAX_TRACKS = 64;
+  // Standard deviation of the acceleration in pixels per frame squared.
+  float process_noise;
+  // Standard deviation of detection centroids in pixels.
+  float measurement_noise;
+  // Standard deviation of the velocity of new tracks in pixels per frame.
+  float initial_velocity;
+  // Largest squared Mahalanobis distance of a detection to a track.
+  // 9.21 keeps 99% of the detections of a track.
+  float gate;
+  int confirm_hits;
+  int max_misses;
+
+  Track tracks[MAX_TRACKS];
+  int count;
+
+  Tracker();
+  /**
+   * Predicts every track one frame ahead and corrects them with detections.
+   */
+  void update(const Detection *detections, int detection_count);
+  /**
+   * Number of confirmed tracks.
+   */
+  int confirmed() const;
+  /**
+   * Moves every track by dx and dy pixels when the whole scene moved.
+   */
+  void shift(float dx, float dy);
+  /**
+   * Deletes every track.
+   */
+  void reset();
+private:
+  uint16_t next_id;
+  float cost[MAX_TRACKS + 1][MAX_TRACKS + 1];
+  // Hungarian algorithm state, 1 based.
+  float u[MAX_TRACKS + 1], v[MAX_TRACKS + 1], min_v[MAX_TRACKS + 1];
+  int match[MAX_TRACKS + 1], way[MAX_TRACKS + 1];
+  bool used[MAX_TRACKS + 1];
+  int assignment[MAX_TRACKS];
+  bool detection_used[Detector::MAX_DETECTIONS];
+  void predict(Track &t);
+  void correct(Track &t, const Detection &d);
+  void start(const Detection &d);
+  void assign(int rows, int columns);
+};
+
+#endif
@@ -22,10 +22,72 @@ void CmdTlm::telemetry(Commands &callback) {
     break;
   case 1:
     {
+      FrameInfo info;
       uint16_t frame[60][80];
-      *packetReader >> frame;
-      callback.lwirFrame(frame);
+      *packetReader >> info.sequence >> info.number >> info.captured >> frame;
+      callback.lwirFrame(info, frame);
     }
+    break;
+  case 2:
+    {
+      FrameInfo info;
+      uint8_t frame[60][80];
+      *packetReader >> info.sequence >> info.number >> info.captured >> frame;
+      callback.lwirFrame8(info, frame);
+    }
+    break;
+  case 3:
+    {
+      uint32_t sequence;
+      uint8_t count;
+      *packetReader >> sequence >> count;
+      vector<TrackerPoint> points;
+      points.reserve(count);
+      for (int i = 0; i < count; i++) {
+        uint16_t id, area, peak;
+        int16_t x, y;
+        uint8_t label, confidence;
+        *packetReader >> id >> x >> y >> area >> peak >> label >> confidence;
+        points.push_back(TrackerPoint(id, x / 64.0f, y / 64.0f, area, peak, label, confidence));
+      }
+      callback.trackerPoints(sequence, points);
+    }
+    break;
+  case 4:
+    {
+      uint32_t sequence, time;
+      uint8_t count;
+      *packetReader >> sequence >> time >> count;
+      if (count == 0) {
+        // Malformed, there is no command in it.
+        break;
+      }
+      count = count > MAX_CONTROL_HISTORY ? MAX_CONTROL_HISTORY : count;
+      ControlPacketElement history[MAX_CONTROL_HISTORY];
+      for (int i = 0; i < count; i++) {
+        int16_t sticks[4];
+        uint8_t flags;
+        uint16_t age;
+        *packetReader >> sticks >> flags >> age;
+        ControlPacketElement &c = history[i];
+        c.pitch = sticks[0] / 32767.0f;
+        c.roll = sticks[1] / 32767.0f;
+        c.yaw = sticks[2] / 32767.0f;
+        c.thrust = sticks[3] / 32767.0f;
+        c.flags = flags;
+        c.sequence = sequence - i;
+        c.time = time - age;
+      }
+      callback.controlHistory(history, count);
+    }
+    break;
+  case 5:
+    {
+      uint32_t sequence, time, received;
+      *packetReader >> sequence >> time >> received;
+      callback.controlAck(sequence, time, received);
+    }
+    break;
   }
 }
 
@@ -35,6 +97,63 @@ void CmdTlm::control(const ControlPacketElement &c) {
   packetWriter->write_packet();
 }
 
-void CmdTlm::lwirFrame(const uint16_t frame[60][80]) {
-  *packetWriter << 1 << frame;
+/**
+ * Quantizes a stick from -1 to 1 to 16 bits.
+ */
+static int16_t toStick(float v) {
+  v = v < -1 ? -1 : v > 1 ? 1 : v;
+  return (int16_t) (v * 32767 + (v < 0 ? -0.5f : 0.5f));
+}
+
+void CmdTlm::controlHistory(const ControlPacketElement *history, uint8_t count) {
+  uint8_t packet_id = 4;
+  count = count > MAX_CONTROL_HISTORY ? MAX_CONTROL_HISTORY : count;
+  *packetWriter << packet_id << history[0].sequence << history[0].time << count;
+  for (int i = 0; i < count; i++) {
+    const ControlPacketElement &c = history[i];
+    int16_t sticks[4] = {toStick(c.pitch), toStick(c.roll), toStick(c.yaw), toStick(c.thrust)};
+    uint32_t age = history[0].time - c.time;
+    *packetWriter << sticks << c.flags << (uint16_t) (age > 65535 ? 65535 : age);
+  }
+  packetWriter->write_packet();
+}
+
+void CmdTlm::controlAck(uint32_t sequence, uint32_t time, uint32_t received) {
+  uint8_t packet_id = 5;
+  *packetWriter << packet_id << sequence << time << received;
+  packetWriter->write_packet();
+}
+
+void CmdTlm::lwirFrame(const FrameInfo &info, const uint16_t frame[60][80]) {
+  uint8_t packet_id = 1;
+  *packetWriter << packet_id << info.sequence << info.number << info.captured;
+  packetWriter->write(frame, sizeof(uint16_t[60][80]));
+  packetWriter->write_packet();
+}
+
+void CmdTlm::lwirFrame8(const FrameInfo &info, const uint8_t frame[60][80]) {
+  uint8_t packet_id = 2;
+  *packetWriter << packet_id << info.sequence << info.number << info.captured;
+  packetWriter->write(frame, sizeof(uint8_t[60][80]));
+  packetWriter->write_packet();
+}
+
+/**
+ * Clamps v to the range of a 16 bit integer in 1/64 pixels.
+ */
+static int16_t toFixed(float v) {
+  v *= 64;
+  return v < -32768 ? -32768 : v > 32767 ? 32767 : (int16_t) (v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+void CmdTlm::trackerPoints(uint32_t sequence, const vector<TrackerPoint> &points) {
+  uint8_t packet_id = 3;
+  uint8_t count = points.size() > 255 ? 255 : points.size();
+  *packetWriter << packet_id << sequence << count;
+  for (int i = 0; i < count; i++) {
+    const TrackerPoint &p = points[i];
+    *packetWriter << (uint16_t) p.id << toFixed(p.x) << toFixed(p.y) << p.area << p.peak
+                  << p.label << p.confidence;
+  }
+  packetWriter->write_packet();
 }
@@ -9,19 +9,7 @@ using namespace std;
 class PacketReader;
 class PacketWriter;
 class ControlPacketElement;
-
-class Point {
-public:
-  float x, y;
-  Point(float x, float y) : x(x), y(y) {
-  }
-};
-
-class TrackerPoint : public Point {
-public:
-  int id;
-  TrackerPoint(int id, float x, float y) : Point(x, y), id(id) {}
-};
+class FrameInfo;
 
 /**
  * This class handles communication using PacketWriter and PacketReader classes.
@@ -34,7 +22,31 @@ public:
   CmdTlm(PacketReader *reader, PacketWriter *writer);
   virtual void telemetry(Commands &callback);
   virtual void control(const ControlPacketElement &e);
-  virtual void lwirFrame(const uint16_t frame[60][80]);
+  /**
+   * Sends the newest count control packets in one datagram, history[0] the
+   * newest and each the one before, so the receiver can recover a lost
+   * packet from a later datagram. The sticks are quantized to 16 bits and
+   * the send time is kept to the millisecond; 9 + 11 bytes a packet.
+   * history must have consecutive sequence numbers and at most
+   * MAX_CONTROL_HISTORY are sent.
+   */
+  virtual void controlHistory(const ControlPacketElement *history, uint8_t count);
+  /**
+   * Acknowledges a control or control_history packet, so the GSE can
+   * measure the round trip and the offset between the clocks. 13 bytes.
+   */
+  virtual void controlAck(uint32_t sequence, uint32_t time, uint32_t received);
+  virtual void lwirFrame(const FrameInfo &info, const uint16_t frame[60][80]);
+  /**
+   * Sends an LWIR frame reduced to 8 bits, e.g. by automatic gain control.
+   * Half the size of lwirFrame.
+   */
+  virtual void lwirFrame8(const FrameInfo &info, const uint8_t frame[60][80]);
+  /**
+   * Sends the targets found in LWIR frame sequence. About 10 bytes per target
+   * so it can be sent for every frame. At most 255 points are sent.
+   */
+  virtual void trackerPoints(uint32_t sequence, const vector<TrackerPoint> &points);
 };
 
 #endif
@@ -2,11 +2,33 @@
 #define COMMANDS_HPP
 
 #include "packet_elements.hpp"
+#include <vector>
+
+// Most control packets in a control_history packet.
+const int MAX_CONTROL_HISTORY = 8;
 
 class Commands {
 public:
-  virtual void control(const ControlPacketElement &e) {}
-  virtual void lwirFrame(const uint16_t frame[60][80]) {}
+  virtual void control(const ControlPacketElement &) {}
+  /**
+   * The control packets in a control_history packet, history[0] the newest.
+   * Calls control for each, oldest first, unless overridden; some were
+   * likely received before.
+   */
+  virtual void controlHistory(const ControlPacketElement *history, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      control(history[i]);
+    }
+  }
+  /**
+   * fsw received the control packets up to a sequence number, which were
+   * sent at a time on the GSE's clock, at a time on its own clock: sequence,
+   * time and received, both times in ms.
+   */
+  virtual void controlAck(uint32_t, uint32_t, uint32_t) {}
+  virtual void lwirFrame(const FrameInfo &, const uint16_t [60][80]) {}
+  virtual void lwirFrame8(const FrameInfo &, const uint8_t [60][80]) {}
+  virtual void trackerPoints(uint32_t, const std::vector<TrackerPoint> &) {}
 };
 
 #endif
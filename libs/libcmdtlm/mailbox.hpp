@@ -0,0 +1,58 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+#include <atomic>
+
+using namespace std;
+
+/**
+ * Hands the newest value from one thread to another without locks (a triple
+ * buffer). The writer never waits and the reader only ever sees the newest
+ * complete value; values posted in between are overwritten.
+ */
+template <typename T>
+class Mailbox {
+public:
+  // Values overwritten before they were taken.
+  atomic<unsigned long> overwritten;
+
+  Mailbox() : overwritten(0), middle(1), back(0), front(2) {
+  }
+
+  /**
+   * Writer only.
+   */
+  void post(const T &value) {
+    buffers[back] = value;
+    int previous = middle.exchange(back | FRESH, memory_order_acq_rel);
+    if (previous & FRESH) {
+      overwritten++;
+    }
+    back = previous & ~FRESH;
+  }
+
+  /**
+   * Reader only. Copies the newest value posted since the last take to value
+   * and returns true, or returns false if there is none.
+   */
+  bool take(T &value) {
+    if (!(middle.load(memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    front = middle.exchange(front, memory_order_acq_rel) & ~FRESH;
+    value = buffers[front];
+    return true;
+  }
+
+private:
+  static const int FRESH = 4;
+  T buffers[3];
+  // Index of the buffer between writer and reader, with FRESH set when it
+  // holds a value not taken yet.
+  atomic<int> middle;
+  // Only touched by the writer and by the reader.
+  int back;
+  int front;
+};
+
+#endif
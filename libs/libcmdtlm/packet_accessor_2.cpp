@@ -72,6 +72,23 @@ void UDPSocket::connect(const char *addr, int port) {
   connect(stringToAddr(addr, port));
 }
 
+void UDPSocket::setReceiveTimeout(int ms) {
+#ifdef _WIN32
+  DWORD timeout = ms;
+#else
+  timeval timeout;
+  timeout.tv_sec = ms / 1000;
+  timeout.tv_usec = ms % 1000 * 1000;
+#endif
+  if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout)) < 0) {
+#ifdef _WIN32
+    throw std::string("UDPSocket::setReceiveTimeout()") + std::to_string(WSAGetLastError());
+#else
+    throw std::string(strerror(errno));
+#endif
+  }
+}
+
 
 Reader & Reader::operator>>(PacketElement &e) {
   e.read(this);
@@ -244,6 +261,7 @@ UDPSplitPacketReader::UDPSplitPacketReader(Socket::sockfd_t socket, int max, int
   this->max = max;
   this->mtu = mtu;
   receivedPacket = false;
+  datagrams = bytes = lost = 0;
 }
 
 int UDPSplitPacketReader::recv(void *data, int length) {
@@ -278,6 +296,55 @@ void UDPSplitPacketReader::read(void *buffer, int length) {
   }
 }
 
+void UDPSplitPacketReader::countDatagram(int id, int count) {
+  // Larger jumps are a restarted sender, not losses.
+  const int MAX_GAP = 1024;
+  datagrams++;
+  std::map<int, int>::iterator last = lastCounts.find(id);
+  if (last == lastCounts.end()) {
+    lastCounts[id] = count;
+    return;
+  }
+  int gap = count - last->second & 0x3FFF;
+  if (gap == 0) {
+    // A duplicate.
+  } else if (gap <= MAX_GAP) {
+    lost += gap - 1;
+    last->second = count;
+  } else if (gap >= 0x4000 - MAX_GAP) {
+    // Late, counted as lost when the gap was seen.
+    lost -= lost > 0;
+  } else {
+    last->second = count;
+  }
+}
+
+void UDPSplitPacketReader::erasePacket(std::list<SplitPacket>::iterator packet) {
+  if (packet->hasNext) {
+    std::list<SplitPacket>::iterator it;
+    it = packet->next;
+    while (it->hasNext) {
+      std::list<SplitPacket>::iterator temp;
+      temp = it->next;
+      receivedPackets.erase(it);
+      it = temp;
+    }
+    receivedPackets.erase(it);
+  }
+  if (packet->hasPrevious) {
+    std::list<SplitPacket>::iterator it;
+    it = packet->previous;
+    while (it->hasPrevious) {
+      std::list<SplitPacket>::iterator temp;
+      temp = it->previous;
+      receivedPackets.erase(it);
+      it = temp;
+    }
+    receivedPackets.erase(it);
+  }
+  receivedPackets.erase(packet);
+}
+
 void UDPSplitPacketReader::read_packet() {
   while(1) {
     // erase old packets
@@ -289,29 +356,7 @@ void UDPSplitPacketReader::read_packet() {
       } else {
         current = --receivedPackets.end();
       }
-      if (current->hasNext) {
-        std::list<SplitPacket>::iterator it;
-        it = current->next;
-        while (it->hasNext) {
-          std::list<SplitPacket>::iterator temp;
-          temp = it->next;
-          receivedPackets.erase(it);
-          it = temp;
-        }
-        receivedPackets.erase(it);
-      }
-      if (current->hasPrevious) {
-        std::list<SplitPacket>::iterator it;
-        it = current->previous;
-        while (it->hasPrevious) {
-          std::list<SplitPacket>::iterator temp;
-          temp = it->previous;
-          receivedPackets.erase(it);
-          it = temp;
-        }
-        receivedPackets.erase(it);
-      }
-      receivedPackets.erase(current);
+      erasePacket(current);
     }
 
     // create packet
@@ -322,9 +367,18 @@ void UDPSplitPacketReader::read_packet() {
     // read until copy not read;
     while (1) {
       // read packet
-      int length = recv(current->buf_start, current->buf_end - current->buf_start);
+      int length;
+      try {
+        length = recv(current->buf_start, current->buf_end - current->buf_start);
+      } catch (std::string e) {
+        // Don't leave an empty packet behind, a timeout isn't the end.
+        receivedPackets.erase(current);
+        throw;
+      }
       current->read_end = current->buf_start + length;
       current->buf_current += 4;
+      countDatagram(current->getID(), current->getCount());
+      bytes += length;
 
       // find copies
       std::list<SplitPacket>::iterator copy;
@@ -335,24 +389,18 @@ void UDPSplitPacketReader::read_packet() {
       }
       // if copy found
       if (copy != receivedPackets.end()) {
-        // replace old with new;
-        if (copy->hasNext) {
-          current->hasNext = true;
-          current->next = copy->next;
-          current->next->previous = current;
-        }
-        if (copy->hasPrevious) {
-          current->hasPrevious = true;
-          current->previous = copy->previous;
-          current->previous->next = current;
+        // A duplicate, read the next one over it.
+        if (current->read_end - current->buf_start == copy->read_end - copy->buf_start &&
+            !memcmp(current->buf_start, copy->buf_start, current->read_end - current->buf_start)) {
+          current->buf_current = current->buf_start;
+          continue;
         }
-        current->hasStart = copy->hasStart;
-        current->start = copy->start;
-        current->hasEnd = copy->hasEnd;
-        receivedPackets.erase(copy);
-      } else {
-        break;
+        // Otherwise left over from an incomplete packet before the count
+        // wrapped, drop the old one whole, its other pieces may point at
+        // it as their start.
+        erasePacket(copy);
       }
+      break;
     }
 
     // if full packet
@@ -460,18 +508,30 @@ void UDPSplitPacketReader::read_packet() {
 
 
 
-UDPSplitAddrPacketReader::UDPSplitAddrPacketReader(Socket &socket, int max, int mtu) : UDPSplitPacketReader(socket.sockfd, max, mtu) {}
+UDPSplitAddrPacketReader::UDPSplitAddrPacketReader(Socket &socket, int max, int mtu) : UDPSplitAddrPacketReader(socket.sockfd, max, mtu) {}
 
-UDPSplitAddrPacketReader::UDPSplitAddrPacketReader(Socket::sockfd_t socket, int max, int mtu) : UDPSplitPacketReader(socket, max, mtu) {}
+UDPSplitAddrPacketReader::UDPSplitAddrPacketReader(Socket::sockfd_t socket, int max, int mtu) : UDPSplitPacketReader(socket, max, mtu) {
+  replied = false;
+}
 
 int UDPSplitAddrPacketReader::recv(void *data, int length) {
-  socklen_t addrlen = sizeof(reply_addr);
-  if ((length = ::recvfrom(socket, (char *) data, length, 0, (sockaddr *) &reply_addr, &addrlen)) < 0) {
+  struct sockaddr_storage address;
+  socklen_t addrlen = sizeof(address);
+  if ((length = ::recvfrom(socket, (char *) data, length, 0, (sockaddr *) &address, &addrlen)) < 0) {
     throw std::string(strerror(errno));
   }
+  std::lock_guard<std::mutex> lock(reply_mutex);
+  reply_addr = address;
+  replied = true;
   return length;
 }
 
+bool UDPSplitAddrPacketReader::replyAddress(struct sockaddr_storage &address) {
+  std::lock_guard<std::mutex> lock(reply_mutex);
+  address = reply_addr;
+  return replied;
+}
+
 UDPSplitAddrPacketWriter UDPSplitAddrPacketReader::getReplyPacketWriter(int id, int buf_size) {
   return UDPSplitAddrPacketWriter(mtu, id, reply_addr, socket, buf_size);
 }
@@ -505,18 +565,19 @@ void UDPSplitPacketWriter::write_packet() {
     uint16_t type_count = count | 0x4000;
     memcpy(buf_start + sizeof(id), &type_count, sizeof(type_count));
     send(buf_start, mtu);
-    count = count + 1 & 0x3FFFF;
+    count = count + 1 & 0x3FFF;
 
     // Send middle packets
+    // Each header goes over the end of the packet before, which was sent.
     buf_t *current;
-    for (current = buf_start + mtu; current + mtu - header_size < buf_end; current += mtu - header_size) {
+    for (current = buf_start + mtu - header_size; buf_current - current > mtu; current += mtu - header_size) {
       // Write multiplex header
       memcpy(current, &id, sizeof(id));
       // type and count are merged together
       uint16_t type_count = count | 0xC000;
       memcpy(current + sizeof(id), &type_count, sizeof(type_count));
-      send(buf_start, mtu);
-      count = count + 1 & 0x3FFFF;
+      send(current, mtu);
+      count = count + 1 & 0x3FFF;
     }
 
     // Send end packet;
@@ -524,8 +585,8 @@ void UDPSplitPacketWriter::write_packet() {
     // type and count are merged together
     type_count = count | 0x8000;
     memcpy(current + sizeof(id), &type_count, sizeof(type_count));
-    send(buf_start, mtu);
-    count = count + 1 & 0x3FFFF;
+    send(current, buf_current - current);
+    count = count + 1 & 0x3FFF;
   // Sweet, buffer doesn't need to be split!
   } else {
     // Send a full packet
@@ -534,7 +595,7 @@ void UDPSplitPacketWriter::write_packet() {
     uint16_t type_count = count;
     memcpy(buf_start + sizeof(id), &type_count, sizeof(type_count));
     send(buf_start, buf_current - buf_start);
-    count = count + 1 & 0x3FFFF;
+    count = count + 1 & 0x3FFF;
   }
   buf_current = buf_start + header_size;
 }
@@ -553,3 +614,16 @@ void UDPSplitAddrPacketWriter::send(void *data, int length) {
     throw std::string(strerror(errno));
   }
 }
+
+
+UDPSplitReplyPacketWriter::UDPSplitReplyPacketWriter(uint16_t id, UDPSplitAddrPacketReader &reader, int buf_size) : UDPSplitPacketWriter(id, reader.socket, reader.mtu, buf_size), reader(reader) {}
+
+void UDPSplitReplyPacketWriter::send(void *data, int length) {
+  struct sockaddr_storage address;
+  if (!reader.replyAddress(address)) {
+    return;
+  }
+  if (::sendto(socket, (char *) data, length, 0, (sockaddr *) &address, sizeof(address)) < 0) {
+    throw std::string(strerror(errno));
+  }
+}
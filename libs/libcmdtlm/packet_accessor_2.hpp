@@ -9,6 +9,8 @@
 #include <string>
 #include "packet_element.hpp"
 #include <list>
+#include <map>
+#include <mutex>
 
 #define DEFAULT_BUFFER_SIZE 1000000
 // #define DEFAULT_BUFFER_SIZE 2047
@@ -32,6 +34,11 @@ public:
   void bind(int port);
   void connect(sockaddr_storage addr);
   void connect(const char *addr, int port);
+  /**
+   * Makes receives throw after ms without a datagram instead of blocking
+   * forever, e.g. so a receive thread can be stopped. 0 blocks forever.
+   */
+  void setReceiveTimeout(int ms);
 };
 
 class Reader {
@@ -99,7 +106,7 @@ public:
 class UDPPacketReader : public BufferReader, public virtual PacketReader {
 protected:
   Socket::sockfd_t socket;
-  int recv(void *data, int length);
+  virtual int recv(void *data, int length);
 public:
   UDPPacketReader(Socket &socket, int buf_size = DEFAULT_BUFFER_SIZE);
   UDPPacketReader(Socket::Socket::sockfd_t socket, int buf_size = DEFAULT_BUFFER_SIZE);
@@ -121,7 +128,7 @@ public:
 class UDPPacketWriter : public BufferWriter, public virtual PacketWriter {
 protected:
   Socket::sockfd_t socket;
-  void send(void *data, int length);
+  virtual void send(void *data, int length);
 public:
   UDPPacketWriter(Socket &socket, int buf_size = DEFAULT_BUFFER_SIZE);
   UDPPacketWriter(Socket::sockfd_t socket, int buf_size = DEFAULT_BUFFER_SIZE);
@@ -143,7 +150,7 @@ protected:
   int mtu;
   uint16_t id;
   uint16_t count;
-  void send(void *data, int length);
+  virtual void send(void *data, int length);
 public:
   // MTU 2047
   UDPSplitPacketWriter(uint16_t id, Socket &socket, int mtu = 2047, int buf_size = DEFAULT_BUFFER_SIZE);
@@ -153,7 +160,7 @@ public:
 
 class UDPSplitPacketReader : public virtual PacketReader {
 protected:
-  int recv(void *data, int length);
+  virtual int recv(void *data, int length);
   class SplitPacket : public BufferReader {
   public:
     SplitPacket(int size);
@@ -176,10 +183,18 @@ protected:
   bool receivedPacket;
   std::list<SplitPacket>::iterator currentPacket;
   int maxReceivedPackets;
+  // Count of the newest datagram from each sender ID.
+  std::map<int, int> lastCounts;
+  void countDatagram(int id, int count);
+  // Erases packet and the packets linked to it either way.
+  void erasePacket(std::list<SplitPacket>::iterator packet);
 public:
   Socket::sockfd_t socket;
   int max;
   int mtu;
+  // Datagrams and bytes received, and datagrams lost on the way going by
+  // the gaps in each sender's count. Only for the reading thread.
+  unsigned long datagrams, bytes, lost;
   UDPSplitPacketReader(Socket &socket, int max = 1000, int mtu = 2047);
   UDPSplitPacketReader(Socket::sockfd_t socket, int max = 1000, int mtu = 2047);
   void read(void *buffer, int length);
@@ -191,11 +206,18 @@ class UDPSplitAddrPacketWriter;
 class UDPSplitAddrPacketReader : public UDPSplitPacketReader {
 protected:
   int recv(void *data, int length);
+  std::mutex reply_mutex;
+  bool replied;
 public:
   UDPSplitAddrPacketReader(Socket &socket, int max = 1000, int mtu = 2047);
   UDPSplitAddrPacketReader(Socket::sockfd_t socket, int max = 1000, int mtu = 2047);
   struct sockaddr_storage reply_addr;
   UDPSplitAddrPacketWriter getReplyPacketWriter(int id, int buf_size = DEFAULT_BUFFER_SIZE);
+  /**
+   * Copies the address the last datagram came from to address, from any
+   * thread. Returns false if none has been received yet.
+   */
+  bool replyAddress(struct sockaddr_storage &address);
 };
 
 class UDPSplitAddrPacketWriter : public UDPSplitPacketWriter {
@@ -208,4 +230,18 @@ public:
   UDPSplitAddrPacketWriter(int mtu, uint16_t id, struct sockaddr_storage &address, Socket::sockfd_t socket, int buf_size = DEFAULT_BUFFER_SIZE);
 };
 
+/**
+ * Sends to wherever reader last received a datagram from, e.g. a server's
+ * replies to a client whose address it doesn't know in advance and which
+ * may change. Packets written before anything was received are dropped.
+ * Writing from one thread while reader reads on another is safe.
+ */
+class UDPSplitReplyPacketWriter : public UDPSplitPacketWriter {
+protected:
+  UDPSplitAddrPacketReader &reader;
+  void send(void *data, int length);
+public:
+  UDPSplitReplyPacketWriter(uint16_t id, UDPSplitAddrPacketReader &reader, int buf_size = DEFAULT_BUFFER_SIZE);
+};
+
 #endif
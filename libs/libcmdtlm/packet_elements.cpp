@@ -24,9 +24,9 @@ void HeaderPacketElement::read(Reader *r) {
 
 /******************************************************************************/
 
-ControlPacketElement::ControlPacketElement() {}
+ControlPacketElement::ControlPacketElement() : pitch(0), roll(0), yaw(0), thrust(0), sequence(0), time(0), flags(0) {}
 
-ControlPacketElement::ControlPacketElement(float p, float r, float y, float t) {
+ControlPacketElement::ControlPacketElement(float p, float r, float y, float t) : sequence(0), time(0), flags(0) {
   pitch = p;
   roll = r;
   yaw = y;
@@ -38,6 +38,9 @@ void ControlPacketElement::write(Writer *w) const {
   w->write(&roll);
   w->write(&yaw);
   w->write(&thrust);
+  w->write(&sequence);
+  w->write(&time);
+  w->write(&flags);
 }
 
 void ControlPacketElement::read(Reader *r) {
@@ -45,6 +48,9 @@ void ControlPacketElement::read(Reader *r) {
   r->read(&roll);
   r->read(&yaw);
   r->read(&thrust);
+  r->read(&sequence);
+  r->read(&time);
+  r->read(&flags);
 }
 
 std::string ControlPacketElement::toString() {
@@ -54,6 +60,9 @@ std::string ControlPacketElement::toString() {
   s += std::string("  roll   : ") + std::to_string(roll) + std::string("\n");
   s += std::string("  yaw    : ") + std::to_string(yaw) + std::string("\n");
   s += std::string("  thrust : ") + std::to_string(thrust) + std::string("\n");
+  s += std::string("  seq    : ") + std::to_string(sequence) + std::string("\n");
+  s += std::string("  time   : ") + std::to_string(time) + std::string("\n");
+  s += std::string("  flags  : ") + std::to_string(flags) + std::string("\n");
   s += std::string("}\n");
   return s;
 }
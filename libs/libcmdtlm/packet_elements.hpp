@@ -6,6 +6,42 @@
 #include "packet_element.hpp"
 #include <string>
 
+class Point {
+public:
+  float x, y;
+  Point(float x, float y) : x(x), y(y) {
+  }
+};
+
+class TrackerPoint : public Point {
+public:
+  int id;
+  // Number of pixels and hottest pixel of the target.
+  uint16_t area, peak;
+  // Class of the target in the onboard classifier's model and confidence from
+  // 0 to 255, 0 when not classified.
+  uint8_t label, confidence;
+  TrackerPoint(int id, float x, float y, uint16_t area = 0, uint16_t peak = 0,
+               uint8_t label = 0, uint8_t confidence = 0)
+    : Point(x, y), id(id), area(area), peak(peak), label(label), confidence(confidence) {}
+};
+
+/**
+ * Where an LWIR frame came from, sent with it.
+ */
+class FrameInfo {
+public:
+  // Camera's sequence number, as in tracker_points.
+  uint32_t sequence;
+  // Counts up with every LWIR frame fsw sends, so gaps are frames lost on the
+  // way rather than skipped onboard.
+  uint32_t number;
+  // fsw's monotonic clock in milliseconds when the frame was captured.
+  uint32_t captured;
+  FrameInfo(uint32_t sequence = 0, uint32_t number = 0, uint32_t captured = 0)
+    : sequence(sequence), number(number), captured(captured) {}
+};
+
 class HeaderPacketElement : public virtual PacketElement {
 public:
   uint16_t sender_id, sequence;
@@ -18,7 +54,15 @@ public:
 
 class ControlPacketElement : public virtual PacketElement {
 public:
+  // The GSE is following the drone's onboard control, the sticks are unused
+  // and the packet only shows the link is up.
+  static const uint8_t HANDOVER = 1;
   float pitch, roll, yaw, thrust;
+  // Counts up from 1 with every packet the GSE sends, 0 if not sent by it.
+  uint32_t sequence;
+  // GSE's monotonic clock in milliseconds when the packet was sent.
+  uint32_t time;
+  uint8_t flags;
   ControlPacketElement();
   ControlPacketElement(float p, float r, float y, float t);
   virtual void write(Writer *) const;
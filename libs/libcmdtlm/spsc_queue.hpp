@@ -0,0 +1,142 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stddef.h>
+
+/**
+ * What a producer does when the queue to the next stage is full.
+ */
+enum DropPolicy {
+  // Discard the oldest item so the producer never waits.
+  DROP_OLDEST,
+  // Wait until the consumer makes room.
+  BLOCK
+};
+
+/**
+ * Bounded lock-free queue from one producer thread to one consumer thread,
+ * holding up to N items, N a power of 2. Items are copied in and out so
+ * neither side holds on to a slot while working.
+ *
+ * Every slot has a sequence number that says whether it is free for the push
+ * at its position or holds the item for the pop at its position (Vyukov's
+ * bounded queue). Pops claim their position with a compare and swap, which
+ * lets the producer discard the oldest item too.
+ *
+ * Waiting in push and pop polls every WAIT microseconds, a fraction of a
+ * frame, rather than sleeping on a lock the other side would have to take.
+ */
+template <typename T, size_t N>
+class SpscQueue {
+public:
+  static const int WAIT = 250;
+  // Items discarded by push to make room.
+  std::atomic<unsigned long> dropped;
+
+  SpscQueue() : dropped(0), head(0), tail(0) {
+    static_assert(N && !(N & (N - 1)), "SpscQueue size must be a power of 2");
+    for (size_t i = 0; i < N; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Copies item in. Returns false if the queue is full. Producer only.
+   */
+  bool tryPush(const T &item) {
+    size_t position = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[position & (N - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != position) {
+      return false;
+    }
+    slot.item = item;
+    slot.sequence.store(position + 1, std::memory_order_release);
+    head.store(position + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Copies the oldest item out. Returns false if the queue is empty.
+   */
+  bool tryPop(T &item) {
+    return take(&item);
+  }
+
+  /**
+   * Discards the oldest item. Returns false if the queue is empty.
+   */
+  bool discard() {
+    return take(NULL);
+  }
+
+  /**
+   * Copies item in, discarding the oldest item or waiting for room when the
+   * queue is full. Returns false if run was cleared while waiting.
+   */
+  bool push(const T &item, DropPolicy policy, const std::atomic<bool> &run) {
+    while (!tryPush(item)) {
+      if (policy == DROP_OLDEST) {
+        if (discard()) {
+          dropped++;
+        }
+      } else if (!run) {
+        return false;
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(WAIT));
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Waits for the oldest item and copies it out. Returns false if run was
+   * cleared first.
+   */
+  bool pop(T &item, const std::atomic<bool> &run) {
+    while (!tryPop(item)) {
+      if (!run) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(WAIT));
+    }
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+  Slot slots[N];
+  // Next position to push, written by the producer only, and next to pop, on
+  // their own cache lines.
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+
+  bool take(T *item) {
+    size_t position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots[position & (N - 1)];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != position + 1) {
+        if ((ptrdiff_t) (sequence - (position + 1)) < 0) {
+          return false;
+        }
+        // The other side took this position first.
+        position = tail.load(std::memory_order_relaxed);
+      } else if (tail.compare_exchange_weak(position, position + 1,
+                                             std::memory_order_relaxed)) {
+        if (item) {
+          *item = slot.item;
+        }
+        slot.sequence.store(position + N, std::memory_order_release);
+        return true;
+      }
+    }
+  }
+};
+
+#endif
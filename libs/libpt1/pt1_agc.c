@@ -0,0 +1,276 @@
+#include "pt1_agc.h"
+#include "pt1_color.h"
+
+#include <string.h>
+
+/* Pixels are mapped in blocks so the index buffer stays in L1 cache. */
+#define BLOCK_SIZE 256
+
+/* The narrowest range mapped to 8 bits. Stops the sensor noise of a uniform
+   scene from being stretched over the whole display. */
+#define MIN_RANGE 32
+
+void pt1_agc_init(struct pt1_agc *agc, enum pt1_agc_mode mode) {
+  agc->mode = mode;
+  agc->clip_low = 0.005;
+  agc->clip_high = 0.995;
+  agc->smoothing = 0.8;
+  agc->clahe_limit = 3;
+  agc->frames = 0;
+  agc->low = agc->high = 0;
+  agc->lut_low = agc->lut_high = 0;
+  memset(agc->points, 0, sizeof(agc->points));
+  memset(agc->lut, 0, sizeof(agc->lut));
+  memset(agc->tile_luts, 0, sizeof(agc->tile_luts));
+  agc->pool = NULL;
+}
+
+const char *pt1_agc_mode_name(enum pt1_agc_mode mode) {
+  switch (mode) {
+  case PT1_AGC_LINEAR: return "linear";
+  case PT1_AGC_EQUALIZE: return "equalize";
+  case PT1_AGC_CLAHE: return "clahe";
+  default: return "unknown";
+  }
+}
+
+void pt1_agc_histogram(struct pt1_agc *agc, const uint16_t *pixels, size_t count) {
+  uint16_t low, high;
+  pt1_find_range(pixels, count, &low, &high);
+  if (high > PT1_PMAX) {
+    high = PT1_PMAX;
+  }
+  if (low > high) {
+    low = high;
+  }
+  /* The range is found with a vectorized pass so only the bins in use are
+     cleared instead of all 16K. */
+  size_t span = high - low + 1;
+  uint32_t *histogram = agc->histogram;
+  memset(&histogram[low], 0, span * sizeof(*histogram));
+  for (size_t i = 0; i < count; i++) {
+    histogram[pixels[i] > PT1_PMAX ? PT1_PMAX : pixels[i]]++;
+  }
+  agc->low = low;
+  agc->high = high;
+}
+
+/**
+ * Returns the pixel value below which fraction of the count pixels in the
+ * histogram are. Bin v covers values from v to v + 1.
+ */
+static float percentile(const struct pt1_agc *agc, size_t count, float fraction) {
+  double target = fraction * count;
+  double cumulative = 0;
+  for (int v = agc->low; v <= agc->high; v++) {
+    uint32_t c = agc->histogram[v];
+    if (c && cumulative + c >= target) {
+      return v + (target - cumulative) / c;
+    }
+    cumulative += c;
+  }
+  return agc->high + 1;
+}
+
+/**
+ * Sets points so each of the 256 output levels gets the same number of pixels.
+ */
+static void equalize_points(const struct pt1_agc *agc, size_t count, float *points) {
+  double step = count / 256.0;
+  double cumulative = 0;
+  int k = 0;
+  for (int v = agc->low; v <= agc->high && k < PT1_AGC_POINTS; v++) {
+    uint32_t c = agc->histogram[v];
+    while (c && k < PT1_AGC_POINTS && k * step <= cumulative + c) {
+      points[k] = v + (k * step - cumulative) / c;
+      k++;
+    }
+    cumulative += c;
+  }
+  for (; k < PT1_AGC_POINTS; k++) {
+    points[k] = agc->high + 1;
+  }
+}
+
+/**
+ * Sets points to map the clip_low to clip_high percentiles linearly.
+ */
+static void linear_points(const struct pt1_agc *agc, size_t count, float *points) {
+  float low = percentile(agc, count, agc->clip_low);
+  float high = percentile(agc, count, agc->clip_high);
+  if (high - low < MIN_RANGE) {
+    float center = (low + high) / 2;
+    low = center - MIN_RANGE / 2;
+    high = center + MIN_RANGE / 2;
+  }
+  for (int k = 0; k < PT1_AGC_POINTS; k++) {
+    points[k] = low + (high - low) * k / (PT1_AGC_POINTS - 1);
+  }
+}
+
+/**
+ * Builds the lookup table from the smoothed points. Only the pixel values
+ * between the first and last point are written.
+ */
+static void build_lut(struct pt1_agc *agc) {
+  const float *points = agc->points;
+  float first = points[0] < 0 ? 0 : points[0];
+  float last = points[PT1_AGC_POINTS - 1] > PT1_PMAX ? PT1_PMAX : points[PT1_AGC_POINTS - 1];
+  int low = first;
+  int high = last < first ? low : last;
+  int k = 0;
+  for (int v = low; v <= high; v++) {
+    /* The value at the center of the bin decides the level. */
+    float center = v + 0.5f;
+    while (k < 255 && center >= points[k + 1]) {
+      k++;
+    }
+    agc->lut[v] = center < points[0] ? 0 : k;
+  }
+  agc->lut_low = low;
+  agc->lut_high = high;
+}
+
+static void apply_lut(const struct pt1_agc *agc, const uint16_t *pixels, size_t count,
+                      uint8_t *out) {
+  uint16_t index[BLOCK_SIZE];
+  uint16_t low = agc->lut_low;
+  uint16_t high = agc->lut_high;
+  for (size_t start = 0; start < count; start += BLOCK_SIZE) {
+    size_t n = count - start < BLOCK_SIZE ? count - start : BLOCK_SIZE;
+    /* No branches so the compiler vectorizes this loop. */
+    for (size_t i = 0; i < n; i++) {
+      uint16_t p = pixels[start + i];
+      p = p < low ? low : p;
+      p = p > high ? high : p;
+      index[i] = p;
+    }
+    for (size_t i = 0; i < n; i++) {
+      out[start + i] = agc->lut[index[i]];
+    }
+  }
+}
+
+/* A frame being processed, for the kernels run by the pool. */
+struct agc_job {
+  struct pt1_agc *agc;
+  const uint16_t *pixels;
+  uint8_t *out;
+  int width, height;
+};
+
+static void apply_lut_tile(void *context, int x0, int y0, int x1, int y1) {
+  const struct agc_job *job = context;
+  size_t start = (size_t) y0 * job->width;
+  (void) x0;
+  (void) x1;
+  apply_lut(job->agc, job->pixels + start, (size_t) (y1 - y0) * job->width, job->out + start);
+}
+
+/**
+ * Equalization curve of CLAHE tile index, clipped at clahe_limit times the
+ * average bin.
+ */
+static void clahe_tile_lut(void *context, int index) {
+  const struct agc_job *job = context;
+  struct pt1_agc *agc = job->agc;
+  const uint8_t *image = job->out;
+  int width = job->width, height = job->height;
+  int tx = index % PT1_AGC_TILES_X, ty = index / PT1_AGC_TILES_X;
+  float follow = agc->frames ? 1 - agc->smoothing : 1;
+  int x0 = tx * width / PT1_AGC_TILES_X;
+  int x1 = (tx + 1) * width / PT1_AGC_TILES_X;
+  int y0 = ty * height / PT1_AGC_TILES_Y;
+  int y1 = (ty + 1) * height / PT1_AGC_TILES_Y;
+  int n = (x1 - x0) * (y1 - y0);
+  uint32_t histogram[256] = {0};
+  for (int y = y0; y < y1; y++) {
+    for (int x = x0; x < x1; x++) {
+      histogram[image[y * width + x]]++;
+    }
+  }
+  uint32_t limit = agc->clahe_limit * n / 256;
+  limit = limit < 1 ? 1 : limit;
+  uint32_t excess = 0;
+  for (int i = 0; i < 256; i++) {
+    if (histogram[i] > limit) {
+      excess += histogram[i] - limit;
+      histogram[i] = limit;
+    }
+  }
+  uint32_t share = excess / 256;
+  uint32_t remainder = excess % 256;
+  uint32_t cumulative = 0;
+  float *lut = agc->tile_luts[ty][tx];
+  for (int i = 0; i < 256; i++) {
+    cumulative += histogram[i] + share + ((uint32_t) i < remainder);
+    float target = n ? 255.0f * cumulative / n : i;
+    lut[i] += follow * (target - lut[i]);
+  }
+}
+
+/**
+ * Interpolates the pixels of rows y0 to y1 between the curves of the four
+ * nearest CLAHE tiles.
+ */
+static void clahe_rows(void *context, int x0, int y0, int x1, int y1) {
+  const struct agc_job *job = context;
+  const struct pt1_agc *agc = job->agc;
+  uint8_t *image = job->out;
+  int width = job->width, height = job->height;
+  (void) x0;
+  (void) x1;
+  for (int y = y0; y < y1; y++) {
+    float fy = (y + 0.5f) * PT1_AGC_TILES_Y / height - 0.5f;
+    int ty0 = fy < 0 ? 0 : (int) fy;
+    int ty1 = ty0 + 1 < PT1_AGC_TILES_Y ? ty0 + 1 : ty0;
+    float wy = fy < 0 ? 0 : fy - ty0;
+    wy = wy > 1 ? 1 : wy;
+    for (int x = 0; x < width; x++) {
+      float fx = (x + 0.5f) * PT1_AGC_TILES_X / width - 0.5f;
+      int tx0 = fx < 0 ? 0 : (int) fx;
+      int tx1 = tx0 + 1 < PT1_AGC_TILES_X ? tx0 + 1 : tx0;
+      float wx = fx < 0 ? 0 : fx - tx0;
+      wx = wx > 1 ? 1 : wx;
+      uint8_t v = image[y * width + x];
+      float top = agc->tile_luts[ty0][tx0][v] * (1 - wx) + agc->tile_luts[ty0][tx1][v] * wx;
+      float bottom = agc->tile_luts[ty1][tx0][v] * (1 - wx) + agc->tile_luts[ty1][tx1][v] * wx;
+      image[y * width + x] = top * (1 - wy) + bottom * wy + 0.5f;
+    }
+  }
+}
+
+void pt1_agc_process(struct pt1_agc *agc, const uint16_t *pixels, int width, int height,
+                     uint8_t *out) {
+  size_t count = (size_t) width * height;
+  float points[PT1_AGC_POINTS];
+  pt1_agc_histogram(agc, pixels, count);
+  if (agc->mode == PT1_AGC_EQUALIZE) {
+    equalize_points(agc, count, points);
+  } else {
+    linear_points(agc, count, points);
+  }
+  /* Exponential smoothing of the curve so the brightness doesn't flicker. */
+  float follow = agc->frames ? 1 - agc->smoothing : 1;
+  for (int k = 0; k < PT1_AGC_POINTS; k++) {
+    agc->points[k] += follow * (points[k] - agc->points[k]);
+  }
+  build_lut(agc);
+  /* Full width tiles, contiguous in memory. */
+  struct agc_job job = {agc, pixels, out, width, height};
+  int rows = task_tile_rows(width, sizeof(*pixels));
+  task_run_tiles(agc->pool, width, height, width, rows, apply_lut_tile, &job);
+  if (agc->mode == PT1_AGC_CLAHE) {
+    /* Contrast limited adaptive histogram equalization: each tile gets its
+       own equalization curve and pixels are interpolated between the curves
+       of the four nearest tiles. */
+    task_run(agc->pool, PT1_AGC_TILES_X * PT1_AGC_TILES_Y, clahe_tile_lut, &job);
+    task_run_tiles(agc->pool, width, height, width, rows, clahe_rows, &job);
+  }
+  agc->frames++;
+}
+
+void pt1_agc_range(const struct pt1_agc *agc, uint16_t *low, uint16_t *high) {
+  *low = agc->lut_low;
+  *high = agc->lut_high;
+}
@@ -0,0 +1,107 @@
+#ifndef PT1_AGC_H
+#define PT1_AGC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pt1.h"
+#include "task.h"
+
+/**
+ * Number of histogram bins. One for every 14 bit pixel value.
+ */
+#define PT1_HISTOGRAM_SIZE (PT1_PMAX + 1)
+
+/**
+ * Number of points the equalization curve is made of.
+ */
+#define PT1_AGC_POINTS 257
+
+/**
+ * CLAHE divides the frame into PT1_AGC_TILES_X by PT1_AGC_TILES_Y tiles.
+ */
+#define PT1_AGC_TILES_X 4
+#define PT1_AGC_TILES_Y 3
+
+/**
+ * How frames are mapped to 8 bits.
+ * PT1_AGC_LINEAR maps the pixels between the low and high percentiles linearly.
+ * PT1_AGC_EQUALIZE spreads the pixels evenly over the 8 bit range.
+ * PT1_AGC_CLAHE is PT1_AGC_LINEAR followed by contrast limited adaptive
+ * histogram equalization over tiles of the frame.
+ */
+enum pt1_agc_mode {
+  PT1_AGC_LINEAR,
+  PT1_AGC_EQUALIZE,
+  PT1_AGC_CLAHE,
+  PT1_AGC_MODE_COUNT
+};
+
+/**
+ * Automatic gain control state. Large, so allocate it statically or on the heap.
+ */
+struct pt1_agc {
+  enum pt1_agc_mode mode;
+  /* Fraction of pixels clipped to 0 and to 255 in PT1_AGC_LINEAR and PT1_AGC_CLAHE. */
+  float clip_low, clip_high;
+  /* 0 follows every frame immediately, closer to 1 changes the mapping slower. */
+  float smoothing;
+  /* Limits CLAHE histogram bins to clahe_limit times the average bin. */
+  float clahe_limit;
+
+  /* Histogram of the last frame. Only bins from low to high are valid. */
+  uint32_t histogram[PT1_HISTOGRAM_SIZE];
+  uint16_t low, high;
+
+  /* Smoothed mapping curve. Pixels from points[k] to points[k + 1] map to k. */
+  float points[PT1_AGC_POINTS];
+  int frames;
+
+  /* Maps pixel values from lut_low to lut_high to 8 bits. */
+  uint8_t lut[PT1_HISTOGRAM_SIZE];
+  uint16_t lut_low, lut_high;
+
+  /* Smoothed CLAHE mapping of each tile. */
+  float tile_luts[PT1_AGC_TILES_Y][PT1_AGC_TILES_X][256];
+
+  /* Maps the pixels and runs CLAHE in tiles across the pool's threads when
+     set. NULL by default, worth it for frames much larger than a Lepton's. */
+  struct task_pool *pool;
+};
+
+/**
+ * Initializes agc with mode and default settings.
+ */
+void pt1_agc_init(struct pt1_agc *agc, enum pt1_agc_mode mode);
+
+/**
+ * Returns the name of mode e.g. "clahe".
+ */
+const char *pt1_agc_mode_name(enum pt1_agc_mode mode);
+
+/**
+ * Counts count pixels into agc->histogram and sets agc->low and agc->high to
+ * the smallest and largest pixel. Pixels above PT1_PMAX are counted as PT1_PMAX.
+ */
+void pt1_agc_histogram(struct pt1_agc *agc, const uint16_t *pixels, size_t count);
+
+/**
+ * Maps a width by height frame to 8 bits. The histogram is counted on the
+ * calling thread, the rest runs on agc->pool if set.
+ */
+void pt1_agc_process(struct pt1_agc *agc, const uint16_t *pixels, int width, int height,
+                     uint8_t *out);
+
+/**
+ * Returns the pixel values currently mapped to 0 and 255.
+ */
+void pt1_agc_range(const struct pt1_agc *agc, uint16_t *low, uint16_t *high);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
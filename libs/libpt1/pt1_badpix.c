@@ -0,0 +1,61 @@
+#include "pt1_badpix.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void pt1_bad_pixels_clear(struct pt1_bad_pixels *map) {
+  memset(map->flags, 0, sizeof(map->flags));
+}
+
+int pt1_bad_pixels_count(const struct pt1_bad_pixels *map) {
+  int count = 0;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      count += map->flags[y][x] != 0;
+    }
+  }
+  return count;
+}
+
+int pt1_bad_pixels_load(struct pt1_bad_pixels *map, const char *filename) {
+  FILE *fd = fopen(filename, "r");
+  if (!fd) {
+    return -1;
+  }
+  pt1_bad_pixels_clear(map);
+  char line[128];
+  int result = 0;
+  while (fgets(line, sizeof(line), fd)) {
+    int x, y;
+    unsigned flags;
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+      continue;
+    }
+    if (sscanf(line, "%d %d %u", &x, &y, &flags) != 3 ||
+        x < 0 || x >= PT1_WIDTH || y < 0 || y >= PT1_HEIGHT || flags > 0xFF) {
+      result = -1;
+      break;
+    }
+    map->flags[y][x] |= flags;
+  }
+  fclose(fd);
+  return result;
+}
+
+int pt1_bad_pixels_save(const struct pt1_bad_pixels *map, const char *filename) {
+  FILE *fd = fopen(filename, "w");
+  if (!fd) {
+    return -1;
+  }
+  fprintf(fd, "# pt1 bad pixel map, %d bad pixels\n", pt1_bad_pixels_count(map));
+  fprintf(fd, "# x y flags (%d dead, %d stuck, %d noisy)\n", PT1_BAD_DEAD, PT1_BAD_STUCK,
+          PT1_BAD_NOISY);
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      if (map->flags[y][x]) {
+        fprintf(fd, "%d %d %u\n", x, y, map->flags[y][x]);
+      }
+    }
+  }
+  return fclose(fd) ? -1 : 0;
+}
@@ -0,0 +1,51 @@
+#ifndef PT1_BADPIX_H
+#define PT1_BADPIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "pt1.h"
+
+/* Reads far from its neighbors, e.g. always 0 or saturated. */
+#define PT1_BAD_DEAD 1
+/* Doesn't change over time. */
+#define PT1_BAD_STUCK 2
+/* Much noisier than the other pixels. */
+#define PT1_BAD_NOISY 4
+
+/**
+ * Flags of every pixel. 0 is a good pixel.
+ */
+struct pt1_bad_pixels {
+  uint8_t flags[PT1_HEIGHT][PT1_WIDTH];
+};
+
+/**
+ * Marks every pixel good.
+ */
+void pt1_bad_pixels_clear(struct pt1_bad_pixels *map);
+
+/**
+ * Returns the number of bad pixels.
+ */
+int pt1_bad_pixels_count(const struct pt1_bad_pixels *map);
+
+/**
+ * Reads a bad pixel map written by pt1_bad_pixels_save.
+ * The file has one "x y flags" line per bad pixel. Lines starting with # are
+ * comments. Returns 0 on success and -1 if the file can't be read or is invalid.
+ */
+int pt1_bad_pixels_load(struct pt1_bad_pixels *map, const char *filename);
+
+/**
+ * Writes map to filename. Returns 0 on success and -1 on failure.
+ */
+int pt1_bad_pixels_save(const struct pt1_bad_pixels *map, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+#include "pt1_color.h"
+
+#include <string.h>
+
+/* Pixels are converted in blocks so the index buffer stays in L1 cache. */
+#define BLOCK_SIZE 256
+
+/**
+ * A color at position (0 to 255) along a palette.
+ */
+struct stop {
+  int position;
+  uint8_t r, g, b;
+};
+
+static const struct stop ironbow[] = {
+  {0, 0, 0, 0},
+  {40, 32, 0, 100},
+  {90, 120, 0, 150},
+  {140, 200, 30, 110},
+  {185, 240, 100, 20},
+  {225, 255, 190, 30},
+  {255, 255, 255, 230},
+};
+
+static const struct stop rainbow[] = {
+  {0, 0, 0, 0},
+  {42, 0, 0, 255},
+  {85, 0, 255, 255},
+  {128, 0, 255, 0},
+  {170, 255, 255, 0},
+  {213, 255, 0, 0},
+  {255, 255, 255, 255},
+};
+
+static const struct stop white_hot[] = {
+  {0, 0, 0, 0},
+  {255, 255, 255, 255},
+};
+
+static const struct stop black_hot[] = {
+  {0, 255, 255, 255},
+  {255, 0, 0, 0},
+};
+
+static void interpolate(struct pt1_colormap *map, const struct stop *stops, int count) {
+  int s = 0;
+  for (int i = 0; i < 256; i++) {
+    while (s < count - 2 && i > stops[s + 1].position) {
+      s++;
+    }
+    const struct stop *a = &stops[s];
+    const struct stop *b = &stops[s + 1];
+    int width = b->position - a->position;
+    int t = i - a->position;
+    uint8_t *c = map->rgb[i + 1];
+    c[0] = a->r + (b->r - a->r) * t / width;
+    c[1] = a->g + (b->g - a->g) * t / width;
+    c[2] = a->b + (b->b - a->b) * t / width;
+  }
+  memcpy(map->rgb[PT1_COLORMAP_UNDER], map->rgb[1], 3);
+  memcpy(map->rgb[PT1_COLORMAP_OVER], map->rgb[256], 3);
+}
+
+#define STOPS(s) s, sizeof(s) / sizeof(*s)
+
+void pt1_colormap_init(struct pt1_colormap *map, enum pt1_palette palette) {
+  switch (palette) {
+  default:
+  case PT1_PALETTE_GRAYSCALE:
+    interpolate(map, STOPS(white_hot));
+    map->rgb[PT1_COLORMAP_UNDER][0] = 0;
+    map->rgb[PT1_COLORMAP_UNDER][1] = 0;
+    map->rgb[PT1_COLORMAP_UNDER][2] = 0xFF;
+    map->rgb[PT1_COLORMAP_OVER][0] = 0xFF;
+    map->rgb[PT1_COLORMAP_OVER][1] = 0;
+    map->rgb[PT1_COLORMAP_OVER][2] = 0;
+    break;
+  case PT1_PALETTE_WHITE_HOT:
+    interpolate(map, STOPS(white_hot));
+    break;
+  case PT1_PALETTE_BLACK_HOT:
+    interpolate(map, STOPS(black_hot));
+    break;
+  case PT1_PALETTE_IRONBOW:
+    interpolate(map, STOPS(ironbow));
+    break;
+  case PT1_PALETTE_RAINBOW:
+    interpolate(map, STOPS(rainbow));
+    break;
+  }
+  /* Force the lookup table to be rebuilt with the new colors. */
+  memset(map->lut, 0, sizeof(map->lut));
+  map->lut_low = map->lut_high = -1;
+}
+
+const char *pt1_palette_name(enum pt1_palette palette) {
+  switch (palette) {
+  case PT1_PALETTE_GRAYSCALE: return "grayscale";
+  case PT1_PALETTE_WHITE_HOT: return "white-hot";
+  case PT1_PALETTE_BLACK_HOT: return "black-hot";
+  case PT1_PALETTE_IRONBOW: return "ironbow";
+  case PT1_PALETTE_RAINBOW: return "rainbow";
+  default: return "unknown";
+  }
+}
+
+void pt1_find_range(const uint16_t *pixels, size_t count, uint16_t *low, uint16_t *high) {
+  uint16_t min = 0xFFFF;
+  uint16_t max = 0;
+  /* No early exits or branches so the compiler can vectorize this loop. */
+  for (size_t i = 0; i < count; i++) {
+    uint16_t p = pixels[i];
+    min = p < min ? p : min;
+    max = p > max ? p : max;
+  }
+  *low = min;
+  *high = max;
+}
+
+/**
+ * Fills the lookup table for pixel values low - 1 to high + 1.
+ * Costs one entry per value in the range so changing the range every frame
+ * (auto range) stays cheap.
+ */
+static void build_lut(struct pt1_colormap *map, int low, int high) {
+  int range = high > low ? high - low : 1;
+  /* 16.16 fixed point. range * scale never exceeds 255 << 16. */
+  int32_t scale = (255 << 16) / range;
+  memcpy(&map->lut[0], map->rgb[PT1_COLORMAP_UNDER], 3);
+  for (int t = 0; t <= high - low; t++) {
+    memcpy(&map->lut[t + 1], map->rgb[((t * scale) >> 16) + 1], 3);
+  }
+  memcpy(&map->lut[high - low + 2], map->rgb[PT1_COLORMAP_OVER], 3);
+  map->lut_low = low;
+  map->lut_high = high;
+}
+
+void pt1_colorize(struct pt1_colormap *map, const uint16_t *pixels, size_t count,
+                  uint16_t low, uint16_t high, uint8_t *rgb) {
+  uint16_t index[BLOCK_SIZE];
+  if (high > PT1_PMAX) {
+    high = PT1_PMAX;
+  }
+  if (low > high) {
+    low = high;
+  }
+  if (low != map->lut_low || high != map->lut_high) {
+    build_lut(map, low, high);
+  }
+  /* Clamping to one past either end of the range maps those pixels to the
+     under and over entries of the lookup table. Nothing can be under a range
+     starting at 0 so the clamp stays in 16 bits. */
+  uint16_t under = low ? low - 1 : 0;
+  uint16_t over = high + 1;
+  uint16_t offset = low ? 0 : 1;
+  for (size_t start = 0; start < count; start += BLOCK_SIZE) {
+    size_t n = count - start < BLOCK_SIZE ? count - start : BLOCK_SIZE;
+    /* No branches so the compiler vectorizes this loop (SSE2 / NEON). */
+    for (size_t i = 0; i < n; i++) {
+      uint16_t p = pixels[start + i];
+      p = p < under ? under : p;
+      p = p > over ? over : p;
+      index[i] = p - under + offset;
+    }
+    /* Each color is stored as 4 bytes and written over the next pixel's
+       first byte, which is cheaper than three single byte stores. The last
+       pixel is copied with 3 bytes to stay inside rgb. */
+    uint8_t *out = rgb + start * 3;
+    for (size_t i = 0; i + 1 < n; i++) {
+      memcpy(out, &map->lut[index[i]], 4);
+      out += 3;
+    }
+    memcpy(out, &map->lut[index[n - 1]], 3);
+  }
+}
+
+void pt1_colorize_auto(struct pt1_colormap *map, const uint16_t *pixels, size_t count,
+                       uint8_t *rgb) {
+  uint16_t low, high;
+  pt1_find_range(pixels, count, &low, &high);
+  pt1_colorize(map, pixels, count, low, high, rgb);
+}
+
+void pt1_colorize_8bit(const struct pt1_colormap *map, const uint8_t *pixels, size_t count,
+                       uint8_t *rgb) {
+  for (size_t i = 0; i < count; i++) {
+    memcpy(rgb + i * 3, map->rgb[pixels[i] + 1], 3);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef PT1_COLOR_H
+#define PT1_COLOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pt1.h"
+
+/**
+ * Number of entries in a colormap. Entry 0 is used for pixels below the
+ * range, entries 1 to 256 are the palette and entry 257 is used for pixels
+ * above the range.
+ */
+#define PT1_COLORMAP_SIZE 258
+#define PT1_COLORMAP_UNDER 0
+#define PT1_COLORMAP_OVER (PT1_COLORMAP_SIZE - 1)
+
+/**
+ * Available palettes.
+ * PT1_PALETTE_GRAYSCALE is the original pt1play palette. Pixels below the
+ * range are blue and pixels above the range are red.
+ */
+enum pt1_palette {
+  PT1_PALETTE_GRAYSCALE,
+  PT1_PALETTE_WHITE_HOT,
+  PT1_PALETTE_BLACK_HOT,
+  PT1_PALETTE_IRONBOW,
+  PT1_PALETTE_RAINBOW,
+  PT1_PALETTE_COUNT
+};
+
+/**
+ * Number of entries in the lookup table. One for every 14 bit pixel value
+ * plus one below and one above the range.
+ */
+#define PT1_COLOR_LUT_SIZE (PT1_PMAX + 3)
+
+/**
+ * Maps palette indices to RGB24 colors.
+ * lut caches the color of every pixel value in the range last passed to
+ * pt1_colorize and is rebuilt when the range changes, so a colormap must not
+ * be shared between threads.
+ */
+struct pt1_colormap {
+  uint8_t rgb[PT1_COLORMAP_SIZE][3];
+  uint32_t lut[PT1_COLOR_LUT_SIZE];
+  int lut_low, lut_high;
+};
+
+/**
+ * Fills map with palette.
+ */
+void pt1_colormap_init(struct pt1_colormap *map, enum pt1_palette palette);
+
+/**
+ * Returns the name of palette e.g. "ironbow".
+ */
+const char *pt1_palette_name(enum pt1_palette palette);
+
+/**
+ * Finds the smallest and largest of count pixels.
+ */
+void pt1_find_range(const uint16_t *pixels, size_t count, uint16_t *low, uint16_t *high);
+
+/**
+ * Converts count Y16 pixels to RGB24 using map.
+ * low is the first value of the palette and high is the last value.
+ * Values above PT1_PMAX are treated as above the range.
+ */
+void pt1_colorize(struct pt1_colormap *map, const uint16_t *pixels, size_t count,
+                  uint16_t low, uint16_t high, uint8_t *rgb);
+
+/**
+ * Same as pt1_colorize but the range is the smallest and largest pixel.
+ */
+void pt1_colorize_auto(struct pt1_colormap *map, const uint16_t *pixels, size_t count,
+                       uint8_t *rgb);
+
+/**
+ * Converts count 8 bit pixels, e.g. from pt1_agc_process, to RGB24 using map.
+ */
+void pt1_colorize_8bit(const struct pt1_colormap *map, const uint8_t *pixels, size_t count,
+                       uint8_t *rgb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
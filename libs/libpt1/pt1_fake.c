@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 uint16_t buffer[PT1_HEIGHT][PT1_WIDTH];
+long sequence;
 
 void pt1_perform_ffc() {
   printf("pt1_perform_ffc()\n");
@@ -32,6 +33,8 @@ void pt1_get_frame(struct pt1_frame *frame) {
     }
   }
   frame->start = buffer;
+  frame->length = sizeof(buffer);
+  frame->sequence = sequence++;
 }
 
 void pt1_deinit() {
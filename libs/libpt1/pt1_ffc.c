@@ -0,0 +1,86 @@
+#include "pt1_ffc.h"
+
+#include <math.h>
+#include <string.h>
+
+void pt1_ffc_init(struct pt1_ffc *ffc) {
+  ffc->threshold = 3;
+  ffc->rate = 1.0f / 64;
+  ffc->settle_frames = 9;
+  ffc->baseline_frames = 128;
+  ffc->min_frames = 516;
+  ffc->max_frames = 5160;
+  memset(ffc->average, 0, sizeof(ffc->average));
+  ffc->baseline = 0;
+  ffc->drift = 0;
+  ffc->frames = 0;
+  ffc->count = 0;
+}
+
+/**
+ * Adds the frame's difference to the 4 neighbor mean to the time average and
+ * returns the RMS of the average. Border pixels are left out.
+ */
+static float update_average(struct pt1_ffc *ffc, const uint16_t *frame) {
+  ffc->count++;
+  /* A plain mean until there are enough frames for the running average. */
+  float weight = 1.0f / ffc->count > ffc->rate ? 1.0f / ffc->count : ffc->rate;
+  float sum = 0;
+  for (int y = 1; y < PT1_HEIGHT - 1; y++) {
+    const uint16_t *row = frame + y * PT1_WIDTH;
+    float *average = ffc->average + y * PT1_WIDTH;
+    for (int x = 1; x < PT1_WIDTH - 1; x++) {
+      float residual = row[x] - 0.25f * (row[x - 1] + row[x + 1] + row[x - PT1_WIDTH] +
+                                         row[x + PT1_WIDTH]);
+      average[x] += weight * (residual - average[x]);
+    }
+    /* Summed separately so the loop above vectorizes. */
+    for (int x = 1; x < PT1_WIDTH - 1; x++) {
+      sum += average[x] * average[x];
+    }
+  }
+  return sqrtf(sum / ((PT1_WIDTH - 2) * (PT1_HEIGHT - 2)));
+}
+
+enum pt1_ffc_state pt1_ffc_update(struct pt1_ffc *ffc, const uint16_t *frame) {
+  ffc->frames++;
+  if (ffc->frames <= ffc->settle_frames) {
+    return PT1_FFC_SETTLING;
+  }
+  float rms = update_average(ffc, frame);
+  if (ffc->count == ffc->baseline_frames) {
+    ffc->baseline = rms;
+  }
+  if (ffc->count >= ffc->baseline_frames) {
+    ffc->drift = rms > ffc->baseline ? rms - ffc->baseline : 0;
+  }
+  if (ffc->max_frames && ffc->frames >= ffc->max_frames) {
+    return PT1_FFC_URGENT;
+  }
+  if (ffc->frames < ffc->min_frames) {
+    return PT1_FFC_OK;
+  }
+  if (ffc->drift > 2 * ffc->threshold) {
+    return PT1_FFC_URGENT;
+  }
+  return ffc->drift > ffc->threshold ? PT1_FFC_DUE : PT1_FFC_OK;
+}
+
+void pt1_ffc_perform(struct pt1_ffc *ffc) {
+  pt1_perform_ffc();
+  memset(ffc->average, 0, sizeof(ffc->average));
+  ffc->baseline = 0;
+  ffc->drift = 0;
+  ffc->frames = 0;
+  ffc->count = 0;
+}
+
+const char *pt1_ffc_state_name(enum pt1_ffc_state state) {
+  switch (state) {
+  case PT1_FFC_OK: return "ok";
+  case PT1_FFC_DUE: return "due";
+  case PT1_FFC_URGENT: return "urgent";
+  case PT1_FFC_SETTLING: return "settling";
+  default: return "unknown";
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef PT1_FFC_H
+#define PT1_FFC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "pt1.h"
+#include "pt1_stats.h"
+
+/**
+ * What pt1_ffc_update recommends.
+ * PT1_FFC_OK: no FFC needed.
+ * PT1_FFC_DUE: fixed pattern noise has drifted, perform an FFC at the next
+ * convenient moment e.g. between tracking events.
+ * PT1_FFC_URGENT: drifted far or too long since the last FFC, perform it now.
+ * PT1_FFC_SETTLING: an FFC was just performed and frames may be frozen or
+ * uncorrected. Don't use them for anything that needs a stable image.
+ */
+enum pt1_ffc_state {
+  PT1_FFC_OK,
+  PT1_FFC_DUE,
+  PT1_FFC_URGENT,
+  PT1_FFC_SETTLING
+};
+
+/**
+ * Decides when to perform FFC instead of letting the camera freeze the stream
+ * on its own schedule. Disable the camera's automatic FFC with pt1_disable_ffc.
+ *
+ * Fixed pattern noise is estimated from each pixel's difference to the mean
+ * of its 4 neighbors, averaged over time. Scene detail moves and averages out
+ * while the pattern stays, so the RMS of the average grows as the pattern
+ * drifts. The RMS measured once the average has settled after an FFC is the
+ * baseline and drift is measured from it.
+ */
+struct pt1_ffc {
+  /* Drift in counts RMS that makes an FFC due. Twice this makes it urgent. */
+  float threshold;
+  /* Weight of each frame in the time average. */
+  float rate;
+  /* Frames after an FFC that are reported as settling. */
+  uint32_t settle_frames;
+  /* Frames after settling before the baseline is taken. */
+  uint32_t baseline_frames;
+  /* No FFC is due sooner than min_frames after the last one and one is urgent
+     max_frames after the last one. 0 disables max_frames. */
+  uint32_t min_frames, max_frames;
+
+  float average[PT1_PIXELS];
+  float baseline;
+  float drift;
+  uint32_t frames;
+  uint32_t count;
+};
+
+/**
+ * Initializes ffc with defaults for the Lepton's 8.6 frames per second.
+ */
+void pt1_ffc_init(struct pt1_ffc *ffc);
+
+/**
+ * Updates the drift estimate with a frame and returns what to do.
+ */
+enum pt1_ffc_state pt1_ffc_update(struct pt1_ffc *ffc, const uint16_t *frame);
+
+/**
+ * Calls pt1_perform_ffc and restarts drift estimation.
+ */
+void pt1_ffc_perform(struct pt1_ffc *ffc);
+
+/**
+ * Returns the name of state e.g. "due".
+ */
+const char *pt1_ffc_state_name(enum pt1_ffc_state state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+#include "pt1_nuc.h"
+
+#include <math.h>
+#include <stdio.h>
+
+void pt1_nuc_init(struct pt1_nuc *nuc) {
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    nuc->gain[i] = PT1_NUC_GAIN_ONE;
+    nuc->offset[i] = 0;
+  }
+  nuc->bad_count = 0;
+}
+
+static float average(const float *frame) {
+  double sum = 0;
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    sum += frame[i];
+  }
+  return sum / PT1_PIXELS;
+}
+
+static int16_t to_offset(float offset) {
+  offset = roundf(offset);
+  return offset < -0x7FFF ? -0x7FFF : offset > 0x7FFF ? 0x7FFF : offset;
+}
+
+static uint16_t to_gain(float gain) {
+  gain = roundf(gain * PT1_NUC_GAIN_ONE);
+  return gain < 0 ? 0 : gain > 0xFFFF ? 0xFFFF : gain;
+}
+
+void pt1_nuc_one_point(struct pt1_nuc *nuc, const float *flat) {
+  float target = average(flat);
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    float gain = (float) nuc->gain[i] / PT1_NUC_GAIN_ONE;
+    nuc->offset[i] = to_offset(target - flat[i] * gain);
+  }
+}
+
+void pt1_nuc_two_point(struct pt1_nuc *nuc, const float *cold, const float *hot) {
+  float target_cold = average(cold);
+  float target_hot = average(hot);
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    float response = hot[i] - cold[i];
+    float gain = response > 0 ? (target_hot - target_cold) / response : 1;
+    /* Gains outside 0 to 4 are bad pixels, leave those to the bad pixel map. */
+    if (gain <= 0 || gain >= 4) {
+      gain = 1;
+    }
+    nuc->gain[i] = to_gain(gain);
+    nuc->offset[i] = to_offset(target_cold - cold[i] * gain);
+  }
+}
+
+int pt1_nuc_set_bad_pixels(struct pt1_nuc *nuc, const struct pt1_bad_pixels *map) {
+  if (pt1_bad_pixels_count(map) > PT1_NUC_MAX_BAD) {
+    return -1;
+  }
+  nuc->bad_count = 0;
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      if (!map->flags[y][x]) {
+        continue;
+      }
+      struct pt1_nuc_bad_pixel *bad = &nuc->bad[nuc->bad_count++];
+      bad->index = y * PT1_WIDTH + x;
+      bad->count = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          int nx = x + dx, ny = y + dy;
+          if (nx >= 0 && nx < PT1_WIDTH && ny >= 0 && ny < PT1_HEIGHT && !map->flags[ny][nx]) {
+            bad->neighbors[bad->count++] = ny * PT1_WIDTH + nx;
+          }
+        }
+      }
+      /* Clusters of bad pixels use the closest good pixel in the row. */
+      for (int d = 2; !bad->count && d < PT1_WIDTH; d++) {
+        if (x - d >= 0 && !map->flags[y][x - d]) {
+          bad->neighbors[bad->count++] = y * PT1_WIDTH + x - d;
+        } else if (x + d < PT1_WIDTH && !map->flags[y][x + d]) {
+          bad->neighbors[bad->count++] = y * PT1_WIDTH + x + d;
+        }
+      }
+      if (!bad->count) {
+        /* The whole row is bad, keep the pixel. */
+        nuc->bad_count--;
+      }
+    }
+  }
+  return 0;
+}
+
+void pt1_nuc_apply(const struct pt1_nuc *nuc, const uint16_t *in, uint16_t *out) {
+  /* No branches so the compiler vectorizes this loop (SSE2 / NEON). */
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    int32_t p = ((int32_t) in[i] * nuc->gain[i] + (1 << (PT1_NUC_GAIN_BITS - 1))) >>
+                PT1_NUC_GAIN_BITS;
+    p += nuc->offset[i];
+    p = p < 0 ? 0 : p;
+    p = p > PT1_PMAX ? PT1_PMAX : p;
+    out[i] = p;
+  }
+  /* Neighbors are always good pixels so the order doesn't matter. */
+  for (int b = 0; b < nuc->bad_count; b++) {
+    const struct pt1_nuc_bad_pixel *bad = &nuc->bad[b];
+    uint32_t sum = 0;
+    for (int n = 0; n < bad->count; n++) {
+      sum += out[bad->neighbors[n]];
+    }
+    out[bad->index] = (sum + bad->count / 2) / bad->count;
+  }
+}
+
+/**
+ * Reads PT1_HEIGHT lines of PT1_WIDTH comma separated values, skipping comments.
+ */
+static int read_map(FILE *fd, float *values) {
+  char line[PT1_WIDTH * 16];
+  int y = 0;
+  while (y < PT1_HEIGHT && fgets(line, sizeof(line), fd)) {
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+      continue;
+    }
+    char *p = line;
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      int used;
+      if (sscanf(p, x ? ",%f%n" : "%f%n", &values[y * PT1_WIDTH + x], &used) != 1) {
+        return -1;
+      }
+      p += used;
+    }
+    y++;
+  }
+  return y == PT1_HEIGHT ? 0 : -1;
+}
+
+int pt1_nuc_load(struct pt1_nuc *nuc, const char *filename) {
+  static float gain[PT1_PIXELS], offset[PT1_PIXELS];
+  FILE *fd = fopen(filename, "r");
+  if (!fd) {
+    return -1;
+  }
+  int result = read_map(fd, gain) || read_map(fd, offset) ? -1 : 0;
+  fclose(fd);
+  if (result) {
+    return -1;
+  }
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    if (gain[i] < 0 || gain[i] >= 4) {
+      return -1;
+    }
+  }
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    nuc->gain[i] = to_gain(gain[i]);
+    nuc->offset[i] = to_offset(offset[i]);
+  }
+  return 0;
+}
+
+int pt1_nuc_save(const struct pt1_nuc *nuc, const char *filename) {
+  FILE *fd = fopen(filename, "w");
+  if (!fd) {
+    return -1;
+  }
+  fprintf(fd, "# pt1 non-uniformity correction\n");
+  fprintf(fd, "# corrected = pixel * gain + offset\n");
+  fprintf(fd, "# gains\n");
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      fprintf(fd, x ? ",%.5f" : "%.5f", (float) nuc->gain[y * PT1_WIDTH + x] / PT1_NUC_GAIN_ONE);
+    }
+    fprintf(fd, "\n");
+  }
+  fprintf(fd, "# offsets\n");
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      fprintf(fd, x ? ",%d" : "%d", nuc->offset[y * PT1_WIDTH + x]);
+    }
+    fprintf(fd, "\n");
+  }
+  return fclose(fd) ? -1 : 0;
+}
@@ -0,0 +1,94 @@
+#ifndef PT1_NUC_H
+#define PT1_NUC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "pt1.h"
+#include "pt1_stats.h"
+#include "pt1_badpix.h"
+
+/**
+ * Gains are fixed point with PT1_NUC_GAIN_BITS fractional bits so
+ * PT1_NUC_GAIN_ONE is a gain of 1.
+ */
+#define PT1_NUC_GAIN_BITS 14
+#define PT1_NUC_GAIN_ONE (1 << PT1_NUC_GAIN_BITS)
+
+/**
+ * Most bad pixels that can be replaced. Ten percent of the frame.
+ */
+#define PT1_NUC_MAX_BAD (PT1_PIXELS / 10)
+
+/**
+ * A bad pixel and the good pixels around it that replace it.
+ */
+struct pt1_nuc_bad_pixel {
+  uint16_t index;
+  uint16_t count;
+  uint16_t neighbors[8];
+};
+
+/**
+ * Software non-uniformity correction. Every pixel is corrected as
+ * (pixel * gain >> PT1_NUC_GAIN_BITS) + offset, then bad pixels are replaced by
+ * the mean of their good neighbors.
+ * Calibrate with a recording of a uniform scene (e.g. the lens cap) taken
+ * right after an FFC, so the maps only hold what the camera's FFC leaves behind.
+ */
+struct pt1_nuc {
+  uint16_t gain[PT1_PIXELS];
+  int16_t offset[PT1_PIXELS];
+  int bad_count;
+  struct pt1_nuc_bad_pixel bad[PT1_NUC_MAX_BAD];
+};
+
+/**
+ * Sets every gain to 1, every offset to 0 and every pixel good.
+ */
+void pt1_nuc_init(struct pt1_nuc *nuc);
+
+/**
+ * Sets the offsets so the mean frame flat of a uniform scene becomes uniform.
+ * Gains are left as they are.
+ */
+void pt1_nuc_one_point(struct pt1_nuc *nuc, const float *flat);
+
+/**
+ * Sets the gains and offsets from mean frames of a cold and a hot uniform
+ * scene so both become uniform.
+ */
+void pt1_nuc_two_point(struct pt1_nuc *nuc, const float *cold, const float *hot);
+
+/**
+ * Replaces the pixels flagged in map. Neighbors are searched in a 3x3 window
+ * and then along the row. Returns 0 on success and -1 if map has more than
+ * PT1_NUC_MAX_BAD bad pixels, in which case no pixels are replaced.
+ */
+int pt1_nuc_set_bad_pixels(struct pt1_nuc *nuc, const struct pt1_bad_pixels *map);
+
+/**
+ * Corrects a frame. in and out may be the same buffer.
+ */
+void pt1_nuc_apply(const struct pt1_nuc *nuc, const uint16_t *in, uint16_t *out);
+
+/**
+ * Reads gains and offsets written by pt1_nuc_save. Bad pixels aren't stored,
+ * load them with pt1_bad_pixels_load. Returns 0 on success and -1 if the file
+ * can't be read or is invalid.
+ */
+int pt1_nuc_load(struct pt1_nuc *nuc, const char *filename);
+
+/**
+ * Writes the gains and offsets to filename as 60 lines of 80 gains followed by
+ * 60 lines of 80 offsets. Returns 0 on success and -1 on failure.
+ */
+int pt1_nuc_save(const struct pt1_nuc *nuc, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
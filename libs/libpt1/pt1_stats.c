@@ -0,0 +1,65 @@
+#include "pt1_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+void pt1_pixel_stats_init(struct pt1_pixel_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    stats->min[i] = 0xFFFF;
+  }
+}
+
+void pt1_pixel_stats_add(struct pt1_pixel_stats *stats, const uint16_t *frame, uint32_t t) {
+  /* Separate loops over contiguous arrays, vectorized by the compiler. */
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    uint32_t p = frame[i];
+    stats->sum[i] += p;
+    stats->sum_squares[i] += p * p;
+    stats->sum_tp[i] += (uint64_t) t * p;
+  }
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    uint16_t p = frame[i];
+    stats->min[i] = p < stats->min[i] ? p : stats->min[i];
+    stats->max[i] = p > stats->max[i] ? p : stats->max[i];
+  }
+  stats->frames++;
+  stats->sum_t += t;
+  stats->sum_t2 += (uint64_t) t * t;
+}
+
+void pt1_pixel_stats_merge(struct pt1_pixel_stats *stats, const struct pt1_pixel_stats *from) {
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    stats->sum[i] += from->sum[i];
+    stats->sum_squares[i] += from->sum_squares[i];
+    stats->sum_tp[i] += from->sum_tp[i];
+  }
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    stats->min[i] = from->min[i] < stats->min[i] ? from->min[i] : stats->min[i];
+    stats->max[i] = from->max[i] > stats->max[i] ? from->max[i] : stats->max[i];
+  }
+  stats->frames += from->frames;
+  stats->sum_t += from->sum_t;
+  stats->sum_t2 += from->sum_t2;
+}
+
+void pt1_pixel_stats_maps(const struct pt1_pixel_stats *stats, float *mean, float *stddev,
+                          float *drift) {
+  double n = stats->frames;
+  /* n times the variance of t */
+  double t_spread = stats->sum_t2 - (double) stats->sum_t * stats->sum_t / n;
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    double m = n ? stats->sum[i] / n : 0;
+    if (mean) {
+      mean[i] = m;
+    }
+    if (stddev) {
+      double variance = n ? stats->sum_squares[i] / n - m * m : 0;
+      stddev[i] = variance > 0 ? sqrt(variance) : 0;
+    }
+    if (drift) {
+      double covariance = stats->sum_tp[i] - (double) stats->sum_t * stats->sum[i] / n;
+      drift[i] = t_spread > 0 ? covariance / t_spread : 0;
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef PT1_STATS_H
+#define PT1_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "pt1.h"
+
+#define PT1_PIXELS (PT1_WIDTH * PT1_HEIGHT)
+
+/**
+ * Per pixel temporal statistics of a sequence of frames.
+ * Only integer sums are kept so accumulators filled from different parts of a
+ * recording, e.g. by different threads, merge exactly.
+ */
+struct pt1_pixel_stats {
+  uint64_t frames;
+  /* Sums of the frame index t and t squared. */
+  uint64_t sum_t, sum_t2;
+  uint64_t sum[PT1_PIXELS];
+  uint64_t sum_squares[PT1_PIXELS];
+  /* Sum of t times the pixel, for the drift. */
+  uint64_t sum_tp[PT1_PIXELS];
+  uint16_t min[PT1_PIXELS];
+  uint16_t max[PT1_PIXELS];
+};
+
+/**
+ * Clears stats.
+ */
+void pt1_pixel_stats_init(struct pt1_pixel_stats *stats);
+
+/**
+ * Adds a frame. t is the frame's index in the sequence.
+ */
+void pt1_pixel_stats_add(struct pt1_pixel_stats *stats, const uint16_t *frame, uint32_t t);
+
+/**
+ * Adds the frames in from to stats.
+ */
+void pt1_pixel_stats_merge(struct pt1_pixel_stats *stats, const struct pt1_pixel_stats *from);
+
+/**
+ * Computes the mean, standard deviation and drift (least squares slope in
+ * counts per frame) of every pixel. Any of the outputs may be NULL.
+ */
+void pt1_pixel_stats_maps(const struct pt1_pixel_stats *stats, float *mean, float *stddev,
+                          float *drift);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
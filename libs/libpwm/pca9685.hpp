@@ -0,0 +1,17 @@
+#ifndef PCA9685_HPP
+#define PCA9685_HPP
+
+// PCA9685 registers and bits, shared by PWMDevice and the simulator.
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE1_RESTART 0x80
+#define PCA9685_MODE1_AI 0x20
+#define PCA9685_MODE1_SLEEP 0x10
+// LED0_ON_L. Each channel has ON_L, ON_H, OFF_L and OFF_H from here.
+#define PCA9685_LED0 0x06
+#define PCA9685_PRE_SCALE 0xfe
+// The full on and full off bit in ON_H and OFF_H.
+#define PCA9685_FULL 0x10
+#define PCA9685_OSCILLATOR_HZ 25000000
+
+#endif
@@ -10,73 +10,32 @@
 #include <errno.h>
 #include <unistd.h>
 
-#define ADDRESS 0x40
-
-// 205 410
-PWMDevice::PWMDevice(const char *path) {
+PWMDevice::PWMDevice(const char *path, float frequency) : sim(NULL), periods(), stats() {
 	if ((fd = open(path, O_RDWR)) < 0) {
 		perror("open failed");
-	} else {
-		struct i2c_msg msgs[2];
-
-		msgs[0].addr = ADDRESS;
-		msgs[0].flags = 0;
-		msgs[0].len = 2;
-		uint8_t buf0[2];
-		buf0[0] = 0xfe;
-		// 0x86 sets prescaler to 20ms period with 25mhz clock
-		buf0[1] = 0x86;
-		msgs[0].buf = buf0;
-
-		msgs[1].addr = ADDRESS;
-		msgs[1].flags = 0;
-		msgs[1].len = 2;
-		uint8_t buf1[2];
-		buf1[0] = 0x00;
-		buf1[1] = 0x80;
-		msgs[1].buf = buf1;
-
-		struct i2c_rdwr_ioctl_data data;
-		data.msgs = msgs;
-		data.nmsgs = 2;
-		if (ioctl(fd, I2C_RDWR, &data) < 0) {
-			perror("PWMDevice()");
-		}
 	}
+	init(frequency);
 }
 
 PWMDevice::~PWMDevice() {
 	close(fd);
 }
 
-// max 2048
-void PWMDevice::setPeriod(unsigned char channel, unsigned short period) {
-	struct i2c_msg msgs[2];
-	msgs[0].addr = ADDRESS;
-	msgs[0].flags = 0;
-	msgs[0].len = 2;
-	uint8_t buf0[2];
-	buf0[0] = 4 * channel + 0x08;
-	buf0[1] = period & 0x00FF;
-	msgs[0].buf = buf0;
-
-	msgs[1].addr = ADDRESS;
-	msgs[1].flags = 0;
-	msgs[1].len = 2;
-	uint8_t buf1[2];
-	buf1[0] = 4 * channel + 0x09;
-	buf1[1] = (period >> 8) & 0x000F;
-	msgs[1].buf = buf1;
-
-	struct i2c_rdwr_ioctl_data data;
-	data.msgs = msgs;
-	data.nmsgs = 2;
-	if (ioctl(fd, I2C_RDWR, &data) < 0) {
-		perror("setPeriod()");
+bool PWMDevice::transfer(uint8_t *data, int length, std::chrono::nanoseconds &time) {
+	struct i2c_msg msg;
+	msg.addr = address;
+	msg.flags = 0;
+	msg.len = length;
+	msg.buf = data;
+
+	struct i2c_rdwr_ioctl_data rdwr;
+	rdwr.msgs = &msg;
+	rdwr.nmsgs = 1;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = ioctl(fd, I2C_RDWR, &rdwr) >= 0;
+	time = std::chrono::steady_clock::now() - start;
+	if (!ok) {
+		perror("PWMDevice::transfer()");
 	}
-}
-
-void PWMDevice::setPosition(unsigned char channel, float position) {
-	// 0xcd is 1ms
-	setPeriod(channel, (position + 1) / 2 * 0xcd + 0xcd);
+	return ok;
 }
@@ -1,24 +1,122 @@
 #ifndef PWM_HPP
 #define PWM_HPP
 
+#include <chrono>
 #include <stdint.h>
 
 const uint8_t address = 0x40;
+const int PWM_CHANNELS = 16;
+// Segments of the calibration lookup tables between -1 and 1.
+const int PWM_LUT_SIZE = 256;
+
+/**
+ * Maps a channel's position to its pulse width.
+ */
+struct PWMCalibration {
+	// Pulse widths at -1, 0 and 1, in us. The output never leaves min_us to
+	// max_us.
+	float min_us, center_us, max_us;
+	// Added to every pulse width, in us.
+	float trim_us;
+	// Softens the response around the centre, from 0 linear to 1 cubic.
+	float expo;
+	// Swaps -1 and 1.
+	bool reversed;
+	// 1 to 2 ms, linear.
+	PWMCalibration();
+};
+
+/**
+ * PWM bus traffic since the last PWMDevice::takeStats().
+ */
+struct PWMStats {
+	// Calls to setPositions and the I2C transactions they needed, none when
+	// nothing changed.
+	unsigned long updates, transactions;
+	// Channels written and channels left alone because they hadn't changed.
+	unsigned long channels_written, channels_skipped;
+	// Time spent on the bus, in total and the longest transaction.
+	std::chrono::nanoseconds bus_time, bus_time_max;
+	// Transactions that failed, their channels are written again next time.
+	unsigned long failures;
+};
+
+class PCA9685Sim;
 
 class PWMDevice {
 private:
 	int fd;
-	void setPeriod(unsigned char channel, unsigned short value);
+	// The simulated chip in builds without FSW, NULL with hardware.
+	PCA9685Sim *sim;
+	uint8_t prescale;
+	// Period last written to each channel, 0 before the first.
+	unsigned short periods[PWM_CHANNELS];
+	// Each channel's calibration compiled to periods at PWM_LUT_SIZE + 1
+	// evenly spaced positions, with the last repeated for interpolation.
+	unsigned short luts[PWM_CHANNELS][PWM_LUT_SIZE + 2];
+	PWMStats stats;
+	/**
+	 * Writes the periods in values to count consecutive channels from first
+	 * in one I2C transaction, taking time. Returns false if it failed.
+	 */
+	bool writePeriods(unsigned char first, unsigned char count, const unsigned short *values, std::chrono::nanoseconds &time);
+	/**
+	 * Sets the prescaler for frequency, enables auto increment and calibrates
+	 * every channel with the default.
+	 */
+	void init(float frequency);
+	/**
+	 * Writes length bytes of data, the register address followed by values, to
+	 * the chip in one I2C transaction, taking time. Returns false if it
+	 * failed.
+	 */
+	bool transfer(uint8_t *data, int length, std::chrono::nanoseconds &time);
 public:
-	PWMDevice(const char *path);
+	/**
+	 * @param frequency Pulses a second, from 24 to 1526. Servos take 50, some
+	 * ESCs 400 or more, which outputs new positions sooner.
+	 */
+	PWMDevice(const char *path, float frequency = 50);
 	~PWMDevice();
 
+  /**
+   * The frequency the prescaler gives, the nearest to the one asked for.
+   */
+	float frequency() const;
+  /**
+   * Compiles c into the channel's lookup table.
+   */
+	void calibrate(unsigned char channel, const PWMCalibration &c);
+  /**
+   * Calibrates the channels listed in a text file, a line per channel:
+   * channel min_us center_us max_us trim_us expo reversed
+   * with reversed 0 or 1. Lines starting with # are comments.
+   * @return false if the file can't be read or a line is invalid.
+   */
+	bool loadCalibration(const char *path);
+  /**
+   * The period setPosition writes for position, in 12 bit counts.
+   */
+	unsigned short period(unsigned char channel, float position) const;
+
   /**
    * Controls a channel's position
    * @param channel The channel on the PWM Hat starting at zero.
    * @param position -1 stick left or down. 1 stick right or up.
    */
 	void setPosition(unsigned char channel, float position);
+  /**
+   * Controls count consecutive channels from first in one I2C transaction,
+   * using the PCA9685's register auto increment. Only the channels from the
+   * first changed one to the last changed one are written, and nothing if
+   * none changed.
+   * @return The time spent on the bus.
+   */
+	std::chrono::nanoseconds setPositions(unsigned char first, unsigned char count, const float *positions);
+  /**
+   * Copies and clears the bus traffic stats.
+   */
+	PWMStats takeStats();
 };
 
-#endif
\ No newline at end of file
+#endif
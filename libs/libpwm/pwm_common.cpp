@@ -0,0 +1,154 @@
+#include "pwm.hpp"
+#include "pca9685.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Shared by the real and the simulated PWMDevice, which only differ in
+// construction and transfer.
+
+PWMCalibration::PWMCalibration()
+	: min_us(1000), center_us(1500), max_us(2000), trim_us(0), expo(0), reversed(false) {}
+
+void PWMDevice::init(float frequency) {
+	float p = roundf(PCA9685_OSCILLATOR_HZ / (4096 * frequency)) - 1;
+	prescale = p < 3 ? 3 : p > 255 ? 255 : p;
+	PWMCalibration c;
+	for (int channel = 0; channel < PWM_CHANNELS; channel++) {
+		calibrate(channel, c);
+	}
+	// PRE_SCALE can only be written asleep, and the chip may be awake from
+	// the last run.
+	std::chrono::nanoseconds time;
+	uint8_t sleep[] = {PCA9685_MODE1, PCA9685_MODE1_SLEEP | PCA9685_MODE1_AI};
+	transfer(sleep, sizeof(sleep), time);
+	uint8_t pre_scale[] = {PCA9685_PRE_SCALE, prescale};
+	transfer(pre_scale, sizeof(pre_scale), time);
+	uint8_t wake[] = {PCA9685_MODE1, PCA9685_MODE1_AI};
+	transfer(wake, sizeof(wake), time);
+	// The oscillator takes 500 us to start. Then restart, keeping the outputs,
+	// with register auto increment for setPositions.
+	std::chrono::steady_clock::time_point woken = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - woken < std::chrono::microseconds(500)) {
+	}
+	uint8_t restart[] = {PCA9685_MODE1, PCA9685_MODE1_RESTART | PCA9685_MODE1_AI};
+	transfer(restart, sizeof(restart), time);
+}
+
+float PWMDevice::frequency() const {
+	return (float) PCA9685_OSCILLATOR_HZ / (4096 * (prescale + 1));
+}
+
+void PWMDevice::calibrate(unsigned char channel, const PWMCalibration &c) {
+	if (channel >= PWM_CHANNELS) {
+		return;
+	}
+	// Counts a us.
+	float counts = (float) PCA9685_OSCILLATOR_HZ / (prescale + 1) / 1e6f;
+	for (int i = 0; i <= PWM_LUT_SIZE; i++) {
+		float x = 2.0f * i / PWM_LUT_SIZE - 1;
+		x = c.reversed ? -x : x;
+		x = (1 - c.expo) * x + c.expo * x * x * x;
+		float us = c.center_us + x * (x < 0 ? c.center_us - c.min_us : c.max_us - c.center_us) + c.trim_us;
+		us = us < c.min_us ? c.min_us : us > c.max_us ? c.max_us : us;
+		float period = roundf(us * counts);
+		luts[channel][i] = period < 0 ? 0 : period > 4095 ? 4095 : period;
+	}
+	luts[channel][PWM_LUT_SIZE + 1] = luts[channel][PWM_LUT_SIZE];
+	// Rewrite it on the next update.
+	periods[channel] = 0;
+}
+
+bool PWMDevice::loadCalibration(const char *path) {
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+	char line[256];
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), f)) {
+		int channel, reversed;
+		PWMCalibration c;
+		char first;
+		if (sscanf(line, " %c", &first) < 1 || first == '#') {
+			continue;
+		}
+		ok = sscanf(line, "%d %f %f %f %f %f %d", &channel, &c.min_us, &c.center_us, &c.max_us,
+		            &c.trim_us, &c.expo, &reversed) == 7 && channel >= 0 && channel < PWM_CHANNELS &&
+		     c.min_us <= c.center_us && c.center_us <= c.max_us;
+		if (ok) {
+			c.reversed = reversed;
+			calibrate(channel, c);
+		}
+	}
+	fclose(f);
+	return ok;
+}
+
+unsigned short PWMDevice::period(unsigned char channel, float position) const {
+	// The only float math: the position to 16 bit fixed point, -1 to 0 and 1 to
+	// 65536, which is PWM_LUT_SIZE segments of 256 steps. The comparisons also
+	// catch NaN.
+	int q = position > -1 ? position < 1 ? (int) ((position + 1) * 32768) : 65536 : 0;
+	const unsigned short *lut = luts[channel];
+	int i = q >> 8, fraction = q & 0xff;
+	return lut[i] + (((lut[i + 1] - lut[i]) * fraction + 0x80) >> 8);
+}
+
+// max 2048
+bool PWMDevice::writePeriods(unsigned char first, unsigned char count, const unsigned short *values, std::chrono::nanoseconds &time) {
+	// The register address, then ON_L, ON_H, OFF_L and OFF_H of every channel.
+	// Auto increment steps through them all in one write.
+	uint8_t buf[1 + 4 * PWM_CHANNELS];
+	buf[0] = PCA9685_LED0 + 4 * first;
+	for (int i = 0; i < count; i++) {
+		uint8_t *led = buf + 1 + 4 * i;
+		led[0] = 0;
+		led[1] = 0;
+		led[2] = values[i] & 0x00FF;
+		led[3] = (values[i] >> 8) & 0x000F;
+	}
+	return transfer(buf, 1 + 4 * count, time);
+}
+
+void PWMDevice::setPosition(unsigned char channel, float position) {
+	setPositions(channel, 1, &position);
+}
+
+std::chrono::nanoseconds PWMDevice::setPositions(unsigned char first, unsigned char count, const float *positions) {
+	stats.updates++;
+	unsigned short next[PWM_CHANNELS];
+	int changed_first = -1, changed_last = -1;
+	for (int i = 0; i < count && first + i < PWM_CHANNELS; i++) {
+		next[i] = period(first + i, positions[i]);
+		if (next[i] != periods[first + i]) {
+			changed_first = changed_first < 0 ? i : changed_first;
+			changed_last = i;
+		}
+	}
+	if (changed_first < 0) {
+		stats.channels_skipped += count;
+		return std::chrono::nanoseconds(0);
+	}
+	int written = changed_last - changed_first + 1;
+	std::chrono::nanoseconds time;
+	if (writePeriods(first + changed_first, written, next + changed_first, time)) {
+		memcpy(periods + first + changed_first, next + changed_first, written * sizeof(*next));
+	} else {
+		// The chip may have any of them, rewrite them on the next update.
+		memset(periods + first + changed_first, 0, written * sizeof(*next));
+		stats.failures++;
+	}
+	stats.transactions++;
+	stats.channels_written += written;
+	stats.channels_skipped += count - written;
+	stats.bus_time += time;
+	stats.bus_time_max = time > stats.bus_time_max ? time : stats.bus_time_max;
+	return time;
+}
+
+PWMStats PWMDevice::takeStats() {
+	PWMStats s = stats;
+	stats = PWMStats();
+	return s;
+}
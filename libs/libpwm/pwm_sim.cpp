@@ -0,0 +1,144 @@
+#include "pwm.hpp"
+#include "pca9685.hpp"
+#include "pwm_sim.hpp"
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+PWMDevice::PWMDevice(const char *path, float frequency)
+	: fd(-1), sim(&PCA9685Sim::bus(path)), periods(), stats() {
+	printf("Simulated PCA9685 on %s\n", path);
+	init(frequency);
+}
+
+PWMDevice::~PWMDevice() {
+}
+
+bool PWMDevice::transfer(uint8_t *data, int length, chrono::nanoseconds &time) {
+	time = sim->write(data, length);
+	return true;
+}
+
+PCA9685Sim::PCA9685Sim() : bus_hz(100000), overhead(30), dropped(0), head(0), tail(0) {
+	// Power on state: asleep, the all call address on and 200 Hz.
+	memset(registers, 0, sizeof(registers));
+	registers[PCA9685_MODE1] = PCA9685_MODE1_SLEEP | 0x01;
+	registers[PCA9685_PRE_SCALE] = 0x1e;
+	// Every output full off.
+	for (int c = 0; c < 16; c++) {
+		registers[PCA9685_LED0 + 4 * c + 3] = PCA9685_FULL;
+	}
+}
+
+PCA9685Sim &PCA9685Sim::bus(const char *path) {
+	static mutex lock;
+	static map<string, PCA9685Sim *> chips;
+	lock_guard<mutex> guard(lock);
+	PCA9685Sim *&chip = chips[path];
+	if (!chip) {
+		chip = new PCA9685Sim();
+	}
+	return *chip;
+}
+
+chrono::nanoseconds PCA9685Sim::write(const uint8_t *data, int length) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::nanoseconds time = overhead + chrono::nanoseconds((length + 1) * 9 * 1000000000LL / bus_hz);
+	chrono::steady_clock::time_point done = start + time;
+	uint64_t done_ns = chrono::duration_cast<chrono::nanoseconds>(done.time_since_epoch()).count();
+
+	int reg = length ? data[0] : 0;
+	// A bit per channel written.
+	uint32_t written = 0;
+	for (int i = 1; i < length; i++) {
+		if (reg == PCA9685_PRE_SCALE) {
+			if (registers[PCA9685_MODE1] & PCA9685_MODE1_SLEEP) {
+				registers[reg] = data[i];
+			}
+		} else if (reg == PCA9685_MODE1) {
+			// Writing RESTART clears it.
+			registers[reg] = data[i] & ~PCA9685_MODE1_RESTART;
+		} else {
+			registers[reg] = data[i];
+		}
+		if (reg >= PCA9685_LED0 && reg < PCA9685_LED0 + 64) {
+			written |= 1u << ((reg - PCA9685_LED0) / 4);
+		}
+		if (registers[PCA9685_MODE1] & PCA9685_MODE1_AI) {
+			// Wraps from the last channel back to MODE1.
+			reg = reg == PCA9685_LED0 + 63 ? PCA9685_MODE1 : (reg + 1) & 0xff;
+		}
+	}
+	for (int c = 0; c < 16; c++) {
+		if (written & (1u << c)) {
+			record(done_ns, c);
+		}
+	}
+	this_thread::sleep_until(done);
+	return time;
+}
+
+uint8_t PCA9685Sim::read(uint8_t reg) const {
+	return registers[reg];
+}
+
+float PCA9685Sim::period() const {
+	return 4096.0f * (registers[PCA9685_PRE_SCALE] + 1) / PCA9685_OSCILLATOR_HZ * 1e6f;
+}
+
+float PCA9685Sim::pulseWidth(int channel) const {
+	const uint8_t *led = registers + PCA9685_LED0 + 4 * channel;
+	if (led[3] & PCA9685_FULL) {
+		return 0;
+	}
+	if (led[1] & PCA9685_FULL) {
+		return period();
+	}
+	int on = led[0] | (led[1] & 0x0f) << 8;
+	int off = led[2] | (led[3] & 0x0f) << 8;
+	return ((off - on) & 0xfff) / 4096.0f * period();
+}
+
+void PCA9685Sim::record(uint64_t time, int channel) {
+	unsigned long h = head.load(memory_order_relaxed);
+	if (h - tail.load(memory_order_acquire) == TRACE_SIZE) {
+		dropped++;
+		return;
+	}
+	PWMTraceRecord &r = trace[h % TRACE_SIZE];
+	const uint8_t *led = registers + PCA9685_LED0 + 4 * channel;
+	r.time = time;
+	r.channel = channel;
+	r.on = led[0] | led[1] << 8;
+	r.off = led[2] | led[3] << 8;
+	r.prescale = registers[PCA9685_PRE_SCALE];
+	head.store(h + 1, memory_order_release);
+}
+
+bool PCA9685Sim::takeRecord(PWMTraceRecord &r) {
+	unsigned long t = tail.load(memory_order_relaxed);
+	if (t == head.load(memory_order_acquire)) {
+		return false;
+	}
+	r = trace[t % TRACE_SIZE];
+	tail.store(t + 1, memory_order_release);
+	return true;
+}
+
+bool PCA9685Sim::dumpTrace(const char *path) {
+	FILE *f = fopen(path, "ab");
+	if (!f) {
+		return false;
+	}
+	PWMTraceRecord r;
+	bool ok = true;
+	while (takeRecord(r)) {
+		ok = ok && fwrite(&r, sizeof(r), 1, f) == 1;
+	}
+	return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,84 @@
+#ifndef PWM_SIM_HPP
+#define PWM_SIM_HPP
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+/**
+ * A channel's registers after a write to them, as stored in the trace. The
+ * binary trace is an array of these in host byte order.
+ */
+struct PWMTraceRecord {
+	// steady_clock time the transaction finished and the output changed, in ns.
+	uint64_t time;
+	uint16_t channel;
+	// 12 bit counter values the output turns on and off at, with
+	// PCA9685_FULL set for full on or off.
+	uint16_t on, off;
+	uint16_t prescale;
+};
+
+/**
+ * Register level simulation of a PCA9685 on an I2C bus, which PWMDevice uses
+ * in builds without FSW instead of hardware.
+ *
+ * Writes are applied to the registers as the chip would: the register
+ * pointer steps after every byte only in auto increment mode, and PRE_SCALE
+ * only takes writes while asleep. A transaction blocks its caller for as long
+ * as the real one would take: overhead, for the ioctl and the driver, plus 9
+ * bits a byte, the address included, at bus_hz.
+ *
+ * Every write to a channel's registers is recorded with the time it finished
+ * in a lock-free ring of TRACE_SIZE records, read by one thread while the
+ * thread writing the chip fills it. Records that don't fit are dropped.
+ */
+class PCA9685Sim {
+public:
+	static const int TRACE_SIZE = 65536;
+	unsigned bus_hz;
+	std::chrono::microseconds overhead;
+	// Records dropped because the trace was full.
+	std::atomic<unsigned long> dropped;
+
+	PCA9685Sim();
+	/**
+	 * The chip on the bus at path, created on first use. Configure it before
+	 * opening a PWMDevice on it.
+	 */
+	static PCA9685Sim &bus(const char *path);
+	/**
+	 * One I2C write transaction, the register address followed by values.
+	 * Returns the time it took.
+	 */
+	std::chrono::nanoseconds write(const uint8_t *data, int length);
+	/**
+	 * Reads a register. Only from the writing thread or while nothing writes.
+	 */
+	uint8_t read(uint8_t reg) const;
+	/**
+	 * Output period from PRE_SCALE, in us.
+	 */
+	float period() const;
+	/**
+	 * The channel's pulse width in us, from the registers.
+	 */
+	float pulseWidth(int channel) const;
+	/**
+	 * Copies the oldest record not taken yet to r. Returns false if there is
+	 * none.
+	 */
+	bool takeRecord(PWMTraceRecord &r);
+	/**
+	 * Takes every record and appends them to the file at path. Returns false if
+	 * it couldn't be written.
+	 */
+	bool dumpTrace(const char *path);
+private:
+	uint8_t registers[256];
+	PWMTraceRecord trace[TRACE_SIZE];
+	std::atomic<unsigned long> head, tail;
+	void record(uint64_t time, int channel);
+};
+
+#endif
@@ -0,0 +1,257 @@
+#define _GNU_SOURCE
+#include "task.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Ranges are packed as begin << 32 | end so they change in one compare and
+   swap. */
+#define RANGE(begin, end) ((uint64_t) (uint32_t) (begin) << 32 | (uint32_t) (end))
+#define BEGIN(range) ((int) ((range) >> 32))
+#define END(range) ((int) (uint32_t) (range))
+
+/* Each worker's range on its own cache line, as other threads steal from it. */
+struct task_worker {
+  _Alignas(64) _Atomic uint64_t range;
+  struct task_pool *pool;
+  pthread_t thread;
+  int index;
+  int core;
+};
+
+struct task_pool {
+  int threads;
+  struct task_worker *workers;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  /* Bumped for every job under mutex. Workers join a job while it is open. */
+  unsigned long generation;
+  int open;
+  int stop;
+  task_func func;
+  void *context;
+  /* Items not done yet and workers still inside the job. */
+  _Atomic int remaining;
+  _Atomic int active;
+};
+
+/**
+ * Takes the next item of the worker's own range into index.
+ */
+static int take(struct task_worker *w, int *index) {
+  uint64_t range = atomic_load(&w->range);
+  while (BEGIN(range) < END(range)) {
+    if (atomic_compare_exchange_weak(&w->range, &range,
+                                     RANGE(BEGIN(range) + 1, END(range)))) {
+      *index = BEGIN(range);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Moves the back half of the largest range of another worker to w. Returns 0
+ * when there is nothing left to steal.
+ */
+static int steal(struct task_worker *w) {
+  struct task_pool *pool = w->pool;
+  for (;;) {
+    struct task_worker *victim = NULL;
+    uint64_t largest = 0;
+    int size = 0;
+    for (int i = 1; i < pool->threads; i++) {
+      struct task_worker *v = &pool->workers[(w->index + i) % pool->threads];
+      uint64_t range = atomic_load(&v->range);
+      if (END(range) - BEGIN(range) > size) {
+        victim = v;
+        largest = range;
+        size = END(range) - BEGIN(range);
+      }
+    }
+    if (!victim) {
+      return 0;
+    }
+    /* A single item is stolen whole. */
+    int middle = BEGIN(largest) + size / 2;
+    if (atomic_compare_exchange_strong(&victim->range, &largest,
+                                       RANGE(BEGIN(largest), middle))) {
+      atomic_store(&w->range, RANGE(middle, END(largest)));
+      return 1;
+    }
+  }
+}
+
+static void work(struct task_worker *w) {
+  struct task_pool *pool = w->pool;
+  do {
+    int index;
+    while (take(w, &index)) {
+      pool->func(pool->context, index);
+      atomic_fetch_sub(&pool->remaining, 1);
+    }
+  } while (steal(w));
+}
+
+static void *worker_main(void *arg) {
+  struct task_worker *w = arg;
+  struct task_pool *pool = w->pool;
+  unsigned long seen = 0;
+  if (w->core >= 0) {
+    task_pin(w->core);
+  }
+  for (;;) {
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stop && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    if (pool->stop) {
+      pthread_mutex_unlock(&pool->mutex);
+      return NULL;
+    }
+    seen = pool->generation;
+    int join = pool->open;
+    if (join) {
+      atomic_fetch_add(&pool->active, 1);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (join) {
+      work(w);
+      atomic_fetch_sub(&pool->active, 1);
+    }
+  }
+}
+
+struct task_pool *task_pool_create(int threads, const int *cores) {
+  if (threads < 1) {
+    return NULL;
+  }
+  struct task_pool *pool = calloc(1, sizeof(*pool));
+  if (!pool) {
+    return NULL;
+  }
+  pool->workers = aligned_alloc(64, threads * sizeof(*pool->workers));
+  if (!pool->workers) {
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  for (int i = 0; i < threads; i++) {
+    struct task_worker *w = &pool->workers[i];
+    atomic_init(&w->range, 0);
+    w->pool = pool;
+    w->index = i;
+    w->core = cores ? cores[i] : -1;
+  }
+  if (cores) {
+    task_pin(cores[0]);
+  }
+  pool->threads = 1;
+  for (int i = 1; i < threads; i++) {
+    if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i])) {
+      task_pool_destroy(pool);
+      return NULL;
+    }
+    pool->threads++;
+  }
+  return pool;
+}
+
+void task_pool_destroy(struct task_pool *pool) {
+  if (!pool) {
+    return;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+  for (int i = 1; i < pool->threads; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->wake);
+  free(pool->workers);
+  free(pool);
+}
+
+int task_pool_threads(const struct task_pool *pool) {
+  return pool ? pool->threads : 1;
+}
+
+void task_run(struct task_pool *pool, int count, task_func func, void *context) {
+  if (!pool || pool->threads == 1 || count <= 1) {
+    for (int i = 0; i < count; i++) {
+      func(context, i);
+    }
+    return;
+  }
+  pool->func = func;
+  pool->context = context;
+  atomic_store(&pool->remaining, count);
+  for (int i = 0; i < pool->threads; i++) {
+    atomic_store(&pool->workers[i].range, RANGE((long) count * i / pool->threads,
+                                                (long) count * (i + 1) / pool->threads));
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->generation++;
+  pool->open = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  work(&pool->workers[0]);
+  /* Items other threads took are still running. */
+  while (atomic_load(&pool->remaining) > 0) {
+    sched_yield();
+  }
+  /* Workers late to the job must not see the next job's ranges. */
+  pthread_mutex_lock(&pool->mutex);
+  pool->open = 0;
+  pthread_mutex_unlock(&pool->mutex);
+  while (atomic_load(&pool->active) > 0) {
+    sched_yield();
+  }
+}
+
+struct tiles {
+  int width, height, tile_width, tile_height, columns;
+  task_tile_func func;
+  void *context;
+};
+
+static void run_tile(void *context, int index) {
+  const struct tiles *t = context;
+  int x0 = index % t->columns * t->tile_width;
+  int y0 = index / t->columns * t->tile_height;
+  int x1 = x0 + t->tile_width < t->width ? x0 + t->tile_width : t->width;
+  int y1 = y0 + t->tile_height < t->height ? y0 + t->tile_height : t->height;
+  t->func(t->context, x0, y0, x1, y1);
+}
+
+void task_run_tiles(struct task_pool *pool, int width, int height, int tile_width,
+                    int tile_height, task_tile_func func, void *context) {
+  struct tiles t = {width, height, tile_width, tile_height,
+                    (width + tile_width - 1) / tile_width, func, context};
+  int rows = (height + tile_height - 1) / tile_height;
+  task_run(pool, t.columns * rows, run_tile, &t);
+}
+
+int task_tile_rows(int width, size_t pixel_size) {
+  size_t rows = TASK_TILE_BYTES / (width * pixel_size);
+  return rows ? (int) rows : 1;
+}
+
+int task_pin(int core) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) ? -1 : 0;
+#else
+  (void) core;
+  return -1;
+#endif
+}
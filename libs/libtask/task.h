@@ -0,0 +1,89 @@
+#ifndef TASK_H
+#define TASK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * Bytes of input a tile should hold so a tile's input and output stay in L1
+ * cache while it is worked on.
+ */
+#define TASK_TILE_BYTES 16384
+
+/**
+ * Work-stealing pool of threads that runs the items of a job in parallel.
+ *
+ * A job is count items run by one function. Each thread starts with an even
+ * share of the items as a range and takes them from the front one at a time.
+ * A thread that runs out steals the back half of the largest remaining range
+ * of another thread, so a slow tile or a preempted thread doesn't hold up the
+ * job. Taking and stealing are a compare and swap on the range; threads only
+ * meet on a lock to be woken for a new job.
+ *
+ * The thread that calls task_run takes part, so a pool of n threads starts
+ * n - 1 workers. Waking the workers takes tens of microseconds, so give them
+ * jobs of at least that much work, e.g. a 640x480 frame rather than a Lepton
+ * frame. Kernels take a NULL pool to run on the calling thread alone.
+ */
+struct task_pool;
+
+/**
+ * Runs item index of a job.
+ */
+typedef void (*task_func)(void *context, int index);
+
+/**
+ * Runs the tile of a frame from (x0, y0) up to but not including (x1, y1).
+ */
+typedef void (*task_tile_func)(void *context, int x0, int y0, int x1, int y1);
+
+/**
+ * Starts a pool of threads threads, including the calling thread. If cores
+ * isn't NULL thread i is pinned to core cores[i], cores[0] being the calling
+ * thread. Returns NULL if the threads can't be started.
+ */
+struct task_pool *task_pool_create(int threads, const int *cores);
+
+/**
+ * Stops the workers and frees pool. pool may be NULL.
+ */
+void task_pool_destroy(struct task_pool *pool);
+
+/**
+ * Number of threads running jobs, 1 for a NULL pool.
+ */
+int task_pool_threads(const struct task_pool *pool);
+
+/**
+ * Runs func for items 0 to count - 1 in any order and returns when they are
+ * all done. Only one thread may call task_run on a pool at a time.
+ */
+void task_run(struct task_pool *pool, int count, task_func func, void *context);
+
+/**
+ * Splits a width by height frame into tile_width by tile_height tiles, the
+ * last ones smaller, and runs func on each with task_run.
+ */
+void task_run_tiles(struct task_pool *pool, int width, int height, int tile_width,
+                    int tile_height, task_tile_func func, void *context);
+
+/**
+ * Rows of a width pixel wide frame of pixel_size byte pixels that fit in
+ * TASK_TILE_BYTES, at least 1. Full width tiles are contiguous in memory.
+ */
+int task_tile_rows(int width, size_t pixel_size);
+
+/**
+ * Pins the calling thread to core. Returns 0 on success, -1 on failure or
+ * where pinning isn't supported.
+ */
+int task_pin(int core);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#include "task.h"
+
+/* Runs every job on the calling thread, for platforms without pthreads. */
+
+struct task_pool *task_pool_create(int threads, const int *cores) {
+  (void) threads;
+  (void) cores;
+  return NULL;
+}
+
+void task_pool_destroy(struct task_pool *pool) {
+  (void) pool;
+}
+
+int task_pool_threads(const struct task_pool *pool) {
+  (void) pool;
+  return 1;
+}
+
+void task_run(struct task_pool *pool, int count, task_func func, void *context) {
+  (void) pool;
+  for (int i = 0; i < count; i++) {
+    func(context, i);
+  }
+}
+
+void task_run_tiles(struct task_pool *pool, int width, int height, int tile_width,
+                    int tile_height, task_tile_func func, void *context) {
+  (void) pool;
+  for (int y = 0; y < height; y += tile_height) {
+    for (int x = 0; x < width; x += tile_width) {
+      func(context, x, y, x + tile_width < width ? x + tile_width : width,
+           y + tile_height < height ? y + tile_height : height);
+    }
+  }
+}
+
+int task_tile_rows(int width, size_t pixel_size) {
+  size_t rows = TASK_TILE_BYTES / (width * pixel_size);
+  return rows ? (int) rows : 1;
+}
+
+int task_pin(int core) {
+  (void) core;
+  return -1;
+}
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PACKET 65536
+/* Packets held back by the delay at once, in both directions. */
+#define MAX_HELD 4096
+
+struct settings {
+  /* Probability a packet is lost. */
+  double loss;
+  /* Delay added to every packet and the most random delay added on top, in
+     ms. Jitter reorders packets sent closer together than it. */
+  double delay, jitter;
+  /* The link is down for outage ms every interval ms. */
+  double outage, interval;
+};
+
+struct held {
+  double due;
+  /* 0 from the GSE to fsw, 1 back. */
+  int direction;
+  int length;
+  char *data;
+};
+
+static double now_ms() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s <port> <fsw_host> <fsw_port> [--loss fraction] [--delay ms] [--jitter ms]"
+         " [--outage ms interval_ms] [--seed n]\n", name);
+}
+
+/**
+ * Whether the link is down at t, in ms since start, and prints when it goes
+ * down or comes back.
+ */
+static int link_down(const struct settings *s, double t, int *was_down) {
+  int down = s->outage > 0 && s->interval > 0 && t >= s->interval &&
+             (t - s->interval) - s->interval * (long) ((t - s->interval) / s->interval) < s->outage;
+  if (down != *was_down) {
+    printf("%10.1f ms link %s\n", t, down ? "down" : "up");
+    fflush(stdout);
+    *was_down = down;
+  }
+  return down;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+  struct settings s = {0, 0, 0, 0, 0};
+  unsigned seed = 1;
+  for (int i = 4; i < argc; i++) {
+    if (!strcmp(argv[i], "--loss") && i + 1 < argc) {
+      s.loss = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--delay") && i + 1 < argc) {
+      s.delay = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter") && i + 1 < argc) {
+      s.jitter = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--outage") && i + 2 < argc) {
+      s.outage = atof(argv[++i]);
+      s.interval = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  srand(seed);
+
+  /* The GSE sends to us instead of fsw. */
+  int gse_socket = socket(AF_INET6, SOCK_DGRAM, 0);
+  int off = 0;
+  setsockopt(gse_socket, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+  struct sockaddr_in6 local;
+  memset(&local, 0, sizeof(local));
+  local.sin6_family = AF_INET6;
+  local.sin6_addr = in6addr_any;
+  local.sin6_port = htons(atoi(argv[1]));
+  if (gse_socket < 0 || bind(gse_socket, (struct sockaddr *) &local, sizeof(local))) {
+    perror("Could not listen");
+    return 1;
+  }
+  struct addrinfo hints, *fsw;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(argv[2], argv[3], &hints, &fsw)) {
+    printf("Could not resolve %s\n", argv[2]);
+    return 1;
+  }
+  int fsw_socket = socket(fsw->ai_family, SOCK_DGRAM, 0);
+  if (fsw_socket < 0 || connect(fsw_socket, fsw->ai_addr, fsw->ai_addrlen)) {
+    perror("Could not connect to fsw");
+    return 1;
+  }
+  freeaddrinfo(fsw);
+
+  struct sockaddr_storage gse;
+  socklen_t gse_length = 0;
+  static struct held held[MAX_HELD];
+  int held_count = 0;
+  static char buffer[MAX_PACKET];
+  long forwarded[2] = {0, 0}, dropped[2] = {0, 0};
+  int was_down = 0;
+  double start = now_ms();
+  for (;;) {
+    /* Sleep until a packet arrives or the next held one is due. */
+    double t = now_ms() - start;
+    double next = -1;
+    for (int i = 0; i < held_count; i++) {
+      next = next < 0 || held[i].due < next ? held[i].due : next;
+    }
+    struct pollfd fds[2] = {{gse_socket, POLLIN, 0}, {fsw_socket, POLLIN, 0}};
+    int timeout = next < 0 ? 100 : next > t ? (int) (next - t) + 1 : 0;
+    if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+      perror("poll");
+      return 1;
+    }
+    t = now_ms() - start;
+    int down = link_down(&s, t, &was_down);
+    for (int direction = 0; direction < 2; direction++) {
+      if (!(fds[direction].revents & POLLIN)) {
+        continue;
+      }
+      int length;
+      if (direction == 0) {
+        gse_length = sizeof(gse);
+        length = recvfrom(gse_socket, buffer, sizeof(buffer), 0, (struct sockaddr *) &gse,
+                          &gse_length);
+      } else {
+        length = recv(fsw_socket, buffer, sizeof(buffer), 0);
+      }
+      if (length < 0) {
+        continue;
+      }
+      if (down || rand() < s.loss * ((double) RAND_MAX + 1) || held_count == MAX_HELD) {
+        dropped[direction]++;
+        continue;
+      }
+      struct held *h = &held[held_count++];
+      h->due = t + s.delay + s.jitter * rand() / ((double) RAND_MAX + 1);
+      h->direction = direction;
+      h->length = length;
+      h->data = malloc(length);
+      memcpy(h->data, buffer, length);
+    }
+    /* Forward the packets that are due, removing them by swapping in the last. */
+    for (int i = 0; i < held_count;) {
+      struct held *h = &held[i];
+      if (h->due > t) {
+        i++;
+        continue;
+      }
+      if (h->direction == 0) {
+        send(fsw_socket, h->data, h->length, 0);
+      } else if (gse_length) {
+        sendto(gse_socket, h->data, h->length, 0, (struct sockaddr *) &gse, gse_length);
+      }
+      forwarded[h->direction]++;
+      free(h->data);
+      *h = held[--held_count];
+    }
+    static double last_report = 0;
+    if (t - last_report >= 10000) {
+      printf("%10.1f ms to fsw %ld forwarded %ld dropped, to GSE %ld forwarded %ld dropped\n", t,
+             forwarded[0], dropped[0], forwarded[1], dropped[1]);
+      fflush(stdout);
+      last_report = t;
+    }
+  }
+}
@@ -0,0 +1,530 @@
+#include "pt1.h"
+#include "pt1_color.h"
+#include "pt1_agc.h"
+#include "png.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_SIZE (PT1_WIDTH * PT1_HEIGHT * sizeof(uint16_t))
+
+/* Frames given to a worker at a time. */
+#define CHUNK_FRAMES 128
+
+/* Frames run through the gain control before a chunk so its smoothing has
+   settled by the first exported frame. */
+#define AGC_WARMUP 32
+
+enum format {
+  FORMAT_NONE,
+  FORMAT_PNG,
+  FORMAT_Y4M,
+  FORMAT_RAW
+};
+
+/**
+ * Statistics of one frame for the CSV file.
+ */
+struct frame_stats {
+  uint16_t min, max, median;
+  float mean, stddev;
+};
+
+/**
+ * A recording being exported.
+ */
+struct recording {
+  const char *path;
+  char name[PATH_MAX];
+  int fd;
+  /* y4m or raw video */
+  int video_fd;
+  long first, count;
+  struct frame_stats *stats;
+};
+
+/**
+ * Frames first to first + count - 1 of a recording.
+ */
+struct job {
+  struct recording *recording;
+  long first, count;
+};
+
+/**
+ * Settings shared by all workers.
+ */
+struct options {
+  const char *output_dir;
+  enum format format;
+  enum pt1_palette palette;
+  int fixed_range;
+  uint16_t low, high;
+  int agc_mode;
+  int scale;
+  int csv;
+  int threads;
+  int quiet;
+};
+
+static struct options options = {
+  .output_dir = ".",
+  .format = FORMAT_PNG,
+  .palette = PT1_PALETTE_IRONBOW,
+  .agc_mode = -1,
+  .scale = 1,
+};
+
+static struct job *jobs;
+static long num_jobs;
+static long next_job;
+static long frames_done;
+static int failed;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled whenever a job finishes so progress can be reported. */
+static pthread_cond_t progress = PTHREAD_COND_INITIALIZER;
+
+/**
+ * State owned by one worker thread.
+ */
+struct worker {
+  pthread_t thread;
+  struct pt1_colormap colormap;
+  struct pt1_agc agc;
+  uint8_t rgb[PT1_HEIGHT][PT1_WIDTH][3];
+  uint8_t *scaled;
+  uint8_t *video_frame;
+};
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static size_t video_frame_size() {
+  size_t pixels = (size_t) PT1_WIDTH * PT1_HEIGHT * options.scale * options.scale;
+  /* y4m frames start with "FRAME\n" */
+  return options.format == FORMAT_Y4M ? 6 + pixels * 3 : pixels * 3;
+}
+
+/**
+ * Writes the video file header to header and returns its length.
+ */
+static size_t video_header(char header[64]) {
+  if (options.format != FORMAT_Y4M) {
+    return 0;
+  }
+  /* Lepton runs at 8.6 frames per second */
+  return snprintf(header, 64, "YUV4MPEG2 W%d H%d F43:5 Ip A1:1 C444\n",
+                  PT1_WIDTH * options.scale, PT1_HEIGHT * options.scale);
+}
+
+static void fail(const char *what, const char *path) {
+  pthread_mutex_lock(&lock);
+  fprintf(stderr, "\n%s %s: %s\n", what, path, strerror(errno));
+  failed = 1;
+  pthread_cond_signal(&progress);
+  pthread_mutex_unlock(&lock);
+}
+
+static void compute_stats(const struct pt1_agc *agc, struct frame_stats *stats) {
+  double sum = 0, sum_squares = 0;
+  uint64_t count = 0, median_count = 0;
+  for (int v = agc->low; v <= agc->high; v++) {
+    count += agc->histogram[v];
+    sum += (double) v * agc->histogram[v];
+    sum_squares += (double) v * v * agc->histogram[v];
+  }
+  stats->min = agc->low;
+  stats->max = agc->high;
+  stats->mean = sum / count;
+  stats->stddev = sqrt(sum_squares / count - stats->mean * (double) stats->mean);
+  stats->median = agc->high;
+  for (int v = agc->low; v <= agc->high; v++) {
+    median_count += agc->histogram[v];
+    if (median_count * 2 >= count) {
+      stats->median = v;
+      break;
+    }
+  }
+}
+
+/**
+ * Nearest neighbor upscaling of the worker's rgb frame by options.scale.
+ */
+static const uint8_t *scaled_rgb(struct worker *w) {
+  int scale = options.scale;
+  if (scale == 1) {
+    return &w->rgb[0][0][0];
+  }
+  uint8_t *out = w->scaled;
+  for (int y = 0; y < PT1_HEIGHT * scale; y++) {
+    for (int x = 0; x < PT1_WIDTH * scale; x++) {
+      memcpy(out, w->rgb[y / scale][x / scale], 3);
+      out += 3;
+    }
+  }
+  return w->scaled;
+}
+
+/**
+ * Converts RGB24 to planar BT.601 YCbCr for y4m.
+ */
+static void rgb_to_yuv444(const uint8_t *rgb, size_t pixels, uint8_t *yuv) {
+  uint8_t *y = yuv, *u = yuv + pixels, *v = yuv + 2 * pixels;
+  for (size_t i = 0; i < pixels; i++) {
+    int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+    y[i] = (66 * r + 129 * g + 25 * b + 128 + (16 << 8)) >> 8;
+    u[i] = (-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8;
+    v[i] = (112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8;
+  }
+}
+
+static void write_frame(struct worker *w, struct recording *r, long frame) {
+  const uint8_t *rgb = scaled_rgb(w);
+  size_t pixels = (size_t) PT1_WIDTH * PT1_HEIGHT * options.scale * options.scale;
+  if (options.format == FORMAT_PNG) {
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%s_%06ld.png", options.output_dir, r->name, frame);
+    if (png_write_rgb(path, rgb, PT1_WIDTH * options.scale, PT1_HEIGHT * options.scale)) {
+      fail("Couldn't write", path);
+    }
+  } else if (options.format == FORMAT_Y4M || options.format == FORMAT_RAW) {
+    const void *data = rgb;
+    if (options.format == FORMAT_Y4M) {
+      memcpy(w->video_frame, "FRAME\n", 6);
+      rgb_to_yuv444(rgb, pixels, w->video_frame + 6);
+      data = w->video_frame;
+    }
+    /* Every frame has the same size so workers write their frames in place
+       without waiting for each other. */
+    char header[64];
+    off_t offset = video_header(header) + (off_t) (frame - r->first) * video_frame_size();
+    if (pwrite(r->video_fd, data, video_frame_size(), offset) != (ssize_t) video_frame_size()) {
+      fail("Couldn't write video for", r->path);
+    }
+  }
+}
+
+static void run_job(struct worker *w, const struct job *job) {
+  struct recording *r = job->recording;
+  uint16_t y16[PT1_HEIGHT][PT1_WIDTH];
+  uint8_t y8[PT1_HEIGHT][PT1_WIDTH];
+  long start = job->first;
+  if (options.agc_mode >= 0) {
+    pt1_agc_init(&w->agc, options.agc_mode);
+    start = job->first - AGC_WARMUP < r->first ? r->first : job->first - AGC_WARMUP;
+  }
+  for (long frame = start; frame < job->first + job->count; frame++) {
+    if (pread(r->fd, y16, FRAME_SIZE, (off_t) frame * FRAME_SIZE) != (ssize_t) FRAME_SIZE) {
+      fail("Couldn't read", r->path);
+      return;
+    }
+    if (options.agc_mode >= 0) {
+      pt1_agc_process(&w->agc, &y16[0][0], PT1_WIDTH, PT1_HEIGHT, &y8[0][0]);
+      if (frame < job->first) {
+        continue;
+      }
+      pt1_colorize_8bit(&w->colormap, &y8[0][0], PT1_WIDTH * PT1_HEIGHT, &w->rgb[0][0][0]);
+    } else {
+      if (!options.fixed_range || options.csv) {
+        pt1_agc_histogram(&w->agc, &y16[0][0], PT1_WIDTH * PT1_HEIGHT);
+      }
+      uint16_t low = options.fixed_range ? options.low : w->agc.low;
+      uint16_t high = options.fixed_range ? options.high : w->agc.high;
+      pt1_colorize(&w->colormap, &y16[0][0], PT1_WIDTH * PT1_HEIGHT, low, high, &w->rgb[0][0][0]);
+    }
+    if (options.csv) {
+      compute_stats(&w->agc, &r->stats[frame - r->first]);
+    }
+    write_frame(w, r, frame);
+  }
+  pthread_mutex_lock(&lock);
+  frames_done += job->count;
+  pthread_cond_signal(&progress);
+  pthread_mutex_unlock(&lock);
+}
+
+static void *worker_main(void *arg) {
+  struct worker *w = arg;
+  while (1) {
+    pthread_mutex_lock(&lock);
+    long j = next_job++;
+    int stop = failed;
+    pthread_mutex_unlock(&lock);
+    if (j >= num_jobs || stop) {
+      return NULL;
+    }
+    run_job(w, &jobs[j]);
+  }
+}
+
+static int write_csv(const struct recording *r) {
+  char path[PATH_MAX + 32];
+  snprintf(path, sizeof(path), "%s/%s.csv", options.output_dir, r->name);
+  FILE *fd = fopen(path, "w");
+  if (!fd) {
+    fail("Couldn't open", path);
+    return -1;
+  }
+  fprintf(fd, "frame,min,max,mean,stddev,median\n");
+  for (long i = 0; i < r->count; i++) {
+    const struct frame_stats *s = &r->stats[i];
+    fprintf(fd, "%ld,%u,%u,%.2f,%.2f,%u\n", r->first + i, s->min, s->max, s->mean, s->stddev,
+            s->median);
+  }
+  return fclose(fd);
+}
+
+/**
+ * Opens a recording and its outputs and limits the frame range to its length.
+ */
+static int open_recording(struct recording *r, long first, long count) {
+  struct stat st;
+  r->video_fd = -1;
+  if ((r->fd = open(r->path, O_RDONLY)) < 0 || fstat(r->fd, &st)) {
+    fail("Couldn't open", r->path);
+    return -1;
+  }
+  long frames = st.st_size / FRAME_SIZE;
+  r->first = first < frames ? first : frames;
+  r->count = frames - r->first;
+  if (count >= 0 && count < r->count) {
+    r->count = count;
+  }
+
+  /* name is the file name without directories or extension */
+  const char *base = strrchr(r->path, '/');
+  snprintf(r->name, sizeof(r->name), "%s", base ? base + 1 : r->path);
+  char *dot = strrchr(r->name, '.');
+  if (dot && dot != r->name) {
+    *dot = '\0';
+  }
+
+  if (options.format == FORMAT_Y4M || options.format == FORMAT_RAW) {
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%s.%s", options.output_dir, r->name,
+             options.format == FORMAT_Y4M ? "y4m" : "rgb");
+    if ((r->video_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+      fail("Couldn't open", path);
+      return -1;
+    }
+    char header[64];
+    size_t header_size = video_header(header);
+    if (header_size && write(r->video_fd, header, header_size) != (ssize_t) header_size) {
+      fail("Couldn't write", path);
+      return -1;
+    }
+  }
+  if (options.csv) {
+    r->stats = calloc(r->count ? r->count : 1, sizeof(*r->stats));
+  }
+  return 0;
+}
+
+static void usage(const char *name) {
+  printf(
+    "Exports recordings made by pt1cap to images, video and statistics.\n"\
+    "\n"\
+    "Usage: %s [options] <filename>...\n"\
+    "\t-o dir      output directory, defaults to the current directory\n"\
+    "\t-f format   png (one file per frame), y4m, raw (RGB24) or none\n"\
+    "\t-p palette  grayscale, white-hot, black-hot, ironbow (default) or rainbow\n"\
+    "\t-r low:high fixed range, defaults to each frame's smallest and largest pixel\n"\
+    "\t-g mode     automatic gain control: linear, equalize or clahe\n"\
+    "\t-s first    first frame of each file to export, defaults to 0\n"\
+    "\t-n count    number of frames of each file to export, defaults to all\n"\
+    "\t-z scale    enlarge frames by an integer factor\n"\
+    "\t-c          write per frame statistics to <name>.csv\n"\
+    "\t-j threads  defaults to the number of processors\n"\
+    "\t-q          don't show progress\n"\
+    "\n"\
+    "Example: %s -f y4m -g linear -z 4 -c capture.bin\n"\
+    "\tWrites capture.y4m and capture.csv\n"\
+    "\n"\
+  , name, name);
+}
+
+int main(int argc, char* argv[]) {
+  long first = 0;
+  long count = -1;
+  int opt;
+  options.threads = sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(argc, argv, "o:f:p:r:g:s:n:z:cj:qh")) != -1) {
+    switch (opt) {
+    case 'o':
+      options.output_dir = optarg;
+      break;
+    case 'f':
+      if (!strcmp(optarg, "png")) {
+        options.format = FORMAT_PNG;
+      } else if (!strcmp(optarg, "y4m")) {
+        options.format = FORMAT_Y4M;
+      } else if (!strcmp(optarg, "raw")) {
+        options.format = FORMAT_RAW;
+      } else if (!strcmp(optarg, "none")) {
+        options.format = FORMAT_NONE;
+      } else {
+        fprintf(stderr, "Unknown format %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'p':
+      options.palette = PT1_PALETTE_COUNT;
+      for (int p = 0; p < PT1_PALETTE_COUNT; p++) {
+        if (!strcmp(optarg, pt1_palette_name(p))) {
+          options.palette = p;
+        }
+      }
+      if (options.palette == PT1_PALETTE_COUNT) {
+        fprintf(stderr, "Unknown palette %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'r': {
+      unsigned low, high;
+      if (sscanf(optarg, "%u:%u", &low, &high) != 2 || low >= high) {
+        fprintf(stderr, "Range must be low:high\n");
+        return -1;
+      }
+      options.fixed_range = 1;
+      options.low = low;
+      options.high = high;
+      break;
+    }
+    case 'g':
+      for (int m = 0; m < PT1_AGC_MODE_COUNT; m++) {
+        if (!strcmp(optarg, pt1_agc_mode_name(m))) {
+          options.agc_mode = m;
+        }
+      }
+      if (options.agc_mode < 0) {
+        fprintf(stderr, "Unknown gain control mode %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 's':
+      first = atol(optarg);
+      break;
+    case 'n':
+      count = atol(optarg);
+      break;
+    case 'z':
+      options.scale = atoi(optarg);
+      break;
+    case 'c':
+      options.csv = 1;
+      break;
+    case 'j':
+      options.threads = atoi(optarg);
+      break;
+    case 'q':
+      options.quiet = 1;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind >= argc || options.scale < 1 || options.threads < 1 || first < 0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  int num_recordings = argc - optind;
+  struct recording *recordings = calloc(num_recordings, sizeof(*recordings));
+  long total_frames = 0;
+  for (int i = 0; i < num_recordings; i++) {
+    recordings[i].path = argv[optind + i];
+    if (open_recording(&recordings[i], first, count)) {
+      return -1;
+    }
+    total_frames += recordings[i].count;
+    num_jobs += (recordings[i].count + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+  }
+
+  /* Files are split into chunks so a single long recording still uses every thread. */
+  jobs = calloc(num_jobs ? num_jobs : 1, sizeof(*jobs));
+  long j = 0;
+  for (int i = 0; i < num_recordings; i++) {
+    struct recording *r = &recordings[i];
+    for (long f = 0; f < r->count; f += CHUNK_FRAMES) {
+      jobs[j].recording = r;
+      jobs[j].first = r->first + f;
+      jobs[j].count = r->count - f < CHUNK_FRAMES ? r->count - f : CHUNK_FRAMES;
+      j++;
+    }
+  }
+
+  if (options.threads > num_jobs) {
+    options.threads = num_jobs ? num_jobs : 1;
+  }
+  struct worker *workers = calloc(options.threads, sizeof(*workers));
+  double start = now();
+  for (int i = 0; i < options.threads; i++) {
+    struct worker *w = &workers[i];
+    pt1_colormap_init(&w->colormap, options.palette);
+    pt1_agc_init(&w->agc, options.agc_mode >= 0 ? options.agc_mode : PT1_AGC_LINEAR);
+    w->scaled = malloc((size_t) PT1_WIDTH * PT1_HEIGHT * 3 * options.scale * options.scale);
+    w->video_frame = malloc(video_frame_size());
+    pthread_create(&w->thread, NULL, worker_main, w);
+  }
+
+  /* Report progress at most every quarter second until every frame is done. */
+  pthread_mutex_lock(&lock);
+  double last_report = 0;
+  while (frames_done < total_frames && !failed) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 250000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&progress, &lock, &deadline);
+    double elapsed = now() - start;
+    if (!options.quiet && elapsed - last_report >= 0.25) {
+      fprintf(stderr, "\r%ld/%ld frames %.0f frames/s", frames_done, total_frames,
+              frames_done / elapsed);
+      last_report = elapsed;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  if (!options.quiet && last_report > 0) {
+    fprintf(stderr, "\n");
+  }
+  for (int i = 0; i < options.threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    free(workers[i].scaled);
+    free(workers[i].video_frame);
+  }
+  double elapsed = now() - start;
+
+  for (int i = 0; i < num_recordings; i++) {
+    struct recording *r = &recordings[i];
+    if (options.csv && !failed) {
+      write_csv(r);
+    }
+    close(r->fd);
+    if (r->video_fd >= 0 && close(r->video_fd)) {
+      fail("Couldn't write video for", r->path);
+    }
+    free(r->stats);
+  }
+  printf("Exported %ld frames from %d files in %.2f s (%.0f frames/s, %d threads)\n",
+         frames_done, num_recordings, elapsed, elapsed > 0 ? frames_done / elapsed : 0,
+         options.threads);
+  free(workers);
+  free(jobs);
+  free(recordings);
+  return failed ? -1 : 0;
+}
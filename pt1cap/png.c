@@ -0,0 +1,126 @@
+#include "png.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest deflate stored block */
+#define STORED_MAX 0xFFFF
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void make_crc_table() {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    crc_table[n] = c;
+  }
+}
+
+static uint32_t crc(uint32_t c, const uint8_t *data, size_t length) {
+  c = ~c;
+  for (size_t i = 0; i < length; i++) {
+    c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  }
+  return ~c;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/**
+ * Writes a chunk with length, type, data and crc.
+ */
+static int write_chunk(FILE *fd, const char *type, const uint8_t *data, uint32_t length) {
+  uint8_t header[8];
+  put32(header, length);
+  memcpy(header + 4, type, 4);
+  uint8_t footer[4];
+  put32(footer, crc(crc(0, header + 4, 4), data, length));
+  if (fwrite(header, sizeof(header), 1, fd) != 1 ||
+      (length && fwrite(data, length, 1, fd) != 1) ||
+      fwrite(footer, sizeof(footer), 1, fd) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
+int png_write_rgb(const char *filename, const uint8_t *rgb, int width, int height) {
+  pthread_once(&crc_once, make_crc_table);
+
+  /* Scanlines each start with filter type 0 (none). */
+  size_t stride = (size_t) width * 3 + 1;
+  size_t raw_length = stride * height;
+  size_t blocks = raw_length / STORED_MAX + 1;
+  /* zlib header, stored blocks with 5 byte headers and adler32 */
+  size_t idat_length = 2 + raw_length + blocks * 5 + 4;
+  uint8_t *idat = malloc(idat_length);
+  if (!idat) {
+    return -1;
+  }
+
+  uint8_t *p = idat;
+  *p++ = 0x78;
+  *p++ = 0x01;
+  uint32_t a = 1, b = 0;
+  size_t row = 0, column = 0;
+  size_t remaining = raw_length;
+  while (1) {
+    size_t n = remaining < STORED_MAX ? remaining : STORED_MAX;
+    remaining -= n;
+    *p++ = remaining ? 0 : 1;
+    *p++ = n;
+    *p++ = n >> 8;
+    *p++ = ~n;
+    *p++ = ~n >> 8;
+    for (size_t i = 0; i < n; i++) {
+      uint8_t v = column ? rgb[row * (stride - 1) + column - 1] : 0;
+      if (++column == stride) {
+        column = 0;
+        row++;
+      }
+      *p++ = v;
+      a = (a + v) % 65521;
+      b = (b + a) % 65521;
+    }
+    if (!remaining) {
+      break;
+    }
+  }
+  put32(p, (b << 16) | a);
+  p += 4;
+
+  uint8_t ihdr[13];
+  put32(ihdr, width);
+  put32(ihdr + 4, height);
+  ihdr[8] = 8;  /* bit depth */
+  ihdr[9] = 2;  /* RGB */
+  ihdr[10] = 0; /* deflate */
+  ihdr[11] = 0; /* adaptive filtering */
+  ihdr[12] = 0; /* no interlace */
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  int result = -1;
+  FILE *fd = fopen(filename, "wb");
+  if (fd) {
+    if (fwrite(signature, sizeof(signature), 1, fd) == 1 &&
+        !write_chunk(fd, "IHDR", ihdr, sizeof(ihdr)) &&
+        !write_chunk(fd, "IDAT", idat, p - idat) &&
+        !write_chunk(fd, "IEND", NULL, 0)) {
+      result = 0;
+    }
+    if (fclose(fd)) {
+      result = -1;
+    }
+  }
+  free(idat);
+  return result;
+}
@@ -0,0 +1,12 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdint.h>
+
+/**
+ * Writes a width by height RGB24 image to filename as an uncompressed PNG.
+ * Returns 0 on success and -1 on failure with errno set.
+ */
+int png_write_rgb(const char *filename, const uint8_t *rgb, int width, int height);
+
+#endif
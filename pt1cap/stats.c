@@ -0,0 +1,331 @@
+#include "pt1.h"
+#include "pt1_stats.h"
+#include "pt1_badpix.h"
+#include "pt1_nuc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_SIZE (PT1_WIDTH * PT1_HEIGHT * sizeof(uint16_t))
+
+/* Frames given to a worker at a time. */
+#define CHUNK_FRAMES 256
+
+/**
+ * A recording and the index of its first frame in the whole sequence.
+ */
+struct recording {
+  const char *path;
+  int fd;
+  long frames;
+  long offset;
+};
+
+/**
+ * Frames first to first + count - 1 of a recording.
+ */
+struct job {
+  struct recording *recording;
+  long first, count;
+};
+
+/**
+ * State owned by one worker thread.
+ */
+struct worker {
+  pthread_t thread;
+  struct pt1_pixel_stats stats;
+};
+
+static struct job *jobs;
+static long num_jobs;
+static long next_job;
+static int failed;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void *worker_main(void *arg) {
+  struct worker *w = arg;
+  uint16_t frame[PT1_HEIGHT][PT1_WIDTH];
+  while (1) {
+    pthread_mutex_lock(&lock);
+    long j = next_job++;
+    int stop = failed;
+    pthread_mutex_unlock(&lock);
+    if (j >= num_jobs || stop) {
+      return NULL;
+    }
+    const struct job *job = &jobs[j];
+    struct recording *r = job->recording;
+    for (long f = job->first; f < job->first + job->count; f++) {
+      if (pread(r->fd, frame, FRAME_SIZE, (off_t) f * FRAME_SIZE) != (ssize_t) FRAME_SIZE) {
+        pthread_mutex_lock(&lock);
+        fprintf(stderr, "Couldn't read %s: %s\n", r->path, strerror(errno));
+        failed = 1;
+        pthread_mutex_unlock(&lock);
+        return NULL;
+      }
+      pt1_pixel_stats_add(&w->stats, &frame[0][0], r->offset + f);
+    }
+  }
+}
+
+static int compare_floats(const void *a, const void *b) {
+  float x = *(const float *) a, y = *(const float *) b;
+  return (x > y) - (x < y);
+}
+
+static float median(float *values, int count) {
+  qsort(values, count, sizeof(*values), compare_floats);
+  return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/**
+ * Flags stuck pixels (no change over the recording), dead pixels (mean far
+ * from the median of the 3x3 neighborhood compared to how far the other
+ * pixels are) and noisy pixels (standard deviation above noisy times the
+ * median standard deviation).
+ */
+static void find_bad_pixels(const struct pt1_pixel_stats *stats, const float *mean,
+                            const float *stddev, float dead, float noisy,
+                            struct pt1_bad_pixels *map) {
+  static float deviation[PT1_PIXELS];
+  static float sorted[PT1_PIXELS];
+  pt1_bad_pixels_clear(map);
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      float neighbors[8];
+      int n = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          int nx = x + dx, ny = y + dy;
+          if ((dx || dy) && nx >= 0 && nx < PT1_WIDTH && ny >= 0 && ny < PT1_HEIGHT) {
+            neighbors[n++] = mean[ny * PT1_WIDTH + nx];
+          }
+        }
+      }
+      deviation[y * PT1_WIDTH + x] = fabsf(mean[y * PT1_WIDTH + x] - median(neighbors, n));
+    }
+  }
+  memcpy(sorted, deviation, sizeof(sorted));
+  /* At least one count so a perfectly uniform scene doesn't flag everything. */
+  float typical_deviation = median(sorted, PT1_PIXELS);
+  typical_deviation = typical_deviation < 1 ? 1 : typical_deviation;
+  memcpy(sorted, stddev, sizeof(sorted));
+  float typical_stddev = median(sorted, PT1_PIXELS);
+
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    uint8_t *flags = &map->flags[i / PT1_WIDTH][i % PT1_WIDTH];
+    if (stats->frames > 1 && stats->min[i] == stats->max[i]) {
+      *flags |= PT1_BAD_STUCK;
+    }
+    if (deviation[i] > dead * typical_deviation) {
+      *flags |= PT1_BAD_DEAD;
+    }
+    if (typical_stddev > 0 && stddev[i] > noisy * typical_stddev) {
+      *flags |= PT1_BAD_NOISY;
+    }
+  }
+}
+
+/**
+ * Writes a map as 60 lines of 80 comma separated values.
+ */
+static int write_map(const char *prefix, const char *name, const float *values,
+                     const uint16_t *integers) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s_%s.csv", prefix, name);
+  FILE *fd = fopen(path, "w");
+  if (!fd) {
+    fprintf(stderr, "Couldn't open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      int i = y * PT1_WIDTH + x;
+      if (values) {
+        fprintf(fd, x ? ",%.4f" : "%.4f", values[i]);
+      } else {
+        fprintf(fd, x ? ",%u" : "%u", integers[i]);
+      }
+    }
+    fprintf(fd, "\n");
+  }
+  return fclose(fd);
+}
+
+static void usage(const char *name) {
+  printf(
+    "Computes per pixel statistics over recordings made by pt1cap and finds bad pixels.\n"\
+    "Recordings are treated as one sequence in the order given.\n"\
+    "\n"\
+    "Usage: %s [options] <filename>...\n"\
+    "\t-o prefix   output prefix, defaults to pixelstats\n"\
+    "\t-d factor   dead when the mean is further from its neighbors than factor\n"\
+    "\t            times the median pixel is, defaults to 10\n"\
+    "\t-n factor   noisy when the standard deviation is above factor times the\n"\
+    "\t            median, defaults to 3\n"\
+    "\t-j threads  defaults to the number of processors\n"\
+    "\t-N file     also writes offsets that make the mean frame uniform to a\n"\
+    "\t            NUC file for pt1_nuc_load. Record a uniform scene, e.g. the\n"\
+    "\t            lens cap, right after an FFC.\n"\
+    "\n"\
+    "Writes <prefix>_mean.csv, _stddev.csv, _min.csv, _max.csv and _drift.csv\n"\
+    "(counts per 1000 frames) with a row per image row, and the bad pixel map\n"\
+    "<prefix>.badpixels which can be loaded with pt1_bad_pixels_load.\n"\
+    "\n"\
+  , name);
+}
+
+int main(int argc, char* argv[]) {
+  const char *prefix = "pixelstats";
+  const char *nuc_file = NULL;
+  float dead = 10;
+  float noisy = 3;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "o:d:n:j:N:h")) != -1) {
+    switch (opt) {
+    case 'o':
+      prefix = optarg;
+      break;
+    case 'd':
+      dead = atof(optarg);
+      break;
+    case 'n':
+      noisy = atof(optarg);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'N':
+      nuc_file = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind >= argc || threads < 1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  int num_recordings = argc - optind;
+  struct recording *recordings = calloc(num_recordings, sizeof(*recordings));
+  long total_frames = 0;
+  for (int i = 0; i < num_recordings; i++) {
+    struct recording *r = &recordings[i];
+    struct stat st;
+    r->path = argv[optind + i];
+    if ((r->fd = open(r->path, O_RDONLY)) < 0 || fstat(r->fd, &st)) {
+      fprintf(stderr, "Couldn't open %s: %s\n", r->path, strerror(errno));
+      return -1;
+    }
+    r->frames = st.st_size / FRAME_SIZE;
+    r->offset = total_frames;
+    total_frames += r->frames;
+    num_jobs += (r->frames + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+  }
+  if (!total_frames) {
+    fprintf(stderr, "No frames\n");
+    return -1;
+  }
+
+  jobs = calloc(num_jobs, sizeof(*jobs));
+  long j = 0;
+  for (int i = 0; i < num_recordings; i++) {
+    struct recording *r = &recordings[i];
+    for (long f = 0; f < r->frames; f += CHUNK_FRAMES) {
+      jobs[j].recording = r;
+      jobs[j].first = f;
+      jobs[j].count = r->frames - f < CHUNK_FRAMES ? r->frames - f : CHUNK_FRAMES;
+      j++;
+    }
+  }
+
+  /* Each worker accumulates its own chunks. The sums are integers so merging
+     them gives exactly the same result as a single thread. */
+  if (threads > num_jobs) {
+    threads = num_jobs;
+  }
+  struct worker *workers = calloc(threads, sizeof(*workers));
+  double start = now();
+  for (int i = 0; i < threads; i++) {
+    pt1_pixel_stats_init(&workers[i].stats);
+    pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+  }
+  static struct pt1_pixel_stats stats;
+  pt1_pixel_stats_init(&stats);
+  for (int i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    pt1_pixel_stats_merge(&stats, &workers[i].stats);
+  }
+  double elapsed = now() - start;
+  free(workers);
+  if (failed) {
+    return -1;
+  }
+  printf("Processed %ld frames from %d files in %.2f s (%.0f frames/s, %d threads)\n",
+         total_frames, num_recordings, elapsed, total_frames / elapsed, threads);
+
+  static float mean[PT1_PIXELS], stddev[PT1_PIXELS], drift[PT1_PIXELS];
+  pt1_pixel_stats_maps(&stats, mean, stddev, drift);
+  for (int i = 0; i < PT1_PIXELS; i++) {
+    drift[i] *= 1000;
+  }
+  if (write_map(prefix, "mean", mean, NULL) || write_map(prefix, "stddev", stddev, NULL) ||
+      write_map(prefix, "min", NULL, stats.min) || write_map(prefix, "max", NULL, stats.max) ||
+      write_map(prefix, "drift", drift, NULL)) {
+    return -1;
+  }
+
+  static struct pt1_bad_pixels map;
+  find_bad_pixels(&stats, mean, stddev, dead, noisy, &map);
+  int counts[3] = {0};
+  for (int y = 0; y < PT1_HEIGHT; y++) {
+    for (int x = 0; x < PT1_WIDTH; x++) {
+      counts[0] += (map.flags[y][x] & PT1_BAD_DEAD) != 0;
+      counts[1] += (map.flags[y][x] & PT1_BAD_STUCK) != 0;
+      counts[2] += (map.flags[y][x] & PT1_BAD_NOISY) != 0;
+    }
+  }
+  char path[4096];
+  snprintf(path, sizeof(path), "%s.badpixels", prefix);
+  if (pt1_bad_pixels_save(&map, path)) {
+    fprintf(stderr, "Couldn't write %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  printf("%d bad pixels (%d dead, %d stuck, %d noisy) written to %s\n",
+         pt1_bad_pixels_count(&map), counts[0], counts[1], counts[2], path);
+
+  if (nuc_file) {
+    static struct pt1_nuc nuc;
+    pt1_nuc_init(&nuc);
+    pt1_nuc_one_point(&nuc, mean);
+    if (pt1_nuc_save(&nuc, nuc_file)) {
+      fprintf(stderr, "Couldn't write %s: %s\n", nuc_file, strerror(errno));
+      return -1;
+    }
+    printf("NUC offsets written to %s\n", nuc_file);
+  }
+
+  for (int i = 0; i < num_recordings; i++) {
+    close(recordings[i].fd);
+  }
+  free(recordings);
+  free(jobs);
+  return 0;
+}
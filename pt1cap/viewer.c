@@ -4,6 +4,9 @@
 
 #include <SDL.h>
 
+#include "pt1_color.h"
+#include "pt1_agc.h"
+
 int main(int argc, char* argv[]) {
   if (argc > 4 || argc < 2) {
     printf(
@@ -11,6 +14,10 @@ int main(int argc, char* argv[]) {
       "\n"\
       "Usage: %s <filename> [blue_level red_level]\n"\
       "\n"\
+      "Without levels the range is chosen by automatic gain control.\n"\
+      "Keys: c cycles the palette, g cycles the gain control mode, a toggles auto\n"\
+      "range when gain control is off, any other key pauses.\n"\
+      "\n"\
     , argv[0]);
     return -1;
   }
@@ -18,18 +25,26 @@ int main(int argc, char* argv[]) {
   int frame = 0;
   int end = 0;
   int run = 1;
-  long offset;
-  float scale;
+  int auto_range = 0;
+  enum pt1_palette palette = PT1_PALETTE_GRAYSCALE;
+  static struct pt1_colormap colormap;
+  // -1 uses low and high
+  int agc_mode = -1;
+  static struct pt1_agc agc;
+  uint16_t low, high;
   printf("%i\n", argc);
   if(argc > 3) {
-    offset = -atol(argv[2]);
-    scale = 255.0 / (atof(argv[3]) + offset);
-    printf("%li %f\n", offset, scale);
+    low = atol(argv[2]);
+    high = atol(argv[3]);
+    printf("%u %u\n", low, high);
   } else {
     // 3400 to 3900 is human
-    offset = -3400; // to 3800
-    scale = 255.0/(3900-3400);
+    low = 3400;
+    high = 3900;
+    agc_mode = PT1_AGC_LINEAR;
+    pt1_agc_init(&agc, agc_mode);
   }
+  pt1_colormap_init(&colormap, palette);
 
   FILE *fd = fopen(argv[1], "r");
   printf("%s\n", argv[1]);
@@ -57,11 +72,6 @@ int main(int argc, char* argv[]) {
     return 3;
   }
 
-  const int w = 80;
-  const int h = 60;
-  const int r = 0;
-  const int g = 1;
-  const int b = 2;
   while(run) {
     unsigned long next_ticks = SDL_GetTicks() + 40;
     uint16_t y16[60][80];
@@ -75,21 +85,14 @@ int main(int argc, char* argv[]) {
         continue;
       }
       SDL_LockTexture(texture, NULL, (void **) &rgb, &pitch);
-      for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
-          float pixel = ((float) (y16[y][x] + offset)) * scale;
-          if (pixel > 0xFF) {
-            (*rgb)[y][x][r] = 0xFF;
-            (*rgb)[y][x][g] = 0;
-            (*rgb)[y][x][b] = 0;
-          } else if (pixel < 0) {
-            (*rgb)[y][x][r] = 0;
-            (*rgb)[y][x][g] = 0;
-            (*rgb)[y][x][b] = 0xFF;
-          } else {
-            (*rgb)[y][x][r] = (*rgb)[y][x][g] = (*rgb)[y][x][b] = pixel;
-          }
-        }
+      if (agc_mode >= 0) {
+        uint8_t y8[60][80];
+        pt1_agc_process(&agc, &y16[0][0], 80, 60, &y8[0][0]);
+        pt1_colorize_8bit(&colormap, &y8[0][0], 80 * 60, &(*rgb)[0][0][0]);
+      } else if (auto_range) {
+        pt1_colorize_auto(&colormap, &y16[0][0], 80 * 60, &(*rgb)[0][0][0]);
+      } else {
+        pt1_colorize(&colormap, &y16[0][0], 80 * 60, low, high, &(*rgb)[0][0][0]);
       }
       SDL_UnlockTexture(texture);
       SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
@@ -109,7 +112,24 @@ int main(int argc, char* argv[]) {
         run = 0;
         break;
       case SDL_KEYDOWN:
-        paused = !paused;
+        if (e.key.keysym.sym == SDLK_c) {
+          palette = (palette + 1) % PT1_PALETTE_COUNT;
+          pt1_colormap_init(&colormap, palette);
+          printf("palette %s\n", pt1_palette_name(palette));
+        } else if (e.key.keysym.sym == SDLK_a) {
+          auto_range = !auto_range;
+          printf("auto range %s\n", auto_range ? "on" : "off");
+        } else if (e.key.keysym.sym == SDLK_g) {
+          agc_mode = agc_mode + 1 < PT1_AGC_MODE_COUNT ? agc_mode + 1 : -1;
+          if (agc_mode >= 0) {
+            pt1_agc_init(&agc, agc_mode);
+            printf("gain control %s\n", pt1_agc_mode_name(agc_mode));
+          } else {
+            printf("gain control off\n");
+          }
+        } else {
+          paused = !paused;
+        }
         break;
       case SDL_MOUSEBUTTONUP:
         x = e.button.x * 80 / 640;